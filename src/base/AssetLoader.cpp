@@ -0,0 +1,186 @@
+#include <AssetLoader.hpp>
+#include <Game.hpp>
+#include <Logger.hpp>
+#include <chrono>
+
+using namespace retro;
+using namespace std;
+
+AssetLoader::AssetLoader(Game &game, Logger &log, size_t threads): game(game), log(log) {
+    if(threads == 0) {
+        //One thread is reserved for the game loop
+        size_t cores = thread::hardware_concurrency();
+        threads = cores > 2 ? min<size_t>(cores - 1, 4) : 1;
+    }
+
+    for(size_t i = 0; i < threads; i++) {
+        workers.emplace_back(&AssetLoader::worker, this);
+    }
+    log.debug("Asset loader started with %zu worker threads", threads);
+}
+
+AssetLoader::~AssetLoader() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        jobs.clear();
+    }
+    jobsCondition.notify_all();
+    for(auto &t: workers) t.join();
+}
+
+void AssetLoader::worker() {
+    while(true) {
+        function<function<void()>()> job;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            jobsCondition.wait(lock, [this] () { return stop || !jobs.empty(); });
+            if(stop) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            runningJobs++;
+        }
+
+        auto upload = job();
+
+        {
+            lock_guard<std::mutex> lock(mutex);
+            uploads.push_back(std::move(upload));
+            runningJobs--;
+        }
+        doneCondition.notify_all();
+        game.requestFrame();
+    }
+}
+
+void AssetLoader::enqueue(const string &path, function<function<void()>()> &&job) {
+    pending.insert(path);
+    {
+        lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobsCondition.notify_one();
+}
+
+void AssetLoader::preloadImage(const string &path, Image::Channels desired, bool atlas) {
+    if(pending.count(path) || images.count(path)) return;
+
+    enqueue(path, [this, path, desired, atlas] () -> function<void()> {
+        try {
+            auto image = make_shared<Image>(path, game, desired);
+            image->enableAtlas(atlas);
+            return [this, path, image] () {
+                pending.erase(path);
+                image->regenerate();
+                images[path] = image;
+            };
+        } catch(const exception &e) {
+            string what = e.what();
+            return [this, path, what] () {
+                pending.erase(path);
+                log.error("Could not preload image '%s': %s", path.c_str(), what.c_str());
+            };
+        }
+    });
+}
+
+void AssetLoader::preloadMap(const string &path) {
+    if(pending.count(path) || maps.count(path)) return;
+
+    //The palette can be changed in the main thread while the map is being decoded
+    const Palette &palette = game.getPalette();
+    vector<uint32_t> colors(palette.data(), palette.data() + 256);
+    enqueue(path, [this, path, colors] () -> function<void()> {
+        try {
+            auto map = make_shared<Map>(path, game);
+            map->regeneratePixels(colors.data());
+            return [this, path, map] () {
+                pending.erase(path);
+                map->uploadTextures();
+                maps[path] = map;
+            };
+        } catch(const exception &e) {
+            string what = e.what();
+            return [this, path, what] () {
+                pending.erase(path);
+                log.error("Could not preload map '%s': %s", path.c_str(), what.c_str());
+            };
+        }
+    });
+}
+
+ImagePtr AssetLoader::getImage(const string &path, Image::Channels desired, bool atlas) {
+    if(pending.count(path)) finish();
+
+    auto it = images.find(path);
+    if(it != images.end()) {
+        auto image = it->second;
+        images.erase(it);
+        return image;
+    }
+
+    auto image = Image::loadImage(path, game, desired);
+    image->enableAtlas(atlas);
+    image->regenerate();
+    return image;
+}
+
+Map AssetLoader::getMap(const string &path) {
+    if(pending.count(path)) finish();
+
+    auto it = maps.find(path);
+    if(it != maps.end()) {
+        Map map(std::move(*it->second));
+        maps.erase(it);
+        return map;
+    }
+
+    return Map(path, game);
+}
+
+void AssetLoader::evict() {
+    if(images.empty() && maps.empty()) return;
+    log.debug("Evicting %zu preloaded images and %zu preloaded maps that were not used", images.size(), maps.size());
+    images.clear();
+    maps.clear();
+}
+
+bool AssetLoader::isLoading() {
+    return !pending.empty();
+}
+
+void AssetLoader::upload() {
+    auto start = chrono::steady_clock::now();
+    while(true) {
+        function<void()> upload;
+        {
+            lock_guard<std::mutex> lock(mutex);
+            if(uploads.empty()) return;
+            upload = std::move(uploads.front());
+            uploads.pop_front();
+        }
+
+        upload();
+
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        if(elapsed.count() >= uploadBudget) {
+            //The rest will be uploaded in the next frame, even if the loop is sleeping
+            game.requestFrame();
+            return;
+        }
+    }
+}
+
+void AssetLoader::finish() {
+    while(!pending.empty()) {
+        deque<function<void()>> ready;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            doneCondition.wait(lock, [this] () { return !uploads.empty() || (jobs.empty() && runningJobs == 0); });
+            ready.swap(uploads);
+        }
+
+        if(ready.empty()) break;
+        for(auto &upload: ready) upload();
+    }
+}
@@ -0,0 +1,65 @@
+#include <FontCache.hpp>
+#include <stdexcept>
+
+#if defined(__APPLE__) && defined(__MACH__) and !defined(__IOS__)
+#include <SDL2_ttf/SDL_ttf.h>
+#else
+#if !defined(_WIN32) and !defined(__ANDROID__) and !defined(__IOS__)
+#include <SDL2/SDL_ttf.h>
+#else
+#include <SDL_ttf.h>
+#endif
+#endif
+
+using namespace retro;
+using namespace std;
+
+FontCache::~FontCache() {
+    for(auto &pair: fonts) TTF_CloseFont(pair.second.font);
+}
+
+TTF_Font* FontCache::acquire(const string &path, uint32_t size, int style, int outline) {
+    Key key { path, size, style, outline };
+    auto it = fonts.find(key);
+    if(it == fonts.end()) {
+        TTF_Font* font = TTF_OpenFont(path.c_str(), int(size));
+        if(font == nullptr) {
+            throw runtime_error(string("Could not open font ") + path + ": " + TTF_GetError());
+        }
+        TTF_SetFontStyle(font, style);
+        TTF_SetFontOutline(font, outline);
+        it = fonts.emplace(std::move(key), Entry { font, 0 }).first;
+        entries[font] = it;
+    }
+
+    it->second.references++;
+    return it->second.font;
+}
+
+void FontCache::retain(TTF_Font* font) {
+    auto it = entries.find(font);
+    if(it == entries.end()) {
+        throw runtime_error("The font was not got from the font cache");
+    }
+    it->second->second.references++;
+}
+
+void FontCache::release(TTF_Font* font) {
+    if(font == nullptr) return;
+    auto it = entries.find(font);
+    if(it != entries.end() && it->second->second.references > 0) {
+        it->second->second.references--;
+    }
+}
+
+void FontCache::releaseUnused() {
+    for(auto it = fonts.begin(); it != fonts.end();) {
+        if(it->second.references == 0) {
+            entries.erase(it->second.font);
+            TTF_CloseFont(it->second.font);
+            it = fonts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -2,9 +2,17 @@
 #include <stdexcept>
 #include <cmath>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <Timer.hpp>
 #include <Level.hpp>
 #include <MapObject.hpp>
+#include <UILayer.hpp>
+#include <AssetLoader.hpp>
+#include <TextureAtlas.hpp>
+#include <GlyphAtlas.hpp>
+#include <FontCache.hpp>
 #include <Platform.hpp>
 
 #if !defined(_WIN32) and !defined(__ANDROID__) and !defined(__IOS__)
@@ -669,6 +677,7 @@ Game::Game(const Game::Builder &builder): log(Logger::getLogger(builder.name)),
     }
     SDL_GetRendererInfo(renderer, &info);
     log.info("Using %s 2D renderer", info.name);
+    this->textureAtlas = new TextureAtlas(renderer);
 
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0"); //Pixel Art :)
     SDL_SetHint(SDL_HINT_RENDER_VSYNC, "1"); //VSync hermano
@@ -676,6 +685,7 @@ Game::Game(const Game::Builder &builder): log(Logger::getLogger(builder.name)),
     if(TTF_Init() != 0) {
         throw runtime_error(string("Could not initialize SDL_ttf: ") + TTF_GetError());
     }
+    this->fontCache = new FontCache;
 
     if(builder.sampleRate != 0) {
         if(Mix_OpenAudio(builder.sampleRate, AUDIO_S16, builder.channels, builder.audioChunkSize) != 0) {
@@ -698,6 +708,9 @@ Game::Game(const Game::Builder &builder): log(Logger::getLogger(builder.name)),
     this->mode = builder.canvasMode;
     this->gamePath = builder.gamePath;
     log.info("Using %s as game path", gamePath.c_str());
+
+    this->assetLoader = new AssetLoader(*this, log);
+    this->wakeUpEvent = SDL_RegisterEvents(1);
 }
 
 void Game::pollEvents(double &fpslimit, function<void(bool)> resize) {
@@ -727,43 +740,68 @@ void Game::pollEvents(double &fpslimit, function<void(bool)> resize) {
             //is happening, so to avoid a high CPU usage, will limit the number of renders
             if(e.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
                 fpslimit = 1.0 / 144.0;
-                log.debug("FPS limit set to 144");
+                RETRO_LOG_LIMITED(log, Logger::Debug, 2, "FPS limit set to 144");
             } else if(e.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
                 fpslimit = 1.0 / 5.0;
-                log.debug("FPS limit set to 5");
+                RETRO_LOG_LIMITED(log, Logger::Debug, 2, "FPS limit set to 5");
             } else if(e.window.event == SDL_WINDOWEVENT_MINIMIZED) {
                 fpslimit = 1.0;
-                log.debug("FPS limit set to 1");
+                RETRO_LOG_LIMITED(log, Logger::Debug, 2, "FPS limit set to 1");
             } else if(e.window.event == SDL_WINDOWEVENT_RESIZED) {
                 resize(true);
             } else if(e.window.event == SDL_WINDOWEVENT_EXPOSED) {
                 currentLevel->mustRedraw();
-                log.debug("Window must be redrawn");
+                RETRO_LOG_LIMITED(log, Logger::Debug, 2, "Window must be redrawn");
             }
         }
     }
 }
 
+void Game::waitForEvents() {
+    //The debug commands wake up the loop with requestFrame(), which needs the custom event. Without it,
+    //the loop must wake up from time to time to look for them
+    int32_t timeout = wakeUpEvent == uint32_t(-1) ? 250 : -1;
+    if(wakeUpTicks != 0) {
+        const int32_t left = int32_t(wakeUpTicks - SDL_GetTicks());
+        if(left <= 0) {
+            wakeUpTicks = 0;
+            return;
+        }
+        timeout = timeout < 0 ? left : std::min(timeout, left);
+    }
+
+    //The time sleeping is not seen by the objects as a very long frame
+    timerPtr->pause();
+    if(timeout < 0) SDL_WaitEvent(nullptr);
+    else SDL_WaitEventTimeout(nullptr, timeout);
+    timerPtr->unpause();
+    if(wakeUpTicks != 0 && SDL_TICKS_PASSED(SDL_GetTicks(), wakeUpTicks)) wakeUpTicks = 0;
+}
+
 void Game::updateObjects(Timer &timer) {
     if(currentLevel->preupdate(timer.getDelta())) {
+        currentLevel->tweens.update(timer.getDelta());
         for(Object *obj : currentLevel->objects) {
             if(!obj->isDisabled()) {
                 if(dynamic_cast<Player*>(obj) != nullptr) {
                     Player* player = (Player*) obj;
                     for(Object *obj : currentLevel->objects) {
                         if(player != obj && dynamic_cast<Collisionable*>(obj) != nullptr) {
-                            player->checkCollision(*dynamic_cast<Collisionable*>(obj));
+                            MovableObject* movable = dynamic_cast<MovableObject*>(obj);
+                            vec2 otherMotion = movable != nullptr ? movable->motion(timer.getDelta()) : vec2{ 0, 0 };
+                            player->checkCollision(*dynamic_cast<Collisionable*>(obj), otherMotion, timer.getDelta());
                         } else if(dynamic_cast<MapObject*>(obj) != nullptr) {
-                            auto frame = player->nextFrame(timer.getDelta());
                             MapObject* map = (MapObject*) obj;
-                            if(!map->validPosition({ frame.pos.x + frame.size.x / 2, frame.pos.y })) {
-                                player->collisionWithMap(TOP);
-                            } if(!map->validPosition({ frame.pos.x + frame.size.x / 2, frame.pos.y + frame.size.y })) {
-                                player->collisionWithMap(BOTTOM);
-                            } if(!map->validPosition({ frame.pos.x, frame.pos.y + frame.size.y / 2 })) {
-                                player->collisionWithMap(LEFT);
-                            } if(!map->validPosition({ frame.pos.x + frame.size.x, frame.pos.y + frame.size.y / 2 })) {
-                                player->collisionWithMap(RIGHT);
+                            //Checks the cells along the motion, and slides along the first wall hit to find a second one
+                            Frame box = player->getFrame();
+                            vec2 motion = player->nextFrame(timer.getDelta()).pos - box.pos;
+                            MapHit hit;
+                            for(int i = 0; i < 2 && map->sweep(box, motion, hit); i++) {
+                                player->collisionWithMap(hit.face);
+                                box.pos += motion * hit.time;
+                                motion *= 1.0f - hit.time;
+                                if(hit.face & (LEFT | RIGHT)) motion.x = 0;
+                                else motion.y = 0;
                             }
                         }
                     }
@@ -771,6 +809,7 @@ void Game::updateObjects(Timer &timer) {
                 obj->update(timer.getDelta(), currentLevel->ga);
             }
         }
+        currentLevel->triggers.update();
         currentLevel->update(timer.getDelta());
     }
 }
@@ -802,6 +841,8 @@ void Game::deletePendingObjects() {
     currentLevel->pendingToDeleteObjects.clear();
 }
 
+void textCache_save_state(json &j);
+void textCache_restore_state(const json &j);
 void Game::parseCommands() {
     static auto split = [] (string cmd, auto delim) -> vector<string> {
         vector<string> path;
@@ -936,8 +977,8 @@ void Game::parseCommands() {
             } else {
                 Optional<json> value = !cmd->data[ir]["value"].is_null() ? Optional<json>(cmd->data[ir]["value"]) : Optional<json>{};
                 auto attribute = split(cmdStr, "::");
-                if(value) log.debug("Received command '%s' with argument '%s'", cmdStr.c_str(), value->dump().c_str());
-                else log.debug("Received command '%s'", cmdStr.c_str());
+                if(value) RETRO_LOG_DEBUG(log, "Received command '%s' with argument '%s'", cmdStr.c_str(), value->dump().c_str());
+                else RETRO_LOG_DEBUG(log, "Received command '%s'", cmdStr.c_str());
                 if(attribute[0] == "game") {
                     if(attribute.size() == 1) {
                         resp[ir] = {{ "options",
@@ -946,7 +987,8 @@ void Game::parseCommands() {
                                 { { "attribute", "levels" }, { "type", "Array" } },
                                 { { "attribute", "name" }, { "type", "String" } },
                                 { { "attribute", "path" }, { "type", "String" } },
-                                { { "attribute", "quit" }, { "type", "Bool" } }
+                                { { "attribute", "quit" }, { "type", "Bool" } },
+                                { { "attribute", "textCache" }, { "type", "Object" } }
                             }
                         }};
                     } else if(attribute[1] == "currentLevel") {
@@ -988,6 +1030,13 @@ void Game::parseCommands() {
                         } else {
                             resp[ir] = gamePath;
                         }
+                    } else if(attribute[1] == "textCache") {
+                        json j;
+                        auto nattr = attribute;
+                        nattr.erase(nattr.begin());
+                        textCache_save_state(j);
+                        exec(resp[ir], j, nattr, value);
+                        if(value) textCache_restore_state(j);
                     } else if(attribute[1] == "quit" && attribute.size() == 2) {
                         quit = true;
                         resp[ir] = "true";
@@ -1017,7 +1066,6 @@ namespace retro {
     extern float _android_factor_scale;
 }
 #endif
-void textCache_collect_garbage();
 void textCache_clear_all_entries();
 void Game::loop() {
     Timer timer;
@@ -1027,6 +1075,8 @@ void Game::loop() {
 
     if(this->currentLevel == nullptr)
         throw runtime_error("No initial level has been selected");
+    this->currentLevel->preload();
+    assetLoader->finish();
     this->currentLevel->setup();
 
     SDL_SetRenderDrawBlendMode(this->renderer, SDL_BlendMode::SDL_BLENDMODE_BLEND);
@@ -1057,77 +1107,132 @@ void Game::loop() {
         if(f) {
             currentLevel->windowResized(canvasSize, oldSize);
             currentLevel->mustRedraw();
-            log.info("Resized window");
+            RETRO_LOG_LIMITED(log, Logger::Info, 2, "Resized window");
         }
-        log.debug("Render size %dx%d", size.x, size.y);
-        log.debug("Window size %dx%d", wsize.x, wsize.y);
-        log.debug("Texture target size %dx%d", canvasSize.x * 2, canvasSize.y * 2);
-        log.debug("Canvas size %dx%d", canvasSize.x, canvasSize.y);
-        log.debug("Scale factor %f", scaleFactor);
+        //While the window is being resized, this is called for every frame
+        RETRO_LOG_LIMITED(log, Logger::Debug, 2, "Render size %dx%d, window size %dx%d, texture target size %dx%d, canvas size %dx%d, scale factor %f",
+                          size.x, size.y, wsize.x, wsize.y, canvasSize.x * 2, canvasSize.y * 2, canvasSize.x, canvasSize.y, scaleFactor);
     };
     resizeFunc(false);
 
     UILevel uiLevel(*this); uiLevel.ga.doubleIt = false;
+    UILayer uiLayer(renderer);
     double fpslimit = 1.0/144.0;
-    auto lastTimeGC = chrono::system_clock::now();
+
+    //The debug commands come from a socket that SDL doesn't know, this thread waits for them and wakes up the loop
+    mutex commandMutex;
+    condition_variable commandRead;
+    bool commandPending = false;
+    thread commandWatcher([this, &commandMutex, &commandRead, &commandPending] () {
+        while(waitForCommand()) {
+            unique_lock<mutex> lock(commandMutex);
+            commandPending = true;
+            requestFrame();
+            //Until the loop reads it, the socket would wake up this thread again and again
+            commandRead.wait(lock, [&commandPending] () { return !commandPending; });
+        }
+    });
+
     timer.start();
     while(!this->quit) {
         pollEvents(fpslimit, resizeFunc);
         parseCommands();
+        {
+            lock_guard<mutex> lock(commandMutex);
+            if(commandPending) {
+                commandPending = false;
+                commandRead.notify_one();
+            }
+        }
         updateObjects(timer);
+        assetLoader->upload();
 
         SDL_Rect rekt = { 0, 0, canvasSize.x * 2, canvasSize.y * 2 };
         SDL_RenderSetViewport(this->renderer, &rekt);
         SDL_RenderSetScale(this->renderer, 1.0f, 1.0f);
         SDL_SetRenderTarget(this->renderer, rendererTexture);
 
-        if(currentLevel->predraw()) {
+        const bool drawLevel = currentLevel->predraw();
+        if(drawLevel) {
+            //Objects outside the camera are not drawn
+            const Frame view = { currentLevel->cameraPos, vec2(canvasSize) };
             for(Object *obj : currentLevel->objects) {
-                if(!obj->isInvisible()) obj->draw(currentLevel->ga);
+                if(!obj->isInvisible()) {
+                    const Frame &bounds = obj->getCachedDrawBounds();
+                    if(bounds.size.x == 0 || bounds.size.y == 0 || view.collides(bounds)) obj->draw(currentLevel->ga);
+                }
             }
             currentLevel->draw();
+        }
 
+        //Update UI Objects, and draw again the ones that changed
+        auto backup = currentLevel;
+        currentLevel = &uiLevel;
+        for(auto* &o: backup->uiObjects) {
+            uiLevel.cameraPos = -o->frame.pos;
+            uiLevel.focused = backup->focused;
+            if(!o->isDisabled()) o->update(timer.getDelta(), uiLevel.ga);
+        }
+        uiLevel.focused = backup->focused;
+        const bool drawUI = uiLayer.update(*backup, backup->uiObjects, uiLevel, size, scaleFactor);
+
+        //If nothing changed, the frame shown is still valid
+        if(drawLevel || drawUI) {
             SDL_SetRenderTarget(this->renderer, nullptr);
             rekt = { 0, 0, size.x, size.y };
             SDL_RenderSetViewport(this->renderer, &rekt);
+            SDL_RenderSetScale(this->renderer, 1.0f, 1.0f);
             SDL_RenderClear(this->renderer);
             SDL_RenderCopy(this->renderer, rendererTexture, nullptr, &rekt);
+            uiLayer.draw();
             SDL_RenderSetScale(this->renderer, scaleFactor, scaleFactor);
 
-            //Draw UI Objects
-            auto backup = currentLevel;
-            currentLevel = &uiLevel;
-            for(auto* &o: backup->uiObjects) {
-                uiLevel.cameraPos = -o->frame.pos;
-                uiLevel.focused = backup->focused;
-                if(!o->isDisabled()) o->update(timer.getDelta(), uiLevel.ga);
-                uiLevel.focused = backup->focused;
-                if(!o->isInvisible()) o->draw(uiLevel.ga);
+            //UI Objects that are not retained are drawn every frame, over the rest
+            if(uiLayer.hasImmediateObjects()) {
+                for(auto* &o: backup->uiObjects) {
+                    if(!o->retained && !o->isInvisible()) {
+                        uiLevel.cameraPos = -o->frame.pos;
+                        o->draw(uiLevel.ga);
+                    }
+                }
             }
-            currentLevel = backup;
 
             SDL_RenderPresent(this->renderer);
         }
+        currentLevel = backup;
 
         deletePendingObjects();
+        const bool changedLevel = nextCurrentLevel != nullptr;
         if(nextCurrentLevel) {
             currentLevel->cleanup();
             currentLevel = nextCurrentLevel;
+            //If the level was preloaded, this only waits for the assets that are not ready yet
+            currentLevel->preload();
+            assetLoader->finish();
             currentLevel->setup();
+            assetLoader->evict();
+            fontCache->releaseUnused();
             log.debug("Changed to level %s", currentLevel->getName());
             nextCurrentLevel = nullptr;
         }
 
         timer.countFrame();
-        if(timer.getDelta() < fpslimit) SDL_Delay(uint32_t((fpslimit - timer.getDelta()) * 1000));
-        auto now = chrono::system_clock::now();
-        chrono::duration<double> diff = now - lastTimeGC;
-        if(diff.count() >= 1.0) {
-            textCache_collect_garbage();
-            lastTimeGC = now;
+        //If nothing changed in this frame, the next one will be the same until something happens
+        if(!drawLevel && !drawUI && !changedLevel && currentLevel->renderOnDemand() && currentLevel->tweens.size() == 0) {
+            waitForEvents();
+        } else if(timer.getDelta() < fpslimit) {
+            SDL_Delay(uint32_t((fpslimit - timer.getDelta()) * 1000));
         }
     }
 
+    stopWaitingForCommands();
+    {
+        lock_guard<mutex> lock(commandMutex);
+        commandPending = false;
+        commandRead.notify_one();
+    }
+    commandWatcher.join();
+
     SDL_DestroyTexture(rendererTexture);
     sendCommandResponse({ "", nullptr }, "");
 }
@@ -1136,6 +1241,19 @@ void Game::end() {
     this->quit = true;
 }
 
+void Game::requestFrame(float seconds) {
+    if(seconds <= 0) {
+        if(wakeUpEvent == uint32_t(-1)) return;
+        SDL_Event e;
+        SDL_zero(e);
+        e.type = wakeUpEvent;
+        SDL_PushEvent(&e);
+    } else {
+        const uint32_t ticks = SDL_GetTicks() + uint32_t(seconds * 1000);
+        if(wakeUpTicks == 0 || SDL_TICKS_PASSED(wakeUpTicks, ticks)) wakeUpTicks = ticks;
+    }
+}
+
 void Game::changeLevel(const char* name) {
     //this->currentLevel->cleanup();
     //this->currentLevel = &this->getLevel<Level>(name);
@@ -1144,6 +1262,18 @@ void Game::changeLevel(const char* name) {
     nextCurrentLevel = &getLevel<Level>(name);
 }
 
+void Game::preloadLevel(const char* name) {
+    getLevel<Level>(name).preload();
+}
+
+AssetLoader& Game::getAssetLoader() {
+    return *assetLoader;
+}
+
+TextureAtlas& Game::getTextureAtlas() {
+    return *textureAtlas;
+}
+
 void Game::unsetPalette() {
     this->palette = nullptr;
 }
@@ -1194,12 +1324,13 @@ const Palette& Game::getPalette() {
 }
 
 void Game::loadFont(const string &str, size_t size) {
-    this->font = TTF_OpenFont((this->gamePath + str).c_str(), int(size));
-    if(this->font == nullptr) {
-        throw runtime_error(string("Could not load ") + str + ": " + TTF_GetError());
-    }
+    TTF_Font* newFont = fontCache->acquire(this->gamePath + str, uint32_t(size));
+    fontCache->release(this->font);
+    this->font = newFont;
     log.debug("Loaded font %s", str.c_str());
     textCache_clear_all_entries();
+    delete glyphAtlas;
+    glyphAtlas = new GlyphAtlas(font, renderer);
 }
 
 void Game::captureMouse(bool capture) {
@@ -1247,9 +1378,10 @@ void Game::saveGame(const char *saveName) {
 
 void Game::restoreGame(const char *saveName) {
     InputFile inFile = openReadFile(saveName + string(".save"), false);
-    if(inFile.ok()) throw runtime_error("The save file '" + string(saveName) + "' doesn't exist");
+    if(!inFile.ok()) throw runtime_error("The save file '" + string(saveName) + "' doesn't exist");
     log.debug("Restoring game status from '%s.save'", saveName);
-    json savedJson = json::parse(inFile.read());
+    auto contents = inFile.readAll();
+    json savedJson = json::parse(contents.begin(), contents.end());
     inFile.close();
 
     for(auto level: savedJson["levels"]) {
@@ -1264,6 +1396,10 @@ void Game::restoreGame(const char *saveName) {
 Game::~Game() {
     for(auto pair : this->levels) delete pair.second;
     textCache_clear_all_entries();
+    delete assetLoader;
+    delete glyphAtlas;
+    delete textureAtlas;
+    delete fontCache;
 
     SDL_DestroyRenderer(this->renderer);
     SDL_DestroyWindow(this->window);
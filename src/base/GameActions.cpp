@@ -1,9 +1,9 @@
 #include <Game.hpp>
 #include <GameActions.hpp>
+#include <GlyphAtlas.hpp>
 #include <glm/vec3.hpp>
 #include <glm/geometric.hpp>
 #include <unordered_map>
-#include <chrono>
 
 #if defined(__APPLE__) && defined(__MACH__) and !defined(__IOS__)
 #include <SDL2_ttf/SDL_ttf.h>
@@ -19,80 +19,146 @@ using namespace retro;
 using namespace glm;
 using namespace std;
 
-struct TextKey {
+//Colours are taken from the table of the palette, so it's a bit test and a load
+static inline Color colorFromPalette(const Optional<Palette> &palette, size_t color) {
+    if(!palette) throw runtime_error("Palette is not set");
+    if(!palette->has(color)) throw runtime_error("Invalid color number");
+    return palette->at(color);
+}
+
+//Texts that cannot be drawn from the glyph atlas are rendered whole and kept in a LRU cache.
+//Entries are linked in a list from the most to the least recently used, and they are also
+//indexed by a hash of the text and the colour, so a lookup doesn't need to build a key
+//(copying the string) to find an entry.
+struct TextEntry {
     string text;
     Color color;
+    size_t hash;
+    SDL_Texture* texture;
+    int w, h;
+    TextEntry* prev;
+    TextEntry* next;
 
-    inline bool operator==(const TextKey &b) const {
-        return text == b.text && color == b.color;
-    }
-
-    inline bool operator!=(const TextKey &b) const {
-        return !(*this == b);
+    inline size_t bytes() const {
+        return size_t(w) * size_t(h) * 4;
     }
 };
 
-struct TextValue {
-    SDL_Surface* surface;
-    SDL_Texture* texture;
-    chrono::time_point<chrono::system_clock> accessed;
+static struct {
+    unordered_multimap<size_t, TextEntry*> index;
+    TextEntry* head = nullptr;
+    TextEntry* tail = nullptr;
+    size_t bytes = 0;
+    size_t budget = 8 * 1024 * 1024;
+    uint64_t hits = 0, misses = 0, evictions = 0;
+} textCache;
 
-    void free() const {
-        SDL_DestroyTexture(texture);
-        SDL_FreeSurface(surface);
-    }
-};
+static inline size_t cache_hash(const string &text, const Color &color) {
+    return hash<string>()(text) ^ hash<Color>()(color);
+}
+
+static inline void cache_unlink(TextEntry* entry) {
+    if(entry->prev) entry->prev->next = entry->next;
+    else textCache.head = entry->next;
+    if(entry->next) entry->next->prev = entry->prev;
+    else textCache.tail = entry->prev;
+}
+
+static inline void cache_push_front(TextEntry* entry) {
+    entry->prev = nullptr;
+    entry->next = textCache.head;
+    if(textCache.head) textCache.head->prev = entry;
+    textCache.head = entry;
+    if(!textCache.tail) textCache.tail = entry;
+}
 
-namespace std {
-    template<>
-    struct hash<TextKey> {
-        size_t operator()(const TextKey &key) const {
-            return hash<string>()(key.text) ^ hash<Color>()(key.color);
+static void cache_remove(TextEntry* entry) {
+    auto range = textCache.index.equal_range(entry->hash);
+    for(auto it = range.first; it != range.second; ++it) {
+        if(it->second == entry) {
+            textCache.index.erase(it);
+            break;
         }
-    };
+    }
+    cache_unlink(entry);
+    textCache.bytes -= entry->bytes();
+    SDL_DestroyTexture(entry->texture);
+    delete entry;
 }
 
-static unordered_map<TextKey, TextValue> textCache;
+static void cache_evict(size_t budget) {
+    //The most recently used entry is never evicted, it is going to be drawn right now
+    while(textCache.bytes > budget && textCache.tail && textCache.tail != textCache.head) {
+        cache_remove(textCache.tail);
+        textCache.evictions++;
+    }
+}
 
-static inline TextValue& cache_generate(const string &str, const Color &color, TTF_Font* font, SDL_Renderer* renderer) {
+static TextEntry* cache_generate(const string &str, const Color &color, size_t hash, TTF_Font* font, SDL_Renderer* renderer) {
     SDL_Color sdlcolor = { static_cast<Uint8>(color.r), static_cast<Uint8>(color.g), static_cast<Uint8>(color.b), static_cast<Uint8>(color.a) };
     SDL_Surface* surface = TTF_RenderUTF8_Solid(font, str.c_str(), sdlcolor);
-    if(surface) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        return textCache[{ str, color }] = { surface, texture, chrono::system_clock::now() };
-    } else {
+    if(surface == nullptr) {
         throw runtime_error("Could not allocate a texture for the text");
     }
-}
 
-static inline TextValue& cache_find(const string &text, const Color &color, TTF_Font* font, SDL_Renderer* renderer) {
-    TextKey key { text, color };
-    auto it = textCache.find(key);
-    if(it != textCache.end()) {
-        it->second.accessed = chrono::system_clock::now();
-        return it->second;
-    } else {
-        return cache_generate(text, color, font, renderer);
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+    TextEntry* entry = new TextEntry { str, color, hash, texture, surface->w, surface->h, nullptr, nullptr };
+    SDL_FreeSurface(surface);
+
+    textCache.index.emplace(hash, entry);
+    cache_push_front(entry);
+    textCache.bytes += entry->bytes();
+    cache_evict(textCache.budget);
+    return entry;
+}
+
+static inline TextEntry* cache_find(const string &text, const Color &color, TTF_Font* font, SDL_Renderer* renderer) {
+    const size_t hash = cache_hash(text, color);
+    auto range = textCache.index.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it) {
+        TextEntry* entry = it->second;
+        if(entry->color == color && entry->text == text) {
+            textCache.hits++;
+            if(entry != textCache.head) {
+                cache_unlink(entry);
+                cache_push_front(entry);
+            }
+            return entry;
+        }
     }
+
+    textCache.misses++;
+    return cache_generate(text, color, hash, font, renderer);
 }
 
 void textCache_clear_all_entries() {
-    for_each(textCache.begin(), textCache.end(), [] (const auto &it) { it.second.free(); });
-    textCache.clear();
-}
-
-void textCache_collect_garbage() {
-    auto it = textCache.begin();
-    auto now = chrono::system_clock::now();
-    while(it != textCache.end()) {
-        chrono::duration<double> diff = now - it->second.accessed;
-        if(diff.count() >= 4.5) {
-            it->second.free();
-            it = textCache.erase(it);
-        } else {
-            ++it;
-        }
+    for(TextEntry* entry = textCache.head; entry != nullptr;) {
+        TextEntry* next = entry->next;
+        SDL_DestroyTexture(entry->texture);
+        delete entry;
+        entry = next;
     }
+    textCache.index.clear();
+    textCache.head = textCache.tail = nullptr;
+    textCache.bytes = 0;
+}
+
+void textCache_save_state(json &j) {
+    j["budget"] = uint64_t(textCache.budget);
+    j["bytes"] = uint64_t(textCache.bytes);
+    j["entries"] = uint64_t(textCache.index.size());
+    j["hits"] = textCache.hits;
+    j["misses"] = textCache.misses;
+    j["evictions"] = textCache.evictions;
+}
+
+void textCache_restore_state(const json &j) {
+    //Only the budget and the counters (to reset them) can be changed
+    textCache.budget = j["budget"].get<uint64_t>();
+    textCache.hits = j["hits"].get<uint64_t>();
+    textCache.misses = j["misses"].get<uint64_t>();
+    textCache.evictions = j["evictions"].get<uint64_t>();
+    cache_evict(textCache.budget);
 }
 
 SDL_Rect get_rekt(const vec2 &pos, const vec2 &size, bool doubleIt) {
@@ -113,10 +179,7 @@ void GameActions::clear(const Color &color) {
 }
 
 void GameActions::clear(size_t color) {
-    if(!g.palette) throw runtime_error("Palette is not set");
-    auto color2 = (*g.palette)[color];
-    if(!color2) throw runtime_error("Invalid color number");
-    this->clear(*color2);
+    this->clear(colorFromPalette(g.palette, color));
 }
 
 void GameActions::setColor(const Color &color) {
@@ -124,9 +187,8 @@ void GameActions::setColor(const Color &color) {
 }
 
 void GameActions::setColor(size_t color) {
-    if(g.palette) {
-        auto color2 = (*g.palette)[color];
-        if(color) this->setColor(*color2);
+    if(g.palette && g.palette->has(color)) {
+        this->setColor(g.palette->at(color));
     }
 }
 
@@ -135,10 +197,7 @@ void GameActions::drawRectangle(const Frame &frame) {
 }
 
 void GameActions::drawRectangle(const Frame &frame, size_t color) {
-    if(!g.palette) throw runtime_error("Palette is not set");
-    auto color2 = (*g.palette)[color];
-    if(!color2) throw runtime_error("Invalid color number");
-    this->drawRectangle(frame, *color2);
+    this->drawRectangle(frame, colorFromPalette(g.palette, color));
 }
 
 void GameActions::drawRectangle(const Frame &frame, const Color &color) {
@@ -159,10 +218,7 @@ void GameActions::fillRectangle(const Frame &frame) {
 }
 
 void GameActions::fillRectangle(const Frame &frame, size_t color) {
-    if(!g.palette) throw runtime_error("Palette is not set");
-    auto color2 = (*g.palette)[color];
-    if(!color2) throw runtime_error("Invalid color number");
-    this->fillRectangle(frame, *color2);
+    this->fillRectangle(frame, colorFromPalette(g.palette, color));
 }
 
 void GameActions::fillRectangle(const Frame &frame, const Color &color) {
@@ -176,10 +232,7 @@ void GameActions::drawLine(const vec2 &ipos, const vec2 &epos) {
 }
 
 void GameActions::drawLine(const vec2 &ipos, const vec2 &epos, size_t color) {
-    if(!g.palette) throw runtime_error("Palette is not set");
-    auto color2 = (*g.palette)[color];
-    if(!color2) throw runtime_error("Invalid color number");
-    this->drawLine(ipos, epos, *color2);
+    this->drawLine(ipos, epos, colorFromPalette(g.palette, color));
 }
 
 void GameActions::drawLine(const vec2 &ipos, const vec2 &epos, const Color &color) {
@@ -221,24 +274,31 @@ void GameActions::print(const string &str, const vec2 &pos) {
 }
 
 void GameActions::print(const string &str, const vec2 &pos, size_t color) {
-    if(!g.palette) throw runtime_error("Palette is not set");
-    auto color2 = (*g.palette)[color];
-    if(!color2) throw runtime_error("Invalid color number");
-    this->print(str, pos, *color2);
+    this->print(str, pos, colorFromPalette(g.palette, color));
 }
 
 void GameActions::print(const string &str, const vec2 &pos, const Color &color) {
     if(g.font == nullptr) throw runtime_error("Font is not loaded");
     if(str.empty() || !doubleIt) return;
-    TextValue& val = cache_find(str, color, g.font, g.renderer);
-    SDL_Rect dstrekt { 2*int(floor(pos.x - camera().x)), 2*int(floor(pos.y - camera().y)), val.surface->w, val.surface->h };
-    SDL_RenderCopy(g.renderer, val.texture, nullptr, &dstrekt);
+    const ivec2 dstpos = { 2*int(floor(pos.x - camera().x)), 2*int(floor(pos.y - camera().y)) };
+    if(GlyphAtlas::canDraw(str)) {
+        g.glyphAtlas->draw(str, dstpos, color);
+    } else {
+        //Characters outside the BMP cannot be rendered as glyphs, render the whole text instead
+        TextEntry* entry = cache_find(str, color, g.font, g.renderer);
+        SDL_Rect dstrekt { dstpos.x, dstpos.y, entry->w, entry->h };
+        SDL_RenderCopy(g.renderer, entry->texture, nullptr, &dstrekt);
+    }
 }
 
 ivec2 GameActions::sizeOfText(const string &str) {
     if(g.font == nullptr) throw runtime_error("Font is not loaded");
     ivec2 size;
-    TTF_SizeUTF8(g.font, str.c_str(), &size.x, &size.y);
+    if(GlyphAtlas::canDraw(str)) {
+        size = g.glyphAtlas->sizeOf(str);
+    } else {
+        TTF_SizeUTF8(g.font, str.c_str(), &size.x, &size.y);
+    }
     size.x /= 2;
     size.y /= 2;
     return size;
@@ -249,10 +309,7 @@ void GameActions::putColor(const vec2 &pos) {
 }
 
 void GameActions::putColor(const vec2 &pos, size_t color) {
-    if(!g.palette) throw runtime_error("Palette is not set");
-    auto color2 = (*g.palette)[color];
-    if(!color2) throw runtime_error("Invalid color number");
-    this->putColor(pos, *color2);
+    this->putColor(pos, colorFromPalette(g.palette, color));
 }
 
 void GameActions::putColor(const vec2 &pos, const Color &color) {
@@ -268,10 +325,7 @@ void GameActions::drawCircle(const vec2 &pos, float radius) {
 }
 
 void GameActions::drawCircle(const vec2 &pos, float radius, size_t color) {
-    if(!g.palette) throw runtime_error("Palette is not set");
-    auto color2 = (*g.palette)[color];
-    if(!color2) throw runtime_error("Invalid color number");
-    this->drawCircle(pos, radius, *color2);
+    this->drawCircle(pos, radius, colorFromPalette(g.palette, color));
 }
 
 void GameActions::drawCircle(const vec2 &pos, float radius, const Color &color) {
@@ -305,10 +359,7 @@ void GameActions::fillCircle(const vec2 &pos, float radius) {
 }
 
 void GameActions::fillCircle(const vec2 &pos, float radius, size_t color) {
-    if(!g.palette) throw runtime_error("Palette is not set");
-    auto color2 = (*g.palette)[color];
-    if(!color2) throw runtime_error("Invalid color number");
-    this->fillCircle(pos, radius, *color2);
+    this->fillCircle(pos, radius, colorFromPalette(g.palette, color));
 }
 
 void GameActions::fillCircle(const vec2 &pos, float radius, const Color &color) {
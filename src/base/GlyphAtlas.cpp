@@ -0,0 +1,109 @@
+#include <GlyphAtlas.hpp>
+#include <stdexcept>
+#include <utf8.h>
+
+#if !defined(_WIN32) and !defined(__ANDROID__) and !defined(__IOS__)
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__) and !defined(__IOS__)
+#include <SDL2_ttf/SDL_ttf.h>
+#else
+#if !defined(_WIN32) and !defined(__ANDROID__) and !defined(__IOS__)
+#include <SDL2/SDL_ttf.h>
+#else
+#include <SDL_ttf.h>
+#endif
+#endif
+
+using namespace retro;
+using namespace glm;
+using namespace std;
+
+GlyphAtlas::GlyphAtlas(TTF_Font* font, SDL_Renderer* renderer): font(font), renderer(renderer), atlas(renderer, { 256, 256 }) {
+    height = TTF_FontHeight(font);
+}
+
+GlyphAtlas::Glyph GlyphAtlas::load(uint16_t ch) {
+    Glyph glyph { { nullptr, { 0, 0 }, { 0, 0 } }, 0, false };
+    int minx, maxx, miny, maxy;
+    if(TTF_GlyphMetrics(font, ch, &minx, &maxx, &miny, &maxy, &glyph.advance) != 0) {
+        return glyph;
+    }
+
+    //Rendering the character as a text gives a surface aligned to the baseline of a line,
+    //so all glyphs can be placed at the same height
+    char utf8[5] = { 0 };
+    utf8::append(ch, utf8);
+    SDL_Surface* surface = TTF_RenderUTF8_Solid(font, utf8, { 0xFF, 0xFF, 0xFF, 0xFF });
+    if(surface == nullptr) {
+        throw runtime_error(string("Could not render a glyph: ") + TTF_GetError());
+    }
+
+    if(surface->w > 0 && surface->h > 0) {
+        auto region = atlas.insert(surface);
+        if(!region) {
+            SDL_FreeSurface(surface);
+            throw runtime_error("Glyph is too big for the atlas");
+        }
+        glyph.region = *region;
+        glyph.hasPixels = true;
+    }
+    SDL_FreeSurface(surface);
+    return glyph;
+}
+
+const GlyphAtlas::Glyph& GlyphAtlas::glyph(uint16_t ch) {
+    if(ch < 128) {
+        if(!asciiLoaded[ch]) {
+            ascii[ch] = load(ch);
+            asciiLoaded[ch] = true;
+        }
+        return ascii[ch];
+    }
+
+    auto it = glyphs.find(ch);
+    if(it == glyphs.end()) {
+        it = glyphs.emplace(ch, load(ch)).first;
+    }
+    return it->second;
+}
+
+bool GlyphAtlas::canDraw(const string &str) {
+    if(utf8::find_invalid(str.begin(), str.end()) != str.end()) return false;
+    for(auto it = str.begin(); it != str.end();) {
+        if(utf8::unchecked::next(it) > 0xFFFF) return false;
+    }
+    return true;
+}
+
+ivec2 GlyphAtlas::sizeOf(const string &str) {
+    ivec2 size = { 0, height };
+    for(auto it = str.begin(); it != str.end();) {
+        size.x += glyph(uint16_t(utf8::unchecked::next(it))).advance;
+    }
+    return size;
+}
+
+void GlyphAtlas::draw(const string &str, const ivec2 &pos, const Color &color) {
+    SDL_Texture* lastTexture = nullptr;
+    int x = pos.x;
+    for(auto it = str.begin(); it != str.end();) {
+        const Glyph &g = glyph(uint16_t(utf8::unchecked::next(it)));
+        if(g.hasPixels) {
+            //Colour is applied per page, only when the page changes
+            if(g.region.texture != lastTexture) {
+                lastTexture = g.region.texture;
+                SDL_SetTextureColorMod(lastTexture, color.r, color.g, color.b);
+                SDL_SetTextureAlphaMod(lastTexture, color.a);
+            }
+
+            SDL_Rect src = { int(g.region.pos.x), int(g.region.pos.y), int(g.region.size.x), int(g.region.size.y) };
+            SDL_Rect dst = { x, pos.y, src.w, src.h };
+            SDL_RenderCopy(renderer, g.region.texture, &src, &dst);
+        }
+        x += g.advance;
+    }
+}
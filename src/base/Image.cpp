@@ -2,6 +2,7 @@
 #include <stdexcept>
 #include <string>
 #include <Game.hpp>
+#include <TextureAtlas.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_NO_STDIO
@@ -136,6 +137,9 @@ Image::Image(const Image &image): game(image.game), references(image.references)
     height = image.height;
     linear = image.linear;
     doNotFree = image.doNotFree;
+    atlas = image.atlas;
+    inAtlas = image.inAtlas;
+    atlasPos = image.atlasPos;
     references++;
 }
 
@@ -147,12 +151,20 @@ Image::Image(Image &&image): game(image.game), references(image.references) {
     height = image.height;
     linear = image.linear;
     doNotFree = image.doNotFree;
+    atlas = image.atlas;
+    inAtlas = image.inAtlas;
+    atlasPos = image.atlasPos;
     references++;
 }
 
 Image::~Image() {
     if(references.fetch_sub(1) == 1) {
-        SDL_DestroyTexture((SDL_Texture*) texture);
+        //Atlas pages are owned by the atlas
+        if(inAtlas) {
+            game.textureAtlas->release({ (SDL_Texture*) texture, atlasPos, { width, height } });
+        } else {
+            SDL_DestroyTexture((SDL_Texture*) texture);
+        }
         SDL_FreeSurface((SDL_Surface*) surface);
         stbi_image_free(data);
         delete &references;
@@ -167,8 +179,24 @@ void Image::generateAndDestroy() {
 }
 
 void Image::regenerate() {
+    if(inAtlas) {
+        game.textureAtlas->update({ (SDL_Texture*) texture, atlasPos, { width, height } }, (SDL_Surface*) surface);
+        return;
+    }
+
     if(texture != nullptr) {
         SDL_DestroyTexture((SDL_Texture*) texture);
+        texture = nullptr;
+    }
+
+    if(atlas && !linear) {
+        auto region = game.textureAtlas->insert((SDL_Surface*) surface);
+        if(region) {
+            texture = region->texture;
+            atlasPos = region->pos;
+            inAtlas = true;
+            return;
+        }
     }
 
     texture = SDL_CreateTextureFromSurface(game.renderer, (SDL_Surface*) surface);
@@ -188,7 +216,8 @@ void Image::draw(const Frame &frame) {
     auto cp = game.currentLevel->ga.camera();
     SDL_Rect rekt = get_rekt(frame.pos - cp, frame.size, game.currentLevel->ga.doubleIt);
 
-    render(game.renderer, texture, NULL, &rekt, linear);
+    SDL_Rect from = { static_cast<int>(atlasPos.x), static_cast<int>(atlasPos.y), static_cast<int>(width), static_cast<int>(height) };
+    render(game.renderer, texture, inAtlas ? &from : NULL, &rekt, linear);
 }
 
 void Image::draw(const glm::vec2 &pos) {
@@ -201,7 +230,8 @@ void Image::draw(const glm::vec2 &pos) {
         static_cast<int>(height) * m
     };
 
-    render(game.renderer, texture, NULL, &rekt, linear);
+    SDL_Rect from = { static_cast<int>(atlasPos.x), static_cast<int>(atlasPos.y), static_cast<int>(width), static_cast<int>(height) };
+    render(game.renderer, texture, inAtlas ? &from : NULL, &rekt, linear);
 }
 
 void Image::drawSection(const Frame &section, const Frame &whereToDraw) {
@@ -219,6 +249,11 @@ void Image::drawSection(const Frame &section, const Frame &whereToDraw) {
         static_cast<int>(floor(whereToDraw.size.y)) * m
     };
 
+    if(inAtlas) {
+        rektFrom.x += atlasPos.x;
+        rektFrom.y += atlasPos.y;
+    }
+
     render(game.renderer, texture, &rektFrom, &rektTo, linear);
 }
 
@@ -237,6 +272,11 @@ void Image::drawSection(const Frame &section, const glm::vec2 &whereToDraw) {
         static_cast<int>(floor(section.size.y)) * m
     };
 
+    if(inAtlas) {
+        rektFrom.x += atlasPos.x;
+        rektFrom.y += atlasPos.y;
+    }
+
     render(game.renderer, texture, &rektFrom, &rektTo, linear);
 }
 
@@ -2,6 +2,17 @@
 #include <cstdarg>
 #include <ctime>
 #include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #ifdef __ANDROID__
 #include <android/log.h>
@@ -10,23 +21,222 @@
 using namespace retro;
 using namespace std;
 
-map<string, Logger> Logger::loggers;
 #ifndef NDEBUG
-Logger::LogLevel Logger::logLevel = Logger::LogLevel::Debug;
+Logger::LogLevel Logger::logLevel = Logger::LogLevel(std::min(int(Logger::LogLevel::Debug), RETRO_LOG_LEVEL));
 #else
-Logger::LogLevel Logger::logLevel = Logger::LogLevel::Warning;
+Logger::LogLevel Logger::logLevel = Logger::LogLevel(std::min(int(Logger::LogLevel::Warning), RETRO_LOG_LEVEL));
 #endif
 
+namespace {
+
+    //Number of messages that can wait to be written (must be a power of two)
+    const size_t capacity = 1024;
+    //Messages longer than this are stored in the heap
+    const size_t inlineLength = 232;
+
+    struct Slot {
+        atomic<size_t> sequence;
+        Logger::LogLevel level;
+        uint32_t logger;
+        int64_t time;
+        size_t length;
+        char* heap;
+        char text[inlineLength];
+    };
+
+    //Bounded MPMC queue by Dmitry Vyukov, with only one consumer (the logger thread).
+    //Every slot has a sequence number that tells if it is free to write for the position
+    //`pos` (== pos), ready to be read (== pos + 1) or still in use by the previous lap.
+    struct LogQueue {
+        unique_ptr<Slot[]> slots { new Slot[capacity] };
+        alignas(64) atomic<size_t> enqueuePos { 0 };
+        alignas(64) atomic<size_t> writtenPos { 0 };
+        atomic<size_t> dropped { 0 };
+        bool running = true;
+
+        //Protects the loggers and the sinks (not touched by the threads that log)
+        mutex mtx;
+        deque<Logger> loggers;
+        deque<string> names;
+        unordered_map<string, uint32_t> byName;
+        vector<unique_ptr<Logger::Sink>> sinks;
+
+        //The writer sleeps while the queue is empty, the first message logged wakes it up
+        mutex wakeMutex;
+        condition_variable wake;
+        condition_variable written;
+        atomic<bool> sleeping { false };
+        thread writer;
+
+        LogQueue();
+        ~LogQueue();
+        bool hasMessages() const;
+        void wakeUp();
+        size_t drain();
+        void writeDropped(size_t count);
+    };
+
+    //0 not created, 1 alive, 2 destroyed (static objects still can log while exiting)
+    atomic<int> queueState { 0 };
+
+    LogQueue& queue() {
+        static LogQueue q;
+        return q;
+    }
+
+#ifdef __ANDROID__
+    //On Android we don't care about log level, Android Studio is who applies the filter
+    class AndroidSink: public Logger::Sink {
+    public:
+        void write(const Logger::Record &record) override {
+            int androidLevel;
+            switch(record.level) {
+                case Logger::Error: androidLevel = ANDROID_LOG_ERROR; break;
+                case Logger::Warning: androidLevel = ANDROID_LOG_WARN; break;
+                case Logger::Info: androidLevel = ANDROID_LOG_INFO; break;
+                case Logger::Debug: androidLevel = ANDROID_LOG_DEBUG; break;
+                default: androidLevel = ANDROID_LOG_VERBOSE; break;
+            }
+            __android_log_write(androidLevel, record.name.c_str(), record.message);
+        }
+    };
+#endif
+
+}
+
+LogQueue::LogQueue() {
+    for(size_t i = 0; i < capacity; i++) slots[i].sequence.store(i, memory_order_relaxed);
+    names.push_back("undefined");
+    names.push_back("Logger");
+#ifdef __ANDROID__
+    sinks.emplace_back(new AndroidSink);
+#else
+    sinks.emplace_back(new Logger::TextSink);
+#endif
+    queueState = 1;
+
+    writer = thread([this] () {
+        for(;;) {
+            if(drain() > 0) {
+                lock_guard<mutex> lock(wakeMutex);
+                written.notify_all();
+            }
+
+            unique_lock<mutex> lock(wakeMutex);
+            if(!running) break;
+            sleeping.store(true);
+            //Pairs with the fence in Logger::print(): either the message is seen here, or the thread that logged it sees the writer sleeping
+            atomic_thread_fence(memory_order_seq_cst);
+            if(hasMessages()) {
+                sleeping.store(false);
+                continue;
+            }
+            wake.wait(lock, [this] () { return !sleeping.load() || !running; });
+        }
+    });
+}
+
+LogQueue::~LogQueue() {
+    queueState = 2;
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        running = false;
+    }
+    wake.notify_one();
+    writer.join();
+    written.notify_all();
+    while(drain() > 0);
+}
+
+bool LogQueue::hasMessages() const {
+    size_t pos = writtenPos.load(memory_order_relaxed);
+    return slots[pos & (capacity - 1)].sequence.load(memory_order_acquire) == pos + 1 || dropped.load(memory_order_relaxed) > 0;
+}
+
+void LogQueue::wakeUp() {
+    if(sleeping.exchange(false)) {
+        lock_guard<mutex> lock(wakeMutex);
+        wake.notify_one();
+    }
+}
+
+size_t LogQueue::drain() {
+    lock_guard<mutex> lock(mtx);
+    size_t pos = writtenPos.load(memory_order_relaxed);
+    size_t count = 0;
+    for(;;) {
+        Slot &slot = slots[pos & (capacity - 1)];
+        if(slot.sequence.load(memory_order_acquire) != pos + 1) break;
+
+        const char* message = slot.heap != nullptr ? slot.heap : slot.text;
+        Logger::Record record { slot.level, slot.time, slot.logger, names[slot.logger], message, slot.length };
+        for(auto &sink: sinks) sink->write(record);
+        delete[] slot.heap;
+
+        slot.sequence.store(pos + capacity, memory_order_release);
+        pos++;
+        count++;
+        writtenPos.store(pos, memory_order_release);
+    }
+
+    size_t lost = dropped.exchange(0, memory_order_relaxed);
+    if(lost > 0) writeDropped(lost);
+    if(count > 0 || lost > 0) {
+        for(auto &sink: sinks) sink->flush();
+    }
+    return count;
+}
+
+void LogQueue::writeDropped(size_t count) {
+    char message[64];
+    int length = snprintf(message, sizeof(message), "%zu messages were discarded, the log was full", count);
+    int64_t now = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    Logger::Record record { Logger::Warning, now, 1, names[1], message, size_t(length) };
+    for(auto &sink: sinks) sink->write(record);
+}
+
 Logger& Logger::getLogger(const string &name) {
-    if(loggers.find(name) == loggers.end()) {
-        loggers[name] = Logger(name);
+    LogQueue &q = queue();
+    lock_guard<mutex> lock(q.mtx);
+    auto it = q.byName.find(name);
+    if(it == q.byName.end()) {
+        uint32_t id = uint32_t(q.names.size());
+        q.names.push_back(name);
+        q.loggers.push_back(Logger(id));
+        it = q.byName.emplace(name, id).first;
     }
-    return loggers[name];
+    return q.loggers[it->second - 2];
 }
 
 void Logger::setLogLevel(LogLevel l) {
-    cout << "[!!] Log level changed from " << logLevelToString(logLevel) << " to " << logLevelToString(l) << endl;
-    logLevel = l;
+    flush();
+    printf("[!!] Log level changed from %s to %s\n", logLevelToString(logLevel), logLevelToString(l));
+    if(int(l) > RETRO_LOG_LEVEL) {
+        printf("[!!] Messages above %s are not compiled in, build with RETRO_LOG_LEVEL=%d to see them\n", logLevelToString(LogLevel(RETRO_LOG_LEVEL)), int(l));
+    }
+    fflush(stdout);
+    logLevel = int(l) > RETRO_LOG_LEVEL ? LogLevel(RETRO_LOG_LEVEL) : l;
+}
+
+void Logger::addSink(unique_ptr<Sink> sink) {
+    LogQueue &q = queue();
+    lock_guard<mutex> lock(q.mtx);
+    q.sinks.push_back(move(sink));
+}
+
+void Logger::clearSinks() {
+    LogQueue &q = queue();
+    lock_guard<mutex> lock(q.mtx);
+    q.sinks.clear();
+}
+
+void Logger::flush() {
+    if(queueState != 1) return;
+    LogQueue &q = queue();
+    size_t until = q.enqueuePos.load(memory_order_acquire);
+    q.wakeUp();
+    unique_lock<mutex> lock(q.wakeMutex);
+    q.written.wait(lock, [&q, until] () { return q.writtenPos.load(memory_order_acquire) >= until || !q.running; });
 }
 
 const char* Logger::logLevelToString(Logger::LogLevel level) {
@@ -39,9 +249,15 @@ const char* Logger::logLevelToString(Logger::LogLevel level) {
     }
 }
 
-Logger::Logger(const string &name): name(name) {}
-Logger::Logger(): name("undefined") {}
-Logger::Logger(const Logger &l): name(l.name) {}
+Logger::Logger(uint32_t id): id(id) {}
+Logger::Logger(): id(0) {}
+Logger::Logger(const Logger &l): id(l.id) {}
+
+const string& Logger::getName() const {
+    LogQueue &q = queue();
+    lock_guard<mutex> lock(q.mtx);
+    return q.names[id];
+}
 
 #ifndef _WIN32
 #define attrPrintf __attribute__((format(printf, 2, 3)))
@@ -81,50 +297,221 @@ void Logger::debug(const char* msg, ...) {
     va_end(valist);
 }
 
-void Logger::printTime() {
-    time_t t = time(nullptr);
-	struct tm tm;
-#ifdef _WIN32
-	localtime_s(&tm, &t);
-#else
-    localtime_r(&t, &tm);
-#endif
-    printf("%d-%c%d-%c%d %c%d:%c%d:%c%d - ",
-           tm.tm_year + 1900,
-           tm.tm_mon <  9 ? '0' : '\0', tm.tm_mon + 1,
-           tm.tm_mday< 10 ? '0' : '\0', tm.tm_mday,
-           tm.tm_hour< 10 ? '0' : '\0', tm.tm_hour,
-           tm.tm_min < 10 ? '0' : '\0', tm.tm_min,
-           tm.tm_sec < 10 ? '0' : '\0', tm.tm_sec);
+void Logger::log(LogLevel level, const char* msg, ...) {
+    va_list valist;
+    va_start(valist, msg);
+    print(level, msg, valist);
+    va_end(valist);
 }
 
-#ifndef __ANDROID__
-void Logger::print(LogLevel level, const char* msg, va_list args) {
-    va_list args_copy;
-    va_copy(args_copy, args);
-    if(level <= logLevel) {
-        printTime();
-        int len = 7-int(strlen(logLevelToString(level)));
-        printf("%.*s%s [%s] ", len, "   ", logLevelToString(level), name.c_str());
-        vprintf(msg, args_copy);
-        printf("\n");
+bool Logger::RateLimit::allow(uint32_t &skippedBefore) {
+    const int64_t second = 1000000000;
+    int64_t now = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t start = windowStart.load(memory_order_relaxed);
+    skippedBefore = 0;
+    if(now - start >= second && windowStart.compare_exchange_strong(start, now, memory_order_relaxed)) {
+        //This thread opened a new window
+        count.store(1, memory_order_relaxed);
+        skippedBefore = skipped.exchange(0, memory_order_relaxed);
+        return true;
     }
-    va_end(args_copy);
+
+    if(count.fetch_add(1, memory_order_relaxed) < perSecond) return true;
+    skipped.fetch_add(1, memory_order_relaxed);
+    return false;
 }
-#else
+
 void Logger::print(LogLevel level, const char* msg, va_list args) {
+    //The code that logs can be built with another RETRO_LOG_LEVEL, the one of the engine is applied here
+    if(int(level) > RETRO_LOG_LEVEL) return;
+#ifndef __ANDROID__
+    if(level > logLevel) return;
+#endif
+
+    if(queueState == 2) {
+        //Exiting, the logger thread is gone
+        va_list args_copy;
+        va_copy(args_copy, args);
+        fprintf(stderr, "%s: ", logLevelToString(level));
+        vfprintf(stderr, msg, args_copy);
+        fprintf(stderr, "\n");
+        va_end(args_copy);
+        return;
+    }
+
+    LogQueue &q = queue();
+    int64_t now = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    size_t pos = q.enqueuePos.load(memory_order_relaxed);
+    Slot* slot;
+    for(;;) {
+        slot = &q.slots[pos & (capacity - 1)];
+        intptr_t diff = intptr_t(slot->sequence.load(memory_order_acquire)) - intptr_t(pos);
+        if(diff == 0) {
+            if(q.enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+        } else if(diff < 0) {
+            //Full, the logger thread cannot keep up
+            q.dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        } else {
+            pos = q.enqueuePos.load(memory_order_relaxed);
+        }
+    }
+
     va_list args_copy;
     va_copy(args_copy, args);
-    //On Android we don't care about log level, Android Studio is who applies the filter
-    int androidLevel;
-    switch(level) {
-        case Error: androidLevel = ANDROID_LOG_ERROR; break;
-        case Warning: androidLevel = ANDROID_LOG_WARN; break;
-        case Info: androidLevel = ANDROID_LOG_INFO; break;
-        case Debug: androidLevel = ANDROID_LOG_DEBUG; break;
-        default: androidLevel = ANDROID_LOG_VERBOSE; break;
-    }
-    __android_log_vprint(androidLevel, name.c_str(), msg, args_copy);
+    int length = vsnprintf(slot->text, inlineLength, msg, args_copy);
     va_end(args_copy);
+    slot->heap = nullptr;
+    if(length < 0) {
+        slot->text[0] = '\0';
+        length = 0;
+    } else if(size_t(length) >= inlineLength) {
+        slot->heap = new char[length + 1];
+        va_copy(args_copy, args);
+        vsnprintf(slot->heap, length + 1, msg, args_copy);
+        va_end(args_copy);
+    }
+
+    slot->level = level;
+    slot->logger = id;
+    slot->time = now;
+    slot->length = size_t(length);
+    slot->sequence.store(pos + 1, memory_order_release);
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if(q.sleeping.load(memory_order_relaxed)) q.wakeUp();
+}
+
+
+Logger::TextSink::TextSink(FILE* file): file(file), owned(false) {}
+
+Logger::TextSink::TextSink(const string &path): file(fopen(path.c_str(), "w")), owned(true) {
+    if(file == nullptr) throw runtime_error("Could not open log file " + path + ": " + strerror(errno));
 }
+
+Logger::TextSink::~TextSink() {
+    if(owned) fclose(file);
+}
+
+void Logger::TextSink::write(const Record &record) {
+    //The date only changes once per second, at most
+    int64_t second = record.time / 1000000000;
+    if(second != lastSecond) {
+        time_t t = time_t(second);
+        struct tm tm;
+#ifdef _WIN32
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);
 #endif
+        snprintf(timeStr, sizeof(timeStr), "%d-%02d-%02d %02d:%02d:%02d",
+                 tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        lastSecond = second;
+    }
+
+    fprintf(file, "%s - %7s [%s] ", timeStr, logLevelToString(record.level), record.name.c_str());
+    fwrite(record.message, 1, record.length, file);
+    fputc('\n', file);
+}
+
+void Logger::TextSink::flush() {
+    fflush(file);
+}
+
+
+Logger::JsonSink::JsonSink(const string &path): file(fopen(path.c_str(), "w")) {
+    if(file == nullptr) throw runtime_error("Could not open log file " + path + ": " + strerror(errno));
+}
+
+Logger::JsonSink::~JsonSink() {
+    fclose(file);
+}
+
+static void appendJsonString(string &line, const char* str, size_t length) {
+    line += '"';
+    for(size_t i = 0; i < length; i++) {
+        char c = str[i];
+        switch(c) {
+            case '"': line += "\\\""; break;
+            case '\\': line += "\\\\"; break;
+            case '\n': line += "\\n"; break;
+            case '\r': line += "\\r"; break;
+            case '\t': line += "\\t"; break;
+            default:
+                if(uint8_t(c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(c));
+                    line += escaped;
+                } else {
+                    line += c;
+                }
+        }
+    }
+    line += '"';
+}
+
+void Logger::JsonSink::write(const Record &record) {
+    char number[24];
+    snprintf(number, sizeof(number), "%lld", (long long) record.time);
+    line.clear();
+    line += "{\"time\":";
+    line += number;
+    line += ",\"level\":\"";
+    line += logLevelToString(record.level);
+    line += "\",\"logger\":";
+    appendJsonString(line, record.name.c_str(), record.name.size());
+    line += ",\"message\":";
+    appendJsonString(line, record.message, record.length);
+    line += "}\n";
+    fwrite(line.data(), 1, line.size(), file);
+}
+
+void Logger::JsonSink::flush() {
+    fflush(file);
+}
+
+
+Logger::BinarySink::BinarySink(const string &path): file(fopen(path.c_str(), "wb")) {
+    if(file == nullptr) throw runtime_error("Could not open log file " + path + ": " + strerror(errno));
+    const uint32_t version = 1;
+    fwrite("RLOG", 1, 4, file);
+    fwrite(&version, sizeof(version), 1, file);
+}
+
+Logger::BinarySink::~BinarySink() {
+    fclose(file);
+}
+
+void Logger::BinarySink::write(const Record &record) {
+    if(record.logger >= knownSize) {
+        size_t newSize = std::max(size_t(record.logger) + 1, knownSize * 2);
+        unique_ptr<bool[]> newKnown(new bool[newSize]());
+        for(size_t i = 0; i < knownSize; i++) newKnown[i] = known[i];
+        known = move(newKnown);
+        knownSize = newSize;
+    }
+
+    if(!known[record.logger]) {
+        const uint8_t kind = 0;
+        const uint16_t length = uint16_t(record.name.size());
+        fwrite(&kind, sizeof(kind), 1, file);
+        fwrite(&record.logger, sizeof(record.logger), 1, file);
+        fwrite(&length, sizeof(length), 1, file);
+        fwrite(record.name.data(), 1, length, file);
+        known[record.logger] = true;
+    }
+
+    const uint8_t kind = 1;
+    const uint8_t level = uint8_t(record.level);
+    const uint32_t length = uint32_t(record.length);
+    fwrite(&kind, sizeof(kind), 1, file);
+    fwrite(&level, sizeof(level), 1, file);
+    fwrite(&record.time, sizeof(record.time), 1, file);
+    fwrite(&record.logger, sizeof(record.logger), 1, file);
+    fwrite(&length, sizeof(length), 1, file);
+    fwrite(record.message, 1, length, file);
+}
+
+void Logger::BinarySink::flush() {
+    fflush(file);
+}
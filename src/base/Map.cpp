@@ -3,121 +3,333 @@
 #include <glm/vec4.hpp>
 #include <Game.hpp>
 #include <Sprites.hpp>
+#include <AssetLoader.hpp>
+#include <TileFile.hpp>
 
 #if !defined(_WIN32) and !defined(__ANDROID__) and !defined(__IOS__)
 #include <SDL2/SDL.h>
 #else
 #include <SDL.h>
 #endif
+#include "TextureUpdate.hpp"
 
 using namespace retro;
 using namespace glm;
 using namespace std;
 
+//Chunks of 16x16 cells, and how many chunk textures are kept before reusing the oldest ones
+static constexpr uint32_t chunkCells = 16;
+static constexpr uint32_t chunkPixels = chunkCells * 8;
+static constexpr size_t maxChunks = 96;
+//Size of the description of a layer in the file: parallax, visibility and collision mask
+static constexpr size_t layerRecordSize = 2 * sizeof(float) + sizeof(uint8_t) + sizeof(uint32_t);
+
+static void freeLayers(vector<MapLayer> &layers) {
+    for(auto &layer: layers) free(layer.cells);
+    layers.clear();
+}
+
+//Versions 2 and 3 have a header. Version 3 adds the layers, and cells of 16 bit stored in two planes (low and high bytes)
+//for every layer, and the layers are described after the path of the sprites. Legacy files have the cells
+//(8 bit), the path of the sprites file ending with a new line, and the size. Returns the path of the sprites.
+static string readMapFile(Span<const uint8_t> file, uvec2 &size, vector<MapLayer> &layers) {
+    TileFile header;
+    string spritePath;
+    vector<MapLayer> described(1);
+    vector<uint8_t> decoded;
+    const uint8_t* bytes;
+    size_t planes = 1;
+    if(TileFile::parse(file, "RMAP", header)) {
+        spritePath = header.extra;
+        if(header.flags & TileFile::Layers) {
+            const size_t end = header.extra.find('\0');
+            if(end == string::npos || (header.extra.size() - end - 1) % layerRecordSize != 0) throw runtime_error("The layers are corrupt");
+            spritePath.resize(end);
+            described.resize((header.extra.size() - end - 1) / layerRecordSize);
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(header.extra.data()) + end + 1;
+            for(auto &layer: described) {
+                memcpy(&layer.parallax.x, p, sizeof(float));
+                memcpy(&layer.parallax.y, p + sizeof(float), sizeof(float));
+                layer.visible = p[2 * sizeof(float)] != 0;
+                memcpy(&layer.collisionMask, p + 2 * sizeof(float) + sizeof(uint8_t), sizeof(uint32_t));
+                p += layerRecordSize;
+            }
+        }
+        if(header.flags & TileFile::WideCells) planes = 2;
+        if(described.empty() || described.size() > 64 || header.size.y % (described.size() * planes) != 0) throw runtime_error("The layers are corrupt");
+        size = { header.size.x, header.size.y / uint32_t(described.size() * planes) };
+        decoded.resize(header.cells());
+        header.decode(decoded.data());
+        bytes = decoded.data();
+    } else {
+        if(file.size() < 2 * sizeof(size.x)) throw runtime_error("The file is truncated");
+        const uint8_t* sizeStart = file.end() - 2 * sizeof(size.x);
+        memcpy(&size.x, sizeStart, sizeof(size.x));
+        memcpy(&size.y, sizeStart + sizeof(size.x), sizeof(size.y));
+        const size_t tiles = size_t(size.x) * size_t(size.y);
+        if(tiles > size_t(sizeStart - file.data())) throw runtime_error("The file is truncated");
+
+        const char* pathStart = reinterpret_cast<const char*>(file.data() + tiles);
+        const void* newLine = memchr(pathStart, '\n', size_t(sizeStart - file.data()) - tiles);
+        spritePath.assign(pathStart, newLine != nullptr ? static_cast<const char*>(newLine) : reinterpret_cast<const char*>(sizeStart));
+        bytes = file.data();
+    }
+
+    const size_t cells = size_t(size.x) * size_t(size.y);
+    for(size_t n = 0; n < described.size(); n++) {
+        const uint8_t* low = bytes + n * planes * cells;
+        const uint8_t* high = low + cells;
+        uint16_t* out = reinterpret_cast<uint16_t*>(malloc(cells * sizeof(uint16_t)));
+        if(planes == 2) {
+            for(size_t i = 0; i < cells; i++) out[i] = uint16_t(low[i] | high[i] << 8);
+        } else {
+            for(size_t i = 0; i < cells; i++) out[i] = low[i];
+        }
+        described[n].cells = out;
+    }
+    layers.swap(described);
+    return spritePath;
+}
+
+static void writeMapFile(OutputFile &o, const uvec2 &size, const vector<MapLayer> &layers, const string &spritePath) {
+    const size_t cells = size_t(size.x) * size_t(size.y);
+    vector<uint8_t> bytes(cells * 2 * layers.size());
+    string extra = spritePath;
+    extra.push_back('\0');
+    for(size_t n = 0; n < layers.size(); n++) {
+        const MapLayer &layer = layers[n];
+        uint8_t* low = bytes.data() + n * 2 * cells;
+        uint8_t* high = low + cells;
+        for(size_t i = 0; i < cells; i++) {
+            low[i] = uint8_t(layer.cells[i]);
+            high[i] = uint8_t(layer.cells[i] >> 8);
+        }
+
+        uint8_t record[layerRecordSize];
+        const uint8_t visible = layer.visible ? 1 : 0;
+        memcpy(record, &layer.parallax.x, sizeof(float));
+        memcpy(record + sizeof(float), &layer.parallax.y, sizeof(float));
+        memcpy(record + 2 * sizeof(float), &visible, sizeof(uint8_t));
+        memcpy(record + 2 * sizeof(float) + sizeof(uint8_t), &layer.collisionMask, sizeof(uint32_t));
+        extra.append(reinterpret_cast<const char*>(record), layerRecordSize);
+    }
+    TileFile::write(o, "RMAP", { size.x, size.y * 2 * uint32_t(layers.size()) }, bytes.data(), extra, TileFile::WideCells | TileFile::Layers);
+}
+
 Map Map::createMap(const string &path, Game &g, const Sprites &sprites, const uvec2 &initialSize) {
     OutputFile i = g.openWriteFile(path);
-    for(size_t p = 0; p < initialSize.x * initialSize.y; p++) {
-        char c = '\0';
-        i.write(&c, sizeof(char));
-    }
-    i.write(sprites.path.c_str(), sprites.path.length());
-    i << '\n';
-    i.write<uint32_t>(&initialSize.x, 1);
-    i.write<uint32_t>(&initialSize.y, 1);
+    vector<uint16_t> empty(size_t(initialSize.x) * size_t(initialSize.y), 0);
+    MapLayer layer;
+    layer.cells = empty.data();
+    writeMapFile(i, initialSize, { layer }, sprites.path);
     i.close();
     return Map(path, g);
 }
 
-Map::Map(const string &path, Game &g): game(g), data(*new uint8_t*(nullptr)), path(path), references(*new atomic_size_t(1)) {
-    InputOutputFile i = g.openFile(path);
+Map::Map(const string &path, Game &g): game(g), layers(*new vector<MapLayer>()), path(path), chunks(*new vector<Chunk>()), frameCount(*new uint64_t(0)), references(*new atomic_size_t(1)), version(*new atomic<uint32_t>(0)) {
+    InputFile i = g.openReadFile(path);
     if(!i.ok()) {
         throw runtime_error("Cannot read map file '" + path + "'");
     } else {
-        if(i.seeki(-int64_t(2ull*sizeof(size.x)), BasicFile::End) == -1)
-            throw runtime_error("Invalid map file '" + path + "'");
-        i.read<uint32_t>(&size.x, 1);
-        i.read<uint32_t>(&size.y, 1);
-        i.seeki(0, BasicFile::Beginning);
-        this->data = reinterpret_cast<uint8_t*>(malloc(size.x * size.y));
-        i.read(reinterpret_cast<char*>(data), size.x * size.y);
-        string spritePath = i.readline();
-        sprites = new Sprites(spritePath, g);
+        auto file = i.readAll();
         i.close();
+        string spritePath;
+        try {
+            spritePath = readMapFile(file, size, layers);
+        } catch(const runtime_error &e) {
+            throw runtime_error("Invalid map file '" + path + "': " + e.what());
+        }
+        sprites = new Sprites(spritePath, g);
     }
-
-    surface = nullptr;
-    texture = nullptr;
-    pixels  = nullptr;
 }
 
-Map::Map(const Map &map): game(map.game), data(map.data), sprites(map.sprites), references(map.references) {
+Map::Map(const Map &map): game(map.game), layers(map.layers), sprites(map.sprites), chunks(map.chunks), frameCount(map.frameCount), references(map.references), version(map.version) {
     size = map.size;
     path = map.path;
-    pixels = map.pixels;
-    surface = map.surface;
-    texture = map.texture;
+    texturesReady = map.texturesReady;
     references++;
 }
 
-Map::Map(Map &&map): game(map.game), data(map.data), sprites(map.sprites), references(map.references) {
+Map::Map(Map &&map): game(map.game), layers(map.layers), sprites(map.sprites), chunks(map.chunks), frameCount(map.frameCount), references(map.references), version(map.version) {
     size = map.size;
     path = map.path;
-    pixels = map.pixels; map.pixels = nullptr;
-    surface = map.surface; map.surface = nullptr;
-    texture = map.texture; map.texture = nullptr;
+    texturesReady = map.texturesReady;
     references++;
 }
 
 Map::~Map() {
     if(references.fetch_sub(1) == 1) {
         if(sprites != nullptr) delete sprites;
-        if(texture != nullptr) SDL_DestroyTexture(texture);
-        if(texture != nullptr) SDL_FreeSurface(surface);
-        if(pixels  != nullptr) free(pixels);
-        if(data    != nullptr) free(data);
-        delete &data;
+        for(auto &c: chunks) {
+            if(c.texture != nullptr) SDL_DestroyTexture(c.texture);
+        }
+        freeLayers(layers);
+        delete &layers;
+        delete &chunks;
+        delete &frameCount;
         delete &references;
+        delete &version;
+    }
+}
+
+uint16_t& Map::at(size_t x, size_t y) {
+    version.fetch_add(1, memory_order_relaxed);
+    return layers[0].cells[y * size.x + x];
+}
+
+uint16_t& Map::at(size_t x, size_t y, size_t layer) {
+    version.fetch_add(1, memory_order_relaxed);
+    return layers[layer].cells[y * size.x + x];
+}
+
+void Map::set(size_t x, size_t y, size_t layer, uint16_t sprite) {
+    uint16_t &cell = layers[layer].cells[y * size.x + x];
+    if(cell != sprite) {
+        cell = sprite;
+        version.fetch_add(1, memory_order_relaxed);
     }
 }
 
-uint8_t& Map::at(size_t x, size_t y) {
-    return data[y * size.x + x];
+MapRegion Map::region(const Frame &cells, size_t layer) {
+    version.fetch_add(1, memory_order_relaxed);
+    const MapRegion all = { layers.at(layer).cells, size.x, size };
+    //Both ends are clipped, the part of the frame before the map is not part of the region
+    const vec2 start = glm::max(cells.pos, vec2(0));
+    const vec2 end = glm::max(cells.pos + cells.size, start);
+    return all.sub(uvec2(start), uvec2(end - start));
+}
+
+MapLayer& Map::layer(size_t n) {
+    version.fetch_add(1, memory_order_relaxed);
+    return layers.at(n);
+}
+
+size_t Map::addLayer(const vec2 &parallax) {
+    if(layers.size() >= 64) throw runtime_error("A map cannot have more than 64 layers");
+    MapLayer layer;
+    layer.cells = reinterpret_cast<uint16_t*>(calloc(size_t(size.x) * size_t(size.y), sizeof(uint16_t)));
+    layer.parallax = parallax;
+    layer.collisionMask = 0;
+    layers.push_back(layer);
+    version.fetch_add(1, memory_order_relaxed);
+    return layers.size() - 1;
+}
+
+void Map::removeLayer(size_t n) {
+    if(layers.size() == 1) throw runtime_error("The last layer of a map cannot be removed");
+    free(layers.at(n).cells);
+    layers.erase(layers.begin() + n);
+    //The layers over it have now another index
+    invalidateChunks({ 0, 0 }, size);
+    version.fetch_add(1, memory_order_relaxed);
 }
 
 void Map::resize(const uvec2 &size) {
     //TODO
 }
 
+Map Map::load(const string &path, Game &g) {
+    return g.getAssetLoader().getMap(path);
+}
+
 void Map::regenerateTextures() {
-    if(texture != nullptr) SDL_DestroyTexture(texture);
-    if(surface != nullptr) SDL_FreeSurface(surface);
-    uint32_t w = 8 * size.x;
-    uint32_t h = 8 * size.y;
-    pixels = (uint32_t*) realloc(pixels, w * h * sizeof(uint32_t));
-
-    for(size_t y = 0; y < h; y++) {
-        for(size_t x = 0; x < w; x++) {
-            uint8_t nsprite = data[y / 8 * w / 8 + x / 8];
-            if(nsprite > 0) {
-                const Sprite sprite = (*sprites)[nsprite - 1];
-                uint8_t col = sprite.at(x % 8, y % 8);
-                if(col != 0) {
-                    Color rgba = game.getPalette()[size_t(col)].value();
-                    uint32_t mix = rgba.a << 24 | rgba.b << 16 | rgba.g << 8 | rgba.r;
-                    pixels[y * w + x] = mix;
-                } else {
-                    pixels[y * w + x] = 0x00000000;
+    regeneratePixels();
+    uploadTextures();
+}
+
+void Map::regenerateTextures(const Frame &cells) {
+    if(!texturesReady) {
+        regenerateTextures();
+        return;
+    }
+
+    const uvec2 start = glm::min(uvec2(glm::max(cells.pos, vec2(0))), size);
+    const uvec2 end = glm::min(uvec2(glm::max(cells.pos + cells.size, vec2(0))), size);
+    if(start.x >= end.x || start.y >= end.y) return;
+    invalidateChunks(start, end);
+}
+
+void Map::regeneratePixels() {
+    regeneratePixels(game.getPalette().data());
+}
+
+void Map::regeneratePixels(const uint32_t* colors) {
+    //The chunks are shared with the main thread, they are invalidated when the pixels are uploaded
+    sprites->regeneratePixels(colors);
+}
+
+void Map::uploadTextures() {
+    sprites->uploadTextures();
+    invalidateChunks({ 0, 0 }, size);
+    texturesReady = true;
+}
+
+void Map::invalidateChunks(const uvec2 &start, const uvec2 &end) {
+    for(auto &c: chunks) {
+        const uvec2 chunkStart = c.pos * chunkCells;
+        const uvec2 chunkEnd = chunkStart + chunkCells;
+        if(chunkStart.x < end.x && start.x < chunkEnd.x && chunkStart.y < end.y && start.y < chunkEnd.y) c.dirty = true;
+    }
+}
+
+Map::Chunk& Map::chunk(uint64_t layerMask, const uvec2 &pos) {
+    Chunk* oldest = nullptr;
+    for(auto &c: chunks) {
+        if(c.layers == layerMask && c.pos == pos) {
+            c.lastUsed = frameCount;
+            return c;
+        }
+        if(oldest == nullptr || c.lastUsed < oldest->lastUsed) oldest = &c;
+    }
+
+    //The texture of a chunk that was not drawn in this frame is reused
+    if(chunks.size() >= maxChunks && oldest->lastUsed < frameCount) {
+        *oldest = { layerMask, pos, oldest->texture, frameCount, true };
+        return *oldest;
+    }
+
+    SDL_Texture* texture = SDL_CreateTexture(game.renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STATIC, chunkPixels, chunkPixels);
+    if(texture != nullptr) SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    chunks.push_back({ layerMask, pos, texture, frameCount, true });
+    return chunks.back();
+}
+
+void Map::compose(Chunk &chunk) {
+    const uint32_t* spritePixels = sprites->pixels;
+    if(spritePixels == nullptr) return;
+    //Only full rows of sprites have pixels
+    const size_t spriteCount = sprites->size() / 16 * 16;
+    const uvec2 start = chunk.pos * chunkCells;
+    const uvec2 end = glm::min(start + chunkCells, size);
+    vector<uint32_t> buffer(chunkPixels * chunkPixels, 0);
+
+    //The first layer is copied as it is, the layers over it only where they are not transparent
+    bool first = true;
+    for(size_t n = 0; n < layers.size(); n++) {
+        if(!((chunk.layers >> n) & 1)) continue;
+        const uint16_t* cells = layers[n].cells;
+        for(uint32_t y = start.y; y < end.y; y++) {
+            for(uint32_t x = start.x; x < end.x; x++) {
+                const uint16_t cell = cells[y * size.x + x];
+                if(cell == 0 || cell > spriteCount) continue;
+                const uint32_t* src = spritePixels + ((cell - 1) / 16) * 8 * (8 * 16) + ((cell - 1) % 16) * 8;
+                uint32_t* dst = buffer.data() + (y - start.y) * 8 * chunkPixels + (x - start.x) * 8;
+                for(size_t py = 0; py < 8; py++, src += 8 * 16, dst += chunkPixels) {
+                    if(first) {
+                        memcpy(dst, src, 8 * sizeof(uint32_t));
+                    } else {
+                        for(size_t px = 0; px < 8; px++) {
+                            if(src[px] >> 24) dst[px] = src[px];
+                        }
+                    }
                 }
-            } else {
-                pixels[y * w + x] = 0x00000000;
             }
         }
+        first = false;
     }
 
-    surface = SDL_CreateRGBSurfaceFrom(pixels, w, h, 32, sizeof(uint32_t)*w, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
-    texture = SDL_CreateTextureFromSurface(game.renderer, surface);
-
-    sprites->regenerateTextures();
+    update_texture_rekt(chunk.texture, buffer.data(), chunkPixels, { 0, 0, int(chunkPixels), int(chunkPixels) });
+    chunk.dirty = false;
 }
 
 void Map::save() {
@@ -126,41 +338,74 @@ void Map::save() {
         throw runtime_error("Cannot write map file '" + this->path + "'");
     }
 
-    o.write(reinterpret_cast<char*>(data), size.x * size.y);
-    o.write(sprites->path.c_str(), sprites->path.length());
-    o << '\n';
-    o.write(reinterpret_cast<const char*>(&size.x), sizeof(size.x));
-    o.write(reinterpret_cast<const char*>(&size.y), sizeof(size.y));
+    writeMapFile(o, size, layers, sprites->path);
     o.close();
 }
 
 void Map::reload() {
     InputFile i = game.openReadFile(path);
-    uvec2 fileSize;
-    i.seeki(-int64_t(2ull * sizeof(size.x)), BasicFile::End);
-    i.read<uint32_t>(&fileSize.x, 1);
-    i.read<uint32_t>(&fileSize.y, 1);
-    i.seeki(0, BasicFile::Beginning);
-    i.read(reinterpret_cast<char*>(data), size.x * size.y);
+    auto file = i.readAll();
     i.close();
+    vector<MapLayer> loaded;
+    uvec2 loadedSize;
+    readMapFile(file, loadedSize, loaded);
+    if(loadedSize == size) {
+        layers.swap(loaded);
+        invalidateChunks({ 0, 0 }, size);
+        version.fetch_add(1, memory_order_relaxed);
+    }
+    freeLayers(loaded);
 	sprites->reload();
 }
 
 SDL_Rect get_rekt(const vec2 &pos, const vec2 &size, bool doubleIt);
 void Map::draw(const Frame &frame) {
-    float px = glm::min(glm::max(-(frame.pos.x), 0.0f), (size.x * 8.0f));
-    float py = glm::min(glm::max(-(frame.pos.y), 0.0f), (size.y * 8.0f));
-    float px2 = glm::max((frame.pos.x), 0.0f);
-    float py2 = glm::max((frame.pos.y), 0.0f);
-    auto cp = game.currentLevel->ga.camera();
-    SDL_Rect src = {
-        static_cast<int>(px),
-        static_cast<int>(py),
-        static_cast<int>(frame.size.x),
-        static_cast<int>(frame.size.y)
-    };
-    SDL_Rect dst = get_rekt(vec2(px2, py2) - cp, frame.size, game.currentLevel->ga.doubleIt);
-    SDL_RenderCopy(game.renderer, texture, &src, &dst);
+    if(!texturesReady) return;
+    frameCount++;
+    GameActions &ga = game.currentLevel->ga;
+    const vec2 cp = ga.camera();
+    const vec2 canvas = vec2(ga.canvasSize());
+    //The part of the map inside the frame, in map pixels
+    const vec2 from = glm::max(-frame.pos, vec2(0));
+    const vec2 to = glm::min(from + frame.size, vec2(size * 8u));
+
+    size_t n = 0;
+    while(n < layers.size()) {
+        if(!layers[n].visible) {
+            n++;
+            continue;
+        }
+
+        //Consecutive visible layers with the same parallax are drawn together
+        const vec2 parallax = layers[n].parallax;
+        uint64_t mask = 0;
+        for(; n < layers.size() && (!layers[n].visible || layers[n].parallax == parallax); n++) {
+            if(layers[n].visible) mask |= uint64_t(1) << n;
+        }
+
+        //A pixel of the map is drawn at frame.pos + pixel - camera * parallax
+        const vec2 origin = frame.pos - cp * parallax;
+        const vec2 start = glm::floor(glm::max(from, -origin));
+        const vec2 end = glm::ceil(glm::min(to, canvas - origin));
+        if(start.x >= end.x || start.y >= end.y) continue;
+
+        const uvec2 firstChunk = uvec2(start) / chunkPixels;
+        const uvec2 lastChunk = (uvec2(end) - 1u) / chunkPixels;
+        for(uint32_t cy = firstChunk.y; cy <= lastChunk.y; cy++) {
+            for(uint32_t cx = firstChunk.x; cx <= lastChunk.x; cx++) {
+                Chunk &c = chunk(mask, { cx, cy });
+                if(c.texture == nullptr) continue;
+                if(c.dirty) compose(c);
+
+                const vec2 chunkPos = vec2(cx, cy) * float(chunkPixels);
+                const vec2 s = glm::max(start, chunkPos);
+                const vec2 e = glm::min(end, chunkPos + float(chunkPixels));
+                SDL_Rect src = { int(s.x - chunkPos.x), int(s.y - chunkPos.y), int(e.x - s.x), int(e.y - s.y) };
+                SDL_Rect dst = get_rekt(origin + s, e - s, ga.doubleIt);
+                SDL_RenderCopy(game.renderer, c.texture, &src, &dst);
+            }
+        }
+    }
 }
 
 const Sprites* Map::getSprites() const {
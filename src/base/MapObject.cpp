@@ -0,0 +1,101 @@
+#include <MapObject.hpp>
+#include <cmath>
+
+using namespace retro;
+using namespace glm;
+using namespace std;
+
+void MapObject::rebuildSolidCells() const {
+    //The version is read before the cells, so a change done while rebuilding is seen next time
+    solidVersion = getVersion();
+    solidDirty = false;
+    const size_t cells = size_t(getSize().x) * size_t(getSize().y);
+    solidCells.resize(getLayerCount());
+    for(size_t n = 0; n < getLayerCount(); n++) {
+        const uint16_t* layerCells = layer(n).cells;
+        auto &bits = solidCells[n];
+        bits.assign((cells + 63) / 64, 0);
+        for(size_t i = 0; i < cells; i++) {
+            if(invalidSprites[layerCells[i]]) bits[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+}
+
+//Cells covered by the interval [start, end), in map cells
+static inline void cellRange(float start, float end, int &first, int &last) {
+    first = int(floor(start / 8.0f));
+    last = int(ceil(end / 8.0f)) - 1;
+    if(last < first) last = first;
+}
+
+bool MapObject::sweep(const Frame &box, const vec2 &motion, MapHit &hit, uint32_t mask) const {
+    //Everything in pixels relative to the map
+    const vec2 start = box.pos - frame.pos;
+    const vec2 end = start + box.size;
+    const ivec2 mapSize = ivec2(getSize());
+
+    //For every axis: the next column (or row) the leading edge enters, when it does, and
+    //how long it takes to cross a cell. When the motion stops in that axis, it never enters.
+    ivec2 step, next;
+    vec2 tNext, tDelta;
+    for(int a = 0; a < 2; a++) {
+        if(motion[a] > 0.0f) {
+            step[a] = 1;
+            next[a] = int(ceil(end[a] / 8.0f));
+            tNext[a] = (next[a] * 8.0f - end[a]) / motion[a];
+            tDelta[a] = 8.0f / motion[a];
+        } else if(motion[a] < 0.0f) {
+            step[a] = -1;
+            next[a] = int(floor(start[a] / 8.0f)) - 1;
+            tNext[a] = ((next[a] + 1) * 8.0f - start[a]) / motion[a];
+            tDelta[a] = -8.0f / motion[a];
+        } else {
+            step[a] = 0;
+            next[a] = 0;
+            tNext[a] = INFINITY;
+            tDelta[a] = INFINITY;
+        }
+    }
+
+    while(true) {
+        //The axis whose boundary is crossed first (x when both are crossed at the same time)
+        const int a = tNext.x <= tNext.y ? 0 : 1;
+        const int o = 1 - a;
+        const float t = tNext[a];
+        if(t > 1.0f) return false;
+
+        //Once the leading edge leaves the map, no more solid cells can be found in that axis
+        if((step[a] > 0 && next[a] >= mapSize[a]) || (step[a] < 0 && next[a] < 0)) {
+            tNext[a] = INFINITY;
+            continue;
+        }
+
+        //The strip of cells entered, covered by the frame in the other axis at that moment. If
+        //it is moving in that axis too, a cell touched only by the corner counts, or it would be
+        //skipped when both boundaries are crossed at the same time.
+        int first, last;
+        const float s = start[o] + motion[o] * t;
+        const float e = end[o] + motion[o] * t;
+        cellRange(s, e, first, last);
+        if(step[o] > 0 && fmod(e, 8.0f) == 0.0f) last++;
+        if(step[o] < 0 && fmod(s, 8.0f) == 0.0f) first--;
+        first = std::max(first, 0);
+        last = std::min(last, mapSize[o] - 1);
+
+        for(int i = first; i <= last; i++) {
+            ivec2 cell;
+            cell[a] = next[a];
+            cell[o] = i;
+            if(isSolid(cell, mask)) {
+                hit.time = std::max(t, 0.0f);
+                hit.cell = cell;
+                if(a == 0) hit.face = step.x > 0 ? RIGHT : LEFT;
+                else hit.face = step.y > 0 ? BOTTOM : TOP;
+                return true;
+            }
+        }
+
+        next[a] += step[a];
+        tNext[a] += tDelta[a];
+    }
+}
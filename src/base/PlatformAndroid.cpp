@@ -23,6 +23,12 @@ JNICALL extern "C" void Java_me_melchor9000_retro_RetroActivity_tellScale(JNIEnv
     retro::_android_factor_scale = scale;
 }
 
+bool retro::waitForCommand() {
+    return false;
+}
+
+void retro::stopWaitingForCommands() {}
+
 void retro::sendCommandResponse(const Command &cmd, const nlohmann::json &resp) {}
 
 #include "SDLFileImpl.hpp"
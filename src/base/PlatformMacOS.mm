@@ -56,12 +56,19 @@ std::error_condition retro::getLastError() {
 
 #include<arpa/inet.h>
 #include<sys/socket.h>
+#include<poll.h>
+#include<unistd.h>
+#include<mutex>
 static int s4 = -1;
 static int s6 = -1;
-Optional<Command> retro::getCommand() {
-    auto showError = [] (const char* str) -> Optional<Command> { perror(str); return {}; };
-    if(s4 == -1) {
-        if((s4 = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1) { s4 = 0; return showError("Could not open IPv4 socket"); }
+static int wakeUpPipe[2] = { -1, -1 };
+static std::once_flag socketsOpened;
+
+//Opened once, from the loop or from the thread that waits for the commands
+static void openSockets() {
+    if((s4 = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1) {
+        perror("Could not open IPv4 socket");
+    } else {
         sockaddr_in serv;
         memset(&serv, 0, sizeof(serv));
         serv.sin_family = AF_INET;
@@ -69,13 +76,22 @@ Optional<Command> retro::getCommand() {
         serv.sin_addr.s_addr = htonl(0x7f000001); //127.0.0.1
         int opt = 1; //Avoid "Address already in use" error
         setsockopt(s4, SOL_SOCKET, SO_REUSEADDR, (char*) &opt, sizeof(opt));
-        if(bind(s4, (sockaddr*) &serv, sizeof(serv)) == -1) return showError("Could not bind tcp://127.0.0.1:32145");
-        if(listen(s4, 1) == -1) return showError("Could not listen tcp://127.0.0.1:31245");
-        fcntl(s4, F_SETFL, O_NONBLOCK);
+        if(bind(s4, (sockaddr*) &serv, sizeof(serv)) == -1) {
+            perror("Could not bind tcp://127.0.0.1:32145");
+            close(s4);
+            s4 = -1;
+        } else if(listen(s4, 1) == -1) {
+            perror("Could not listen tcp://127.0.0.1:32145");
+            close(s4);
+            s4 = -1;
+        } else {
+            fcntl(s4, F_SETFL, O_NONBLOCK);
+        }
     }
 
-    if(s6 == -1) {
-        if((s6 = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP)) == -1) { s6 = 0; return showError("Could not open IPv6 socket"); }
+    if((s6 = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP)) == -1) {
+        perror("Could not open IPv6 socket");
+    } else {
         sockaddr_in6 serv;
         memset(&serv, 0, sizeof(serv));
         serv.sin6_family = AF_INET6;
@@ -83,13 +99,29 @@ Optional<Command> retro::getCommand() {
         serv.sin6_addr = IN6ADDR_LOOPBACK_INIT;
         int opt = 1; //Avoid "Address already in use" error
         setsockopt(s6, SOL_SOCKET, SO_REUSEADDR, (char*) &opt, sizeof(opt));
-        if(bind(s6, (sockaddr*) &serv, sizeof(serv)) == -1) return showError("Could not bind tcp://[::1]:32145");
-        if(listen(s6, 1) == -1) return showError("Could not listen tcp://[::1]:31245");
-        fcntl(s6, F_SETFL, O_NONBLOCK);
+        if(bind(s6, (sockaddr*) &serv, sizeof(serv)) == -1) {
+            perror("Could not bind tcp://[::1]:32145");
+            close(s6);
+            s6 = -1;
+        } else if(listen(s6, 1) == -1) {
+            perror("Could not listen tcp://[::1]:32145");
+            close(s6);
+            s6 = -1;
+        } else {
+            fcntl(s6, F_SETFL, O_NONBLOCK);
+        }
     }
 
+    //stopWaitingForCommands() writes into it to wake up waitForCommand()
+    if(pipe(wakeUpPipe) == -1) perror("Could not open a pipe for the commands");
+}
+
+Optional<Command> retro::getCommand() {
+    std::call_once(socketsOpened, openSockets);
+
     char buff[1500];
     for(auto s: std::vector<int>{ s4, s6 }) {
+        if(s == -1) continue;
         int sock = accept(s, NULL, NULL);
         if(sock != -1) {
             ssize_t readBytes = recv(sock, buff, 1500, 0);
@@ -115,10 +147,27 @@ Optional<Command> retro::getCommand() {
     return {};
 }
 
+bool retro::waitForCommand() {
+    std::call_once(socketsOpened, openSockets);
+    if(wakeUpPipe[0] == -1) return false;
+    //Negative descriptors are ignored
+    pollfd fds[] = { { wakeUpPipe[0], POLLIN, 0 }, { s4, POLLIN, 0 }, { s6, POLLIN, 0 } };
+    while(poll(fds, 3, -1) == -1) {
+        if(errno != EINTR) return false;
+    }
+    return fds[0].revents == 0 && ((fds[1].revents | fds[2].revents) & POLLIN) != 0;
+}
+
+void retro::stopWaitingForCommands() {
+    std::call_once(socketsOpened, openSockets);
+    if(wakeUpPipe[1] != -1 && write(wakeUpPipe[1], "", 1) == -1) perror("Could not stop waiting for commands");
+}
+
 void retro::sendCommandResponse(const Command &cmd, const nlohmann::json &resp) {
     if(cmd._priv_data == nullptr) {
-        close(s4);
-        close(s6);
+        for(int fd: { s4, s6, wakeUpPipe[0], wakeUpPipe[1] }) {
+            if(fd != -1) close(fd);
+        }
     } else {
         auto sock = (int) (long) cmd._priv_data;
         auto json = resp.dump();
@@ -129,5 +178,5 @@ void retro::sendCommandResponse(const Command &cmd, const nlohmann::json &resp)
 }
 
 
-#include "StdFileImpl.hpp"
+#include "PosixFileImpl.hpp"
 
@@ -16,23 +16,27 @@ std::error_condition retro::getLastError() {
 #pragma comment(lib, "Ws2_32.lib")
 #include <WinSock2.h>
 #include <ws2tcpip.h>
+#include <mutex>
 static WSADATA wsaData;
 static bool initializedWinSock = false;
 static SOCKET s4 = -1;
 static SOCKET s6 = -1;
-Optional<Command> retro::getCommand() {
-	auto showError = [](const char* str) -> Optional<Command> { perror(str); return {}; };
-	if(!initializedWinSock) {
-		int r = WSAStartup(MAKEWORD(2, 2), &wsaData);
-		if (r != 0) {
-			fprintf(stderr, "Could not initialize a basic component for Windows: (error code) %d\n", r);
-			exit(1);
-		}
-		initializedWinSock = true;
+static SOCKET wakeUpSocket = INVALID_SOCKET;
+static std::once_flag socketsOpened;
+
+//Opened once, from the loop or from the thread that waits for the commands
+static void openSockets() {
+	int r = WSAStartup(MAKEWORD(2, 2), &wsaData);
+	if (r != 0) {
+		fprintf(stderr, "Could not initialize a basic component for Windows: (error code) %d\n", r);
+		exit(1);
 	}
+	initializedWinSock = true;
 
-	if(s4 == -1) {
-		if((s4 = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1) { s4 = 0; return showError("Could not open IPv4 socket"); }
+	if((s4 = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == INVALID_SOCKET) {
+		perror("Could not open IPv4 socket");
+		s4 = -1;
+	} else {
 		sockaddr_in serv;
 		memset(&serv, 0, sizeof(serv));
 		serv.sin_family = AF_INET;
@@ -40,14 +44,24 @@ Optional<Command> retro::getCommand() {
 		serv.sin_addr.s_addr = htonl(0x7f000001); //127.0.0.1
 		int opt = 1; //Avoid "Address already in use" error
 		setsockopt(s4, SOL_SOCKET, SO_REUSEADDR, (char*)&opt, sizeof(opt));
-		if(::bind(s4, (sockaddr*)&serv, sizeof(serv)) == SOCKET_ERROR) return showError("Could not bind tcp://127.0.0.1:32145");
-		if(listen(s4, 1) == SOCKET_ERROR) return showError("Could not listen tcp://127.0.0.1:31245");
-		u_long opt2 = 1;
-		ioctlsocket(s4, FIONBIO, &opt2);
+		if(::bind(s4, (sockaddr*)&serv, sizeof(serv)) == SOCKET_ERROR) {
+			perror("Could not bind tcp://127.0.0.1:32145");
+			closesocket(s4);
+			s4 = -1;
+		} else if(listen(s4, 1) == SOCKET_ERROR) {
+			perror("Could not listen tcp://127.0.0.1:32145");
+			closesocket(s4);
+			s4 = -1;
+		} else {
+			u_long opt2 = 1;
+			ioctlsocket(s4, FIONBIO, &opt2);
+		}
 	}
 
-	if(s6 == -1) {
-		if((s6 = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP)) == -1) { s6 = 0; return showError("Could not open IPv6 socket"); }
+	if((s6 = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP)) == INVALID_SOCKET) {
+		perror("Could not open IPv6 socket");
+		s6 = -1;
+	} else {
 		sockaddr_in6 serv;
 		memset(&serv, 0, sizeof(serv));
 		serv.sin6_family = AF_INET6;
@@ -55,14 +69,40 @@ Optional<Command> retro::getCommand() {
 		serv.sin6_addr = IN6ADDR_LOOPBACK_INIT;
 		int opt = 1; //Avoid "Address already in use" error
 		setsockopt(s6, SOL_SOCKET, SO_REUSEADDR, (char*)&opt, sizeof(opt));
-		if(::bind(s6, (sockaddr*)&serv, sizeof(serv)) == SOCKET_ERROR) return showError("Could not bind tcp://[::1]:32145");
-		if(listen(s6, 1) == SOCKET_ERROR) return showError("Could not listen tcp://[::1]:31245");
-		u_long opt2 = 1;
-		ioctlsocket(s6, FIONBIO, &opt2);
+		if(::bind(s6, (sockaddr*)&serv, sizeof(serv)) == SOCKET_ERROR) {
+			perror("Could not bind tcp://[::1]:32145");
+			closesocket(s6);
+			s6 = -1;
+		} else if(listen(s6, 1) == SOCKET_ERROR) {
+			perror("Could not listen tcp://[::1]:32145");
+			closesocket(s6);
+			s6 = -1;
+		} else {
+			u_long opt2 = 1;
+			ioctlsocket(s6, FIONBIO, &opt2);
+		}
+	}
+
+	//select() only works with sockets, stopWaitingForCommands() sends a datagram to this one to wake up waitForCommand()
+	if((wakeUpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) != INVALID_SOCKET) {
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(0x7f000001); //127.0.0.1, any port
+		if(::bind(wakeUpSocket, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+			closesocket(wakeUpSocket);
+			wakeUpSocket = INVALID_SOCKET;
+		}
 	}
+	if(wakeUpSocket == INVALID_SOCKET) perror("Could not open a socket for the commands");
+}
+
+Optional<Command> retro::getCommand() {
+	std::call_once(socketsOpened, openSockets);
 
 	char buff[1500];
 	for(auto s : std::vector<SOCKET>{ s4, s6 }) {
+		if(s == -1) continue;
 		SOCKET sock = accept(s, NULL, NULL);
 		if(sock != SOCKET_ERROR) {
 			int readBytes = recv(sock, buff, 1500, 0);
@@ -88,10 +128,33 @@ Optional<Command> retro::getCommand() {
 	return {};
 }
 
+bool retro::waitForCommand() {
+	std::call_once(socketsOpened, openSockets);
+	if(wakeUpSocket == INVALID_SOCKET) return false;
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(wakeUpSocket, &fds);
+	if(s4 != -1) FD_SET(s4, &fds);
+	if(s6 != -1) FD_SET(s6, &fds);
+	if(select(0, &fds, nullptr, nullptr, nullptr) == SOCKET_ERROR) return false;
+	return !FD_ISSET(wakeUpSocket, &fds);
+}
+
+void retro::stopWaitingForCommands() {
+	std::call_once(socketsOpened, openSockets);
+	if(wakeUpSocket == INVALID_SOCKET) return;
+	//The datagram is never read, so the next calls to waitForCommand() return at once too
+	sockaddr_in addr;
+	int size = sizeof(addr);
+	getsockname(wakeUpSocket, (sockaddr*)&addr, &size);
+	sendto(wakeUpSocket, "", 1, 0, (sockaddr*)&addr, size);
+}
+
 void retro::sendCommandResponse(const Command &cmd, const nlohmann::json &resp) {
 	if(cmd._priv_data == nullptr) {
-		closesocket(s4);
-		closesocket(s6);
+		for(SOCKET s : { s4, s6, wakeUpSocket }) {
+			if(s != -1) closesocket(s);
+		}
 		WSACleanup();
 		initializedWinSock = false;
 	} else {
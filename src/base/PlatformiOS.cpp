@@ -15,6 +15,12 @@ Optional<Command> retro::getCommand() {
     return {};
 }
 
+bool retro::waitForCommand() {
+    return false;
+}
+
+void retro::stopWaitingForCommands() {}
+
 void retro::sendCommandResponse(const Command &cmd, const nlohmann::json &resp) {}
 
-#include "StdFileImpl.hpp"
+#include "PosixFileImpl.hpp"
@@ -0,0 +1,322 @@
+//
+//  PosixFileImpl.hpp
+//  retro
+//
+
+#pragma once
+
+//I suppose "Platform.hpp" is included already
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+
+//A file descriptor with a buffer in user space, shared by reads and writes. The buffer holds
+//data read ahead (from bufferPos to bufferLen) or data waiting to be written (from 0 to
+//bufferLen), never both. rawPos is the position of the descriptor.
+struct PosixFile {
+    static const size_t capacity = 64 * 1024;
+    int fd;
+    off_t rawPos = 0;
+    size_t bufferPos = 0, bufferLen = 0;
+    bool writing = false;
+    uint8_t buffer[capacity];
+
+    PosixFile(int fd): fd(fd) {}
+
+    off_t position() const {
+        return writing ? rawPos + off_t(bufferLen) : rawPos - off_t(bufferLen - bufferPos);
+    }
+
+    //Writes all the buffers, even if the kernel writes them in parts
+    bool writeAll(iovec* iov, int count) {
+        while(count > 0) {
+            ssize_t w = ::writev(fd, iov, count);
+            if(w < 0) {
+                if(errno == EINTR) continue;
+                return false;
+            }
+            size_t left = size_t(w);
+            rawPos += off_t(w);
+            while(count > 0 && left >= iov->iov_len) {
+                left -= iov->iov_len;
+                iov++;
+                count--;
+            }
+            if(count > 0) {
+                iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + left;
+                iov->iov_len -= left;
+            }
+        }
+        return true;
+    }
+
+    //Writes the data waiting in the buffer
+    bool flush() {
+        if(!writing) return true;
+        iovec iov = { buffer, bufferLen };
+        bool ok = writeAll(&iov, 1);
+        bufferLen = 0;
+        writing = false;
+        return ok;
+    }
+
+    //Prepares the buffer to be used for reading
+    bool startReading() {
+        return !writing || flush();
+    }
+
+    //Prepares the buffer to be used for writing, the data read ahead is discarded
+    bool startWriting() {
+        if(writing) return true;
+        off_t pos = position();
+        if(bufferPos != bufferLen && ::lseek(fd, pos, SEEK_SET) < 0) return false;
+        rawPos = pos;
+        bufferPos = bufferLen = 0;
+        writing = true;
+        return true;
+    }
+
+    off_t seek(off_t offset, BasicFile::SeekDirection dir) {
+        if(!flush()) return -1;
+        off_t target;
+        if(dir == BasicFile::Beginning) {
+            target = offset;
+        } else if(dir == BasicFile::Current) {
+            target = position() + offset;
+        } else {
+            struct stat st;
+            if(::fstat(fd, &st) != 0) return -1;
+            target = st.st_size + offset;
+        }
+        if(target < 0) return -1;
+
+        //Inside the data read ahead, the descriptor doesn't need to move
+        off_t bufferStart = rawPos - off_t(bufferLen);
+        if(bufferStart <= target && target <= rawPos) {
+            bufferPos = size_t(target - bufferStart);
+        } else {
+            if(::lseek(fd, target, SEEK_SET) < 0) return -1;
+            rawPos = target;
+            bufferPos = bufferLen = 0;
+        }
+        return target;
+    }
+
+    bool close() {
+        bool ok = flush();
+        ok = ::close(fd) == 0 && ok;
+        fd = -1;
+        return ok;
+    }
+};
+
+static PosixFile* openPosixFile(const string &path, int flags, bool atEnd) {
+    int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if(fd < 0) return nullptr;
+    PosixFile* file = new PosixFile(fd);
+    if(atEnd) {
+        file->rawPos = ::lseek(fd, 0, SEEK_END);
+    }
+    return file;
+}
+
+static void closePosixFile(void* &impl) {
+    PosixFile* file = static_cast<PosixFile*>(impl);
+    if(file != nullptr) {
+        if(file->fd >= 0) file->close();
+        delete file;
+    }
+    impl = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+InputFile::InputFile() { _impl = nullptr; }
+
+InputFile::InputFile(const std::string &file, bool binary) {
+    open(file, binary);
+}
+
+bool InputFile::open(const std::string &file, bool) {
+    _impl = openPosixFile(file, O_RDONLY, false);
+    fail = _impl != nullptr ? BasicFile::Nothing : BasicFile::CannotOpen;
+    return _impl != nullptr;
+}
+
+bool InputFile::close() {
+    PosixFile* file = get_impl_ptr<PosixFile>();
+    return file != nullptr && file->fd >= 0 && file->close();
+}
+
+size_t InputFile::read(void* buff, size_t n, size_t sizeOfCType) {
+    PosixFile* file = get_impl_ptr<PosixFile>();
+    if(file == nullptr || file->fd < 0 || !file->startReading()) {
+        fail = BasicFile::CannotRead;
+        return 0;
+    }
+
+    uint8_t* out = static_cast<uint8_t*>(buff);
+    size_t wanted = n * sizeOfCType;
+    size_t done = std::min(wanted, file->bufferLen - file->bufferPos);
+    memcpy(out, file->buffer + file->bufferPos, done);
+    file->bufferPos += done;
+
+    while(done < wanted) {
+        //What is left goes directly into the caller's memory, and the buffer gets what follows
+        iovec iov[2] = { { out + done, wanted - done }, { file->buffer, PosixFile::capacity } };
+        ssize_t r = ::readv(file->fd, iov, 2);
+        if(r < 0) {
+            if(errno == EINTR) continue;
+            fail = BasicFile::CannotRead;
+            return 0;
+        } else if(r == 0) {
+            fail = BasicFile::EndOfFile;
+            break;
+        }
+
+        file->rawPos += off_t(r);
+        size_t toCaller = std::min(size_t(r), wanted - done);
+        done += toCaller;
+        file->bufferPos = 0;
+        file->bufferLen = size_t(r) - toCaller;
+    }
+
+    return done / sizeOfCType;
+}
+
+Span<const uint8_t> InputFile::readAll() {
+    PosixFile* file = get_impl_ptr<PosixFile>();
+    if(file == nullptr || file->fd < 0 || !file->startReading()) {
+        fail = BasicFile::CannotRead;
+        return {};
+    }
+
+    struct stat st;
+    if(::fstat(file->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        //The size is known, so it's read at once
+        off_t pos = file->position();
+        contents.resize(st.st_size > pos ? size_t(st.st_size - pos) : 0);
+        contents.resize(read(contents.data(), contents.size(), 1));
+    } else {
+        contents.clear();
+        size_t got;
+        do {
+            contents.resize(contents.size() + PosixFile::capacity);
+            got = read(contents.data() + contents.size() - PosixFile::capacity, PosixFile::capacity, 1);
+            contents.resize(contents.size() - PosixFile::capacity + got);
+        } while(got != 0);
+    }
+    return { contents.data(), contents.size() };
+}
+
+off_t InputFile::seeki(off_t offset, BasicFile::SeekDirection dir) {
+    PosixFile* file = get_impl_ptr<PosixFile>();
+    off_t pos = file != nullptr && file->fd >= 0 ? file->seek(offset, dir) : -1;
+    if(pos == -1) fail = BasicFile::CannotSeek;
+    return pos;
+}
+
+off_t InputFile::telli() {
+    PosixFile* file = get_impl_ptr<PosixFile>();
+    if(file == nullptr || file->fd < 0) {
+        fail = BasicFile::CannotSeek;
+        return -1;
+    }
+    return file->position();
+}
+
+InputFile::~InputFile() {
+    closePosixFile(_impl);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+OutputFile::OutputFile() { _impl = nullptr; }
+
+OutputFile::OutputFile(const string &file, bool, bool append) {
+    _impl = openPosixFile(file, O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC), append);
+    fail = _impl != nullptr ? BasicFile::Nothing : BasicFile::CannotOpen;
+}
+
+bool OutputFile::open(const string &file, bool) {
+    _impl = openPosixFile(file, O_WRONLY | O_CREAT | O_TRUNC, false);
+    fail = _impl != nullptr ? BasicFile::Nothing : BasicFile::CannotOpen;
+    return _impl != nullptr;
+}
+
+bool OutputFile::close() {
+    PosixFile* file = get_impl_ptr<PosixFile>();
+    return file != nullptr && file->fd >= 0 && file->close();
+}
+
+size_t OutputFile::write(const void* buff, size_t n, size_t sizeOfCType) {
+    PosixFile* file = get_impl_ptr<PosixFile>();
+    if(file == nullptr || file->fd < 0 || !file->startWriting()) {
+        fail = BasicFile::CannotWrite;
+        return 0;
+    }
+
+    size_t size = n * sizeOfCType;
+    if(file->bufferLen + size <= PosixFile::capacity) {
+        memcpy(file->buffer + file->bufferLen, buff, size);
+        file->bufferLen += size;
+        return n;
+    }
+
+    //Doesn't fit, so the data in the buffer and this are written together
+    iovec iov[2] = { { file->buffer, file->bufferLen }, { const_cast<void*>(buff), size } };
+    bool ok = file->writeAll(iov, 2);
+    file->bufferLen = 0;
+    if(!ok) {
+        fail = BasicFile::CannotWrite;
+        return 0;
+    }
+    return n;
+}
+
+off_t OutputFile::seeko(off_t offset, BasicFile::SeekDirection dir) {
+    PosixFile* file = get_impl_ptr<PosixFile>();
+    off_t pos = file != nullptr && file->fd >= 0 ? file->seek(offset, dir) : -1;
+    if(pos == -1) fail = BasicFile::CannotSeek;
+    return pos;
+}
+
+off_t OutputFile::tello() {
+    PosixFile* file = get_impl_ptr<PosixFile>();
+    if(file == nullptr || file->fd < 0) {
+        fail = BasicFile::CannotSeek;
+        return -1;
+    }
+    return file->position();
+}
+
+OutputFile::~OutputFile() {
+    closePosixFile(_impl);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+InputOutputFile::InputOutputFile(const string &file, bool, bool append) {
+    _impl = openPosixFile(file, O_RDWR, append);
+    fail = _impl != nullptr ? BasicFile::Nothing : BasicFile::CannotOpen;
+}
+
+bool InputOutputFile::open(const string &file, bool) {
+    _impl = openPosixFile(file, O_RDWR | O_CREAT | O_TRUNC, false);
+    fail = _impl != nullptr ? BasicFile::Nothing : BasicFile::CannotOpen;
+    return _impl != nullptr;
+}
+
+bool InputOutputFile::close() {
+    PosixFile* file = get_impl_ptr<PosixFile>();
+    return file != nullptr && file->fd >= 0 && file->close();
+}
+
+InputOutputFile::~InputOutputFile() {
+    closePosixFile(_impl);
+}
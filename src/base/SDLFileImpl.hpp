@@ -59,6 +59,21 @@ size_t InputFile::read(void* buff, size_t n, size_t sizeOfCType) {
     }
 }
 
+Span<const uint8_t> InputFile::readAll() {
+    SDL_RWops* ops = get_impl_ptr<SDL_RWops>();
+    //The size is known, so it's read at once
+    Sint64 start = SDL_RWtell(ops);
+    Sint64 end = SDL_RWsize(ops);
+    if(start < 0 || end < 0) {
+        fail = BasicFile::CannotRead;
+        return {};
+    }
+
+    contents.resize(end > start ? size_t(end - start) : 0);
+    contents.resize(SDL_RWread(ops, contents.data(), 1, contents.size()));
+    return { contents.data(), contents.size() };
+}
+
 off_t InputFile::seeki(off_t offset, BasicFile::SeekDirection dir) {
     SDL_RWops* ops = get_impl_ptr<SDL_RWops>();
     int whence;
@@ -2,7 +2,9 @@
 #include <Palette.hpp>
 #include <Game.hpp>
 #include <Platform.hpp>
+#include <TileFile.hpp>
 #include <memory>
+#include <vector>
 #include <cmath>
 
 #if !defined(_WIN32) and !defined(__ANDROID__) and !defined(__IOS__)
@@ -10,11 +12,42 @@
 #else
 #include <SDL.h>
 #endif
+#include "TextureUpdate.hpp"
 
 using namespace retro;
 using namespace glm;
 using namespace std;
 
+//Versions 2 and 3 have a header (see TileFile), legacy files have the pixels of all sprites followed by the number of sprites
+static void readSpritesFile(InputFile &i, const string &path, uint64_t &sprites, uint8_t* &data) {
+    auto file = i.readAll();
+    TileFile header;
+    try {
+        if(TileFile::parse(file, "RSPR", header)) {
+            if(header.size.x != 64) throw runtime_error("The sprites are not 8x8");
+            data = reinterpret_cast<uint8_t*>(realloc(data, header.cells()));
+            header.decode(data);
+            sprites = header.size.y;
+            return;
+        }
+    } catch(const runtime_error &e) {
+        throw runtime_error("Invalid sprite file '" + path + "': " + e.what());
+    }
+
+    uint64_t count;
+    if(file.size() < sizeof(count)) throw runtime_error("Invalid sprite file '" + path + "'");
+    memcpy(&count, file.end() - sizeof(count), sizeof(count));
+    if(count > (file.size() - sizeof(count)) / 64) throw runtime_error("Invalid sprite file '" + path + "'");
+
+    data = reinterpret_cast<uint8_t*>(realloc(data, count * 64));
+    memcpy(data, file.data(), count * 64);
+    sprites = count;
+}
+
+static void writeSpritesFile(OutputFile &o, uint64_t sprites, const uint8_t* data) {
+    TileFile::write(o, "RSPR", { 64, uint32_t(sprites) }, data);
+}
+
 Sprites::Sprites(Game &game): game(game), references(*new atomic_size_t(0)) {
     surface = nullptr;
     texture = nullptr;
@@ -31,16 +64,12 @@ Sprites::Sprites(const string &path, Game &game): game(game), path(path), refere
             this->sprites = 64;
             this->data = reinterpret_cast<uint8_t*>(malloc(this->sprites * 64));
             memset(this->data, 0, this->sprites * 64);
-            i.write(reinterpret_cast<char*>(this->data), this->sprites * 64);
-            i.write(reinterpret_cast<const char*>(&this->sprites), sizeof(uint64_t));
+            writeSpritesFile(i, this->sprites, this->data);
         }
         i.close();
     } else {
-        i.seeki(-sizeof(uint64_t), BasicFile::End);
-        i.read((char*) &this->sprites, sizeof(uint64_t));
-        i.seeki(0, BasicFile::Beginning);
-        this->data = reinterpret_cast<uint8_t*>(malloc(this->sprites * 64));
-        i.read(reinterpret_cast<char*>(this->data), this->sprites * 64);
+        this->data = nullptr;
+        readSpritesFile(i, path, this->sprites, this->data);
         i.close();
     }
 
@@ -97,44 +126,71 @@ void Sprites::save() const {
         throw runtime_error("Cannot write sprite file '" + this->path + "'");
     }
 
-    o.write(reinterpret_cast<char*>(this->data), this->sprites * 64);
-    o.write(reinterpret_cast<const char*>(&this->sprites), sizeof(uint64_t));
+    writeSpritesFile(o, this->sprites, this->data);
     o.close();
 }
 
 void Sprites::reload() {
     InputFile i = game.openReadFile(path);
-    i.seeki(-sizeof(uint64_t), BasicFile::End);
-    i.read((char*) &this->sprites, sizeof(uint64_t));
-    i.seeki(0, BasicFile::Beginning);
-    this->data = reinterpret_cast<uint8_t*>(realloc(this->data, this->sprites * 64));
-    i.read(reinterpret_cast<char*>(this->data), this->sprites * 64);
+    readSpritesFile(i, path, this->sprites, this->data);
     i.close();
 }
 
 void Sprites::regenerateTextures() {
-    if(texture != nullptr) SDL_DestroyTexture(texture);
-    if(surface != nullptr) SDL_FreeSurface(surface);
+    regeneratePixels();
+    uploadTextures();
+}
+
+void Sprites::regenerateTextures(const Frame &region) {
+    const size_t w = (8 * 16);
+    const size_t h = (8 * int(sprites / 16));
+    if(texture == nullptr || pixels == nullptr) {
+        regenerateTextures();
+        return;
+    }
+
+    const uvec2 start = glm::min(uvec2(glm::max(region.pos, vec2(0))), uvec2(w, h));
+    const uvec2 end = glm::min(uvec2(glm::max(region.pos + region.size, vec2(0))), uvec2(w, h));
+    if(start.x >= end.x || start.y >= end.y) return;
+    for(size_t y = start.y; y < end.y; y++) {
+        game.getPalette().toPixels(this->data + y * w + start.x, this->pixels + y * w + start.x, end.x - start.x);
+    }
+    const SDL_Rect rekt = { int(start.x), int(start.y), int(end.x - start.x), int(end.y - start.y) };
+    update_texture_rekt(texture, pixels, w, rekt);
+}
+
+void Sprites::regeneratePixels() {
+    regeneratePixels(game.getPalette().data());
+}
+
+void Sprites::regeneratePixels(const uint32_t* colors) {
     size_t w = (8 * 16);
     size_t h = (8 * int(sprites / 16));
     pixels = (uint32_t*) realloc(pixels, w * h * sizeof(uint32_t));
 
-    for(size_t y = 0; y < h; y++) {
-        for(size_t x = 0; x < w; x++) {
-            uint8_t col = this->data[y * w + x];
-            auto rgba = game.getPalette()[size_t(col)].value();
-            uint32_t mix = rgba.a << 24 | rgba.b << 16 | rgba.g << 8 | rgba.r;
-            this->pixels[y * w + x] = mix;
-        }
-    }
+    Palette::toPixels(colors, this->data, this->pixels, w * h);
+}
 
+void Sprites::uploadTextures() {
+    if(texture != nullptr) SDL_DestroyTexture(texture);
+    if(surface != nullptr) SDL_FreeSurface(surface);
+    size_t w = (8 * 16);
+    size_t h = (8 * int(sprites / 16));
     surface = SDL_CreateRGBSurfaceFrom(this->pixels, w, h, 32, sizeof(uint32_t)*w, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
     texture = SDL_CreateTextureFromSurface(game.renderer, surface);
 }
 
 size_t Sprites::size() const { return this->sprites; };
 
-void Sprites::load(const std::string &path) throw() {
+TileRegion Sprites::region(const Frame &pixels) const {
+    const TileRegion all = { this->data, 8 * 16, { 8 * 16, 8 * (sprites / 16) } };
+    //Both ends are clipped, the part of the frame before the pixels is not part of the region
+    const vec2 start = glm::max(pixels.pos, vec2(0));
+    const vec2 end = glm::max(pixels.pos + pixels.size, start);
+    return all.sub(uvec2(start), uvec2(end - start));
+}
+
+void Sprites::load(const std::string &path) {
     if(references != 0) throw runtime_error("Cannot load another Sprites file when this instance has already loaded one");
     InputFile i = game.openReadFile(path);
     if(!i.ok()) {
@@ -145,16 +201,12 @@ void Sprites::load(const std::string &path) throw() {
             this->sprites = 64;
             this->data = reinterpret_cast<uint8_t*>(malloc(this->sprites * 64));
             memset(this->data, 0, this->sprites * 64);
-            i.write(reinterpret_cast<char*>(this->data), this->sprites * 64);
-            i.write(reinterpret_cast<const char*>(&this->sprites), sizeof(uint64_t));
+            writeSpritesFile(i, this->sprites, this->data);
         }
         i.close();
     } else {
-        i.seeki(-sizeof(uint64_t), BasicFile::End);
-        i.read(&this->sprites);
-        i.seeki(0, BasicFile::Beginning);
-        this->data = reinterpret_cast<uint8_t*>(malloc(this->sprites * 64));
-        i.read(reinterpret_cast<char*>(this->data), this->sprites * 64);
+        this->data = nullptr;
+        readSpritesFile(i, path, this->sprites, this->data);
         i.close();
     }
 }
@@ -247,6 +299,10 @@ void Sprite::draw_thicc(const retro::Frame &frame) const {
     SDL_RenderCopy(origin.renderer(), origin.texture, &src, &dst);
 }
 
+TileRegion Sprite::region() const {
+    return origin.region(frame());
+}
+
 Frame Sprite::frame() const {
     size_t ix = (index % 16) + width / 8 - 1, iy = index + height * 2 - 16;
     //This number is the maximum sprite for the Y axis
@@ -57,6 +57,24 @@ size_t InputFile::read(void* buff, size_t n, size_t sizeOfCType) {
     }
 }
 
+Span<const uint8_t> InputFile::readAll() {
+    ifstream& stream = get_impl<ifstream>();
+    //The size is known, so it's read at once
+    stream.clear();
+    auto start = stream.tellg();
+    stream.seekg(0, ifstream::end);
+    auto end = stream.tellg();
+    stream.seekg(start);
+    if(start == ifstream::pos_type(-1) || end == ifstream::pos_type(-1) || !stream) {
+        fail = BasicFile::CannotRead;
+        return {};
+    }
+
+    contents.resize(size_t(end - start));
+    contents.resize(read(contents.data(), contents.size(), 1));
+    return { contents.data(), contents.size() };
+}
+
 off_t InputFile::seeki(off_t offset, BasicFile::SeekDirection dir) {
     ifstream& stream = get_impl<ifstream>();
     ifstream::seekdir stddir;
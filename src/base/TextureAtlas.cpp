@@ -0,0 +1,202 @@
+#include <TextureAtlas.hpp>
+#include <stdexcept>
+#include <string>
+
+#if !defined(_WIN32) and !defined(__ANDROID__) and !defined(__IOS__)
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+using namespace retro;
+using namespace glm;
+using namespace std;
+
+//Space left between regions, to avoid sampling pixels from the neighbours
+static const uint32_t padding = 1;
+
+TextureAtlas::TextureAtlas(SDL_Renderer* renderer, const uvec2 &pageSize): renderer(renderer), pageSize(pageSize) {}
+
+TextureAtlas::~TextureAtlas() {
+    clear();
+}
+
+TextureAtlas::Page& TextureAtlas::newPage() {
+    //Same layout as the surfaces created in Image, Map and Sprites (RGBA in memory)
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STATIC, pageSize.x, pageSize.y);
+    if(texture == nullptr) {
+        throw runtime_error(string("Could not create a texture for the atlas: ") + SDL_GetError());
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    //Clear the page, static textures have undefined contents when created
+    vector<uint32_t> transparent(pageSize.x * pageSize.y, 0);
+    SDL_UpdateTexture(texture, nullptr, transparent.data(), pageSize.x * sizeof(uint32_t));
+
+    pages.push_back({ texture, { { 0, 0, pageSize.x } }, {}, 0 });
+    return pages.back();
+}
+
+bool TextureAtlas::fits(const Page &page, size_t index, const uvec2 &size, uint32_t &y) const {
+    uint32_t x = page.skyline[index].x;
+    if(x + size.x > pageSize.x) return false;
+
+    int64_t widthLeft = size.x;
+    y = page.skyline[index].y;
+    while(widthLeft > 0) {
+        y = std::max(y, page.skyline[index].y);
+        if(y + size.y > pageSize.y) return false;
+        widthLeft -= page.skyline[index].width;
+        index++;
+        if(index >= page.skyline.size() && widthLeft > 0) return false;
+    }
+    return true;
+}
+
+bool TextureAtlas::findPosition(const Page &page, const uvec2 &size, uvec2 &pos, size_t &index) const {
+    uint32_t bestBottom = UINT32_MAX, bestWidth = UINT32_MAX;
+    bool found = false;
+    for(size_t i = 0; i < page.skyline.size(); i++) {
+        uint32_t y;
+        if(fits(page, i, size, y)) {
+            if(y + size.y < bestBottom || (y + size.y == bestBottom && page.skyline[i].width < bestWidth)) {
+                bestBottom = y + size.y;
+                bestWidth = page.skyline[i].width;
+                pos = { page.skyline[i].x, y };
+                index = i;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+void TextureAtlas::addSkylineLevel(Page &page, size_t index, const uvec2 &pos, const uvec2 &size) {
+    auto &skyline = page.skyline;
+    skyline.insert(skyline.begin() + index, { pos.x, pos.y + size.y, size.x });
+
+    //Shrink or remove the nodes that are now below the new one
+    for(size_t i = index + 1; i < skyline.size(); i++) {
+        const Node &prev = skyline[i - 1];
+        if(skyline[i].x < prev.x + prev.width) {
+            uint32_t shrink = prev.x + prev.width - skyline[i].x;
+            if(skyline[i].width <= shrink) {
+                skyline.erase(skyline.begin() + i);
+                i--;
+            } else {
+                skyline[i].x += shrink;
+                skyline[i].width -= shrink;
+                break;
+            }
+        } else {
+            break;
+        }
+    }
+
+    //Merge nodes at the same height
+    for(size_t i = 0; i + 1 < skyline.size(); i++) {
+        if(skyline[i].y == skyline[i + 1].y) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+            i--;
+        }
+    }
+}
+
+bool TextureAtlas::takeFreeRect(Page &page, const uvec2 &size, uvec2 &pos) {
+    //Best fit: the smallest free rectangle where the region fits
+    size_t best = page.freeRects.size();
+    uint64_t bestArea = UINT64_MAX;
+    for(size_t i = 0; i < page.freeRects.size(); i++) {
+        const Rect &r = page.freeRects[i];
+        const uint64_t area = uint64_t(r.size.x) * r.size.y;
+        if(r.size.x >= size.x && r.size.y >= size.y && area < bestArea) {
+            best = i;
+            bestArea = area;
+        }
+    }
+    if(best == page.freeRects.size()) return false;
+
+    const Rect r = page.freeRects[best];
+    page.freeRects.erase(page.freeRects.begin() + best);
+    pos = r.pos;
+    //Split what is left in the part at the right of the region and the part below it
+    if(r.size.x > size.x) page.freeRects.push_back({ { r.pos.x + size.x, r.pos.y }, { r.size.x - size.x, size.y } });
+    if(r.size.y > size.y) page.freeRects.push_back({ { r.pos.x, r.pos.y + size.y }, { r.size.x, r.size.y - size.y } });
+    return true;
+}
+
+Optional<TextureAtlas::Region> TextureAtlas::insert(SDL_Surface* surface) {
+    const uvec2 size = { uint32_t(surface->w), uint32_t(surface->h) };
+    const uvec2 paddedSize = size + padding;
+    if(paddedSize.x > pageSize.x || paddedSize.y > pageSize.y) return {};
+
+    uvec2 pos;
+    size_t index = 0;
+    Page* page = nullptr;
+    for(auto &p: pages) {
+        if(takeFreeRect(p, paddedSize, pos)) {
+            page = &p;
+            break;
+        }
+    }
+
+    if(page == nullptr) {
+        for(auto &p: pages) {
+            if(findPosition(p, paddedSize, pos, index)) {
+                page = &p;
+                break;
+            }
+        }
+
+        if(page == nullptr) {
+            page = &newPage();
+            findPosition(*page, paddedSize, pos, index);
+        }
+
+        addSkylineLevel(*page, index, pos, paddedSize);
+    }
+
+    page->regions++;
+    Region region { page->texture, pos, size };
+    update(region, surface);
+    return region;
+}
+
+void TextureAtlas::update(const Region &region, SDL_Surface* surface) {
+    if(uint32_t(surface->w) != region.size.x || uint32_t(surface->h) != region.size.y) {
+        throw runtime_error("The surface must have the same size as the atlas region");
+    }
+
+    SDL_Rect rekt = { int(region.pos.x), int(region.pos.y), int(region.size.x), int(region.size.y) };
+    if(surface->format->format == SDL_PIXELFORMAT_ABGR8888) {
+        SDL_UpdateTexture(region.texture, &rekt, surface->pixels, surface->pitch);
+    } else {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ABGR8888, 0);
+        if(converted == nullptr) {
+            throw runtime_error(string("Could not convert the surface for the atlas: ") + SDL_GetError());
+        }
+        SDL_UpdateTexture(region.texture, &rekt, converted->pixels, converted->pitch);
+        SDL_FreeSurface(converted);
+    }
+}
+
+void TextureAtlas::release(const Region &region) {
+    for(auto &page: pages) {
+        if(page.texture != region.texture) continue;
+
+        if(--page.regions == 0) {
+            //The page is empty, start again (the pixels left are never drawn)
+            page.skyline = { { 0, 0, pageSize.x } };
+            page.freeRects.clear();
+        } else {
+            page.freeRects.push_back({ region.pos, region.size + padding });
+        }
+        return;
+    }
+}
+
+void TextureAtlas::clear() {
+    for(auto &page: pages) SDL_DestroyTexture(page.texture);
+    pages.clear();
+}
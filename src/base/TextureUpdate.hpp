@@ -0,0 +1,27 @@
+//
+//  TextureUpdate.hpp
+//  retro
+//
+
+#pragma once
+
+//I suppose SDL is included already
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+//The textures are created from surfaces with the pixels in RGBA, but the renderer could have chosen another format
+static inline void update_texture_rekt(SDL_Texture* texture, const uint32_t* pixels, size_t width, const SDL_Rect &rekt) {
+    const uint32_t* start = pixels + size_t(rekt.y) * width + size_t(rekt.x);
+    const int pitch = int(width * sizeof(uint32_t));
+    uint32_t format;
+    SDL_QueryTexture(texture, &format, nullptr, nullptr, nullptr);
+    if(format == SDL_PIXELFORMAT_ABGR8888) {
+        SDL_UpdateTexture(texture, &rekt, start, pitch);
+    } else {
+        std::vector<uint32_t> converted(size_t(rekt.w) * size_t(rekt.h));
+        const int convertedPitch = int(rekt.w * sizeof(uint32_t));
+        SDL_ConvertPixels(rekt.w, rekt.h, SDL_PIXELFORMAT_ABGR8888, start, pitch, format, converted.data(), convertedPitch);
+        SDL_UpdateTexture(texture, &rekt, converted.data(), convertedPitch);
+    }
+}
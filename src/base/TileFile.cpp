@@ -0,0 +1,144 @@
+#include <TileFile.hpp>
+#include <cstring>
+#include <stdexcept>
+
+using namespace retro;
+using namespace glm;
+using namespace std;
+
+//Magic, version, flags, width, height, payload size, checksum and extra size
+static constexpr size_t headerSize = 4 + 2 + 2 + 4 + 4 + 4 + 4 + 4;
+
+template<typename T>
+static inline T readValue(const uint8_t* &p) {
+    T value;
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+}
+
+bool TileFile::parse(Span<const uint8_t> file, const char magic[4], TileFile &out) {
+    if(file.size() < headerSize || memcmp(file.data(), magic, 4) != 0) return false;
+
+    const uint8_t* p = file.data() + 4;
+    const uint16_t fileVersion = readValue<uint16_t>(p);
+    if(fileVersion < 2 || fileVersion > version) throw runtime_error("Unsupported version " + to_string(fileVersion) + " of the file");
+    out.flags = readValue<uint16_t>(p);
+    //A flag that is not known could change how the payload must be read. Version 2 only had the compression
+    const uint16_t knownFlags = fileVersion == 2 ? uint16_t(RunLength) : uint16_t(RunLength | WideCells | Layers);
+    if(out.flags & ~knownFlags) throw runtime_error("Unknown flags " + to_string(out.flags) + " in the file");
+    out.size.x = readValue<uint32_t>(p);
+    out.size.y = readValue<uint32_t>(p);
+    const uint32_t payloadSize = readValue<uint32_t>(p);
+    out.checksum = readValue<uint32_t>(p);
+    const uint32_t extraSize = readValue<uint32_t>(p);
+
+    const size_t left = file.size() - headerSize;
+    if(size_t(extraSize) > left || size_t(payloadSize) > left - extraSize) throw runtime_error("The file is truncated");
+    out.extra.assign(reinterpret_cast<const char*>(p), extraSize);
+    out.payload = file.subspan(headerSize + extraSize, payloadSize);
+    return true;
+}
+
+void TileFile::decode(uint8_t* out) const {
+    const size_t total = cells();
+    if(flags & RunLength) {
+        const uint8_t* p = payload.data();
+        const uint8_t* end = payload.end();
+        size_t pos = 0;
+        while(p < end) {
+            const uint8_t n = *p++;
+            if(n < 128) {
+                const size_t count = size_t(n) + 1;
+                if(size_t(end - p) < count || total - pos < count) throw runtime_error("The cells of the file are corrupt");
+                memcpy(out + pos, p, count);
+                p += count;
+                pos += count;
+            } else {
+                const size_t count = size_t(n) - 125;
+                if(p == end || total - pos < count) throw runtime_error("The cells of the file are corrupt");
+                memset(out + pos, *p++, count);
+                pos += count;
+            }
+        }
+        if(pos != total) throw runtime_error("The cells of the file are corrupt");
+    } else {
+        if(payload.size() != total) throw runtime_error("The cells of the file are corrupt");
+        memcpy(out, payload.data(), total);
+    }
+
+    if(adler32(out, total) != checksum) throw runtime_error("The checksum of the file doesn't match");
+}
+
+void TileFile::write(OutputFile &o, const char magic[4], const uvec2 &size, const uint8_t* cells, const string &extra, uint16_t flags) {
+    const size_t total = size_t(size.x) * size_t(size.y);
+    vector<uint8_t> compressed;
+    compressed.reserve(total / 8);
+    encodeRunLength(cells, total, compressed);
+    const bool useCompressed = compressed.size() < total;
+
+    const uint16_t fileVersion = version;
+    const uint16_t fileFlags = uint16_t(useCompressed ? flags | RunLength : flags & ~RunLength);
+    const uint32_t payloadSize = uint32_t(useCompressed ? compressed.size() : total);
+    const uint32_t sum = adler32(cells, total);
+    const uint32_t extraSize = uint32_t(extra.size());
+    o.write(magic, 4);
+    o.write(&fileVersion);
+    o.write(&fileFlags);
+    o.write(&size.x);
+    o.write(&size.y);
+    o.write(&payloadSize);
+    o.write(&sum);
+    o.write(&extraSize);
+    o.write(extra.c_str(), extra.size());
+    if(useCompressed) {
+        o.write(compressed.data(), compressed.size());
+    } else {
+        o.write(cells, total);
+    }
+}
+
+void TileFile::encodeRunLength(const uint8_t* data, size_t size, vector<uint8_t> &out) {
+    size_t pos = 0, literals = 0;
+    //Literals are accumulated until a run of 3 or more bytes is found
+    auto flush = [&] (size_t until) {
+        while(literals > 0) {
+            const size_t count = literals < 128 ? literals : 128;
+            out.push_back(uint8_t(count - 1));
+            out.insert(out.end(), data + until - literals, data + until - literals + count);
+            literals -= count;
+        }
+    };
+
+    while(pos < size) {
+        size_t run = 1;
+        while(pos + run < size && run < 130 && data[pos + run] == data[pos]) run++;
+        if(run >= 3) {
+            flush(pos);
+            out.push_back(uint8_t(run + 125));
+            out.push_back(data[pos]);
+            pos += run;
+        } else {
+            literals += run;
+            pos += run;
+        }
+    }
+    flush(pos);
+}
+
+uint32_t TileFile::adler32(const uint8_t* data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while(size > 0) {
+        //5552 is the biggest number of bytes that can be summed before the modulo without overflowing
+        const size_t block = size < 5552 ? size : 5552;
+        for(size_t i = 0; i < block; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+    return b << 16 | a;
+}
@@ -0,0 +1,125 @@
+#include <TileRegion.hpp>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace retro;
+using namespace glm;
+using namespace std;
+
+template<typename T>
+BasicTileRegion<T> BasicTileRegion<T>::sub(const uvec2 &pos, const uvec2 &size) const {
+    const uvec2 start = glm::min(pos, this->size);
+    const uvec2 end = glm::min(pos + size, this->size);
+    return { data + start.y * stride + start.x, stride, end - start };
+}
+
+template<typename T>
+void BasicTileRegion<T>::copyTo(T* out) const {
+    for(size_t y = 0; y < size.y; y++) {
+        memcpy(out + y * size.x, row(y), size.x * sizeof(T));
+    }
+}
+
+template<typename T>
+void BasicTileRegion<T>::paste(const T* from, const uvec2 &fromSize) const {
+    const uvec2 s = glm::min(size, fromSize);
+    for(size_t y = 0; y < s.y; y++) {
+        memcpy(row(y), from + y * fromSize.x, s.x * sizeof(T));
+    }
+}
+
+template<typename T>
+void BasicTileRegion<T>::fill(T value) const {
+    for(size_t y = 0; y < size.y; y++) {
+        std::fill_n(row(y), size.x, value);
+    }
+}
+
+template<typename T>
+void BasicTileRegion<T>::flipHorizontal() const {
+    for(size_t y = 0; y < size.y; y++) {
+        std::reverse(row(y), row(y) + size.x);
+    }
+}
+
+template<typename T>
+void BasicTileRegion<T>::flipVertical() const {
+    for(size_t y = 0; y < size.y / 2; y++) {
+        std::swap_ranges(row(y), row(y) + size.x, row(size.y - 1 - y));
+    }
+}
+
+template<typename T>
+bool BasicTileRegion<T>::rotate(bool clockwise) const {
+    //A square selection can stop being square when it is clipped to the bounds
+    if(size.x != size.y) return false;
+    const size_t n = size.x;
+    vector<T> copy(cells());
+    copyTo(copy.data());
+
+    //Every row of the result is a column of the original, read in blocks of 8 columns to use the cache better
+    for(size_t by = 0; by < n; by += 8) {
+        for(size_t bx = 0; bx < n; bx += 8) {
+            const size_t ey = std::min(by + 8, n), ex = std::min(bx + 8, n);
+            for(size_t y = by; y < ey; y++) {
+                T* out = row(y);
+                if(clockwise) {
+                    for(size_t x = bx; x < ex; x++) out[x] = copy[(n - 1 - x) * n + y];
+                } else {
+                    for(size_t x = bx; x < ex; x++) out[x] = copy[x * n + (n - 1 - y)];
+                }
+            }
+        }
+    }
+    return true;
+}
+
+template<typename T>
+void BasicTileRegion<T>::remap(const T* table) const {
+    for(size_t y = 0; y < size.y; y++) {
+        T* r = row(y);
+        //Four independent loads per iteration, like in Palette::toPixels()
+        size_t x = 0;
+        for(; x + 4 <= size.x; x += 4) {
+            T c0 = table[r[x]], c1 = table[r[x + 1]];
+            T c2 = table[r[x + 2]], c3 = table[r[x + 3]];
+            r[x] = c0;
+            r[x + 1] = c1;
+            r[x + 2] = c2;
+            r[x + 3] = c3;
+        }
+        for(; x < size.x; x++) r[x] = table[r[x]];
+    }
+}
+
+template<typename T>
+void BasicTileRegion<T>::shift(const ivec2 &offset, T value) const {
+    const int64_t w = size.x, h = size.y;
+    if(std::abs(int64_t(offset.x)) >= w || std::abs(int64_t(offset.y)) >= h) {
+        fill(value);
+        return;
+    }
+
+    const size_t moved = size_t(w - std::abs(int64_t(offset.x)));
+    const size_t from = offset.x < 0 ? size_t(-offset.x) : 0;
+    const size_t to = offset.x > 0 ? size_t(offset.x) : 0;
+    const size_t empty = size.x - moved;
+    //The rows are moved in the order that doesn't overwrite the rows not moved yet
+    for(int64_t i = 0; i < h; i++) {
+        const int64_t y = offset.y > 0 ? h - 1 - i : i;
+        const int64_t source = y - offset.y;
+        T* out = row(size_t(y));
+        if(source < 0 || source >= h) {
+            std::fill_n(out, size.x, value);
+        } else {
+            memmove(out + to, row(size_t(source)) + from, moved * sizeof(T));
+            std::fill_n(offset.x > 0 ? out : out + moved, empty, value);
+        }
+    }
+}
+
+namespace retro {
+    template struct BasicTileRegion<uint8_t>;
+    template struct BasicTileRegion<uint16_t>;
+}
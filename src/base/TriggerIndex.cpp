@@ -0,0 +1,145 @@
+#include <TriggerIndex.hpp>
+#include <CollisionDetection.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+using namespace retro;
+using namespace glm;
+using namespace std;
+
+template<typename Func>
+void TriggerIndex::forEachCell(const Frame &frame, Func &&func) {
+    const int32_t x0 = int32_t(floor(frame.pos.x / cellSize));
+    const int32_t y0 = int32_t(floor(frame.pos.y / cellSize));
+    const int32_t x1 = int32_t(floor((frame.pos.x + frame.size.x) / cellSize));
+    const int32_t y1 = int32_t(floor((frame.pos.y + frame.size.y) / cellSize));
+    for(int32_t y = y0; y <= y1; y++) {
+        for(int32_t x = x0; x <= x1; x++) {
+            func(key(x, y));
+        }
+    }
+}
+
+void TriggerIndex::insert(uint32_t slot) {
+    forEachCell(entries[slot].frame, [this, slot] (uint64_t k) {
+        cells[k].push_back(slot);
+    });
+}
+
+void TriggerIndex::erase(uint32_t slot) {
+    forEachCell(entries[slot].frame, [this, slot] (uint64_t k) {
+        auto it = cells.find(k);
+        if(it != cells.end()) {
+            auto &v = it->second;
+            v.erase(std::remove(v.begin(), v.end(), slot), v.end());
+            if(v.empty()) cells.erase(it);
+        }
+    });
+}
+
+void TriggerIndex::add(CollisionDetection* trigger) {
+    uint32_t slot;
+    if(!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = uint32_t(entries.size());
+        entries.emplace_back();
+    }
+
+    Entry &e = entries[slot];
+    e = Entry();
+    e.trigger = trigger;
+    e.object = trigger->object;
+    e.frame = trigger->frame;
+    trigger->slot = slot;
+    insert(slot);
+
+    auto it = find_if(watched.begin(), watched.end(), [&e] (auto &w) { return w.first == e.object; });
+    if(it != watched.end()) it->second++;
+    else watched.push_back({ e.object, 1 });
+}
+
+void TriggerIndex::remove(CollisionDetection* trigger) {
+    const uint32_t slot = trigger->slot;
+    if(slot >= entries.size() || entries[slot].trigger != trigger) return;
+    erase(slot);
+
+    auto it = find_if(watched.begin(), watched.end(), [this, slot] (auto &w) { return w.first == entries[slot].object; });
+    if(it != watched.end() && --it->second == 0) watched.erase(it);
+
+    auto c = lower_bound(colliding.begin(), colliding.end(), slot);
+    if(c != colliding.end() && *c == slot) colliding.erase(c);
+
+    entries[slot] = Entry();
+    //The events still to send refer to the slot, a new trigger must not receive them
+    if(dispatching) releasedSlots.push_back(slot);
+    else freeSlots.push_back(slot);
+}
+
+void TriggerIndex::moved(CollisionDetection* trigger) {
+    const uint32_t slot = trigger->slot;
+    if(slot >= entries.size() || entries[slot].trigger != trigger) return;
+    erase(slot);
+    entries[slot].frame = trigger->frame;
+    insert(slot);
+}
+
+void TriggerIndex::update() {
+    pass++;
+    current.clear();
+
+    //Disabled triggers keep their state until they are enabled again
+    for(uint32_t slot: colliding) {
+        if(entries[slot].trigger->isDisabled()) current.push_back(slot);
+    }
+
+    for(auto &w: watched) {
+        MovableObject* object = w.first;
+        const Frame frame = object->getFrame();
+        forEachCell(frame, [this, object, &frame] (uint64_t k) {
+            auto it = cells.find(k);
+            if(it == cells.end()) return;
+            for(uint32_t slot: it->second) {
+                Entry &e = entries[slot];
+                //A trigger can be in more than one cell
+                if(e.object != object || e.checked == pass || e.trigger->isDisabled()) continue;
+                e.checked = pass;
+                CollisionFace face;
+                Frame collision;
+                std::tie(face, collision) = frame.collision(e.frame);
+                if(face != NONE) {
+                    e.face = face;
+                    e.collision = collision;
+                    current.push_back(slot);
+                }
+            }
+        });
+    }
+
+    sort(current.begin(), current.end());
+    entered.clear();
+    exited.clear();
+    set_difference(current.begin(), current.end(), colliding.begin(), colliding.end(), back_inserter(entered));
+    set_difference(colliding.begin(), colliding.end(), current.begin(), current.end(), back_inserter(exited));
+    colliding.swap(current);
+
+    //The callbacks can add or remove triggers, so the entries are looked up every time
+    dispatching = true;
+    for(uint32_t slot: entered) {
+        if(slot < entries.size() && entries[slot].trigger != nullptr) {
+            Entry e = entries[slot];
+            e.trigger->collisionStarted(e.face, e.collision);
+        }
+    }
+    for(uint32_t slot: exited) {
+        if(slot < entries.size() && entries[slot].trigger != nullptr) {
+            Entry e = entries[slot];
+            e.trigger->collisionEnded(e.face, e.collision);
+        }
+    }
+    dispatching = false;
+    freeSlots.insert(freeSlots.end(), releasedSlots.begin(), releasedSlots.end());
+    releasedSlots.clear();
+}
@@ -0,0 +1,156 @@
+#include <UILayer.hpp>
+#include <UIObject.hpp>
+#include <Level.hpp>
+#include <cmath>
+
+#if !defined(_WIN32) and !defined(__ANDROID__) and !defined(__IOS__)
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+using namespace retro;
+using namespace glm;
+using namespace std;
+
+//The textures of the layer are drawn over transparent black, so their colours are already
+//multiplied by their alpha, and must be blended that way or translucent areas get darker
+static void setPremultipliedBlendMode(SDL_Texture* texture) {
+#if SDL_VERSION_ATLEAST(2, 0, 6)
+    SDL_BlendMode mode = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+                                                    SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+    if(SDL_SetTextureBlendMode(texture, mode) == 0) return;
+#endif
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+}
+
+static inline SDL_Rect toRect(const Frame &f) {
+    return { int(f.pos.x), int(f.pos.y), int(f.size.x), int(f.size.y) };
+}
+
+UILayer::~UILayer() {
+    if(texture != nullptr) SDL_DestroyTexture(texture);
+}
+
+bool UILayer::render(UIObject &object, Level &uiLevel, float scale) {
+    //The text can make the frame bigger while drawing, then it is drawn again with the new size
+    for(int attempt = 0; attempt < 2; attempt++) {
+        const ivec2 needed = glm::max(ivec2(ceil(object.frame.size.x * scale), ceil(object.frame.size.y * scale)), ivec2(1));
+        if(object.layer == nullptr || object.layerSize != needed) {
+            if(object.layer != nullptr) SDL_DestroyTexture(object.layer);
+            object.layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, needed.x, needed.y);
+            if(object.layer == nullptr) return false;
+            setPremultipliedBlendMode(object.layer);
+            object.layerSize = needed;
+        }
+
+        SDL_SetRenderTarget(renderer, object.layer);
+        SDL_RenderSetScale(renderer, scale, scale);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
+        uiLevel.cameraPos = { 0, 0 };
+        object.draw(uiLevel.ga);
+
+        if(ceil(object.frame.size.x * scale) <= object.layerSize.x && ceil(object.frame.size.y * scale) <= object.layerSize.y) break;
+    }
+
+    object.markDrawn();
+    return true;
+}
+
+void UILayer::invalidate(const Frame &area) {
+    if(area.size.x > 0 && area.size.y > 0) dirty.push_back(area);
+}
+
+void UILayer::compose() {
+    if(dirty.empty()) return;
+
+    //Many areas are joined into one, so objects below them are not copied many times
+    if(dirty.size() > 8) {
+        vec2 start = dirty[0].pos, end = dirty[0].pos + dirty[0].size;
+        for(auto &d: dirty) {
+            start = glm::min(start, d.pos);
+            end = glm::max(end, d.pos + d.size);
+        }
+        dirty.assign(1, Frame{ start, end - start });
+    }
+
+    SDL_SetRenderTarget(renderer, texture);
+    SDL_RenderSetScale(renderer, 1.0f, 1.0f);
+    for(auto &area: dirty) {
+        const SDL_Rect rect = toRect(area);
+        SDL_RenderSetClipRect(renderer, &rect);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderFillRect(renderer, &rect);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        for(auto &c: composed) {
+            if(c.area.collides(area)) {
+                const SDL_Rect dst = toRect(c.area);
+                SDL_RenderCopy(renderer, c.object->layer, nullptr, &dst);
+            }
+        }
+    }
+    SDL_RenderSetClipRect(renderer, nullptr);
+    dirty.clear();
+}
+
+bool UILayer::update(const Level &level, const vector<UIObject*> &objects, Level &uiLevel, const ivec2 &windowSize, float scale) {
+    if(texture == nullptr || windowSize != size) {
+        if(texture != nullptr) SDL_DestroyTexture(texture);
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, windowSize.x, windowSize.y);
+        setPremultipliedBlendMode(texture);
+        size = windowSize;
+        //The scale may have changed too
+        for(auto* o: objects) o->invalidate();
+        composed.clear();
+        invalidate({ { 0, 0 }, vec2(size) });
+    }
+    if(&level != lastLevel) {
+        lastLevel = &level;
+        composed.clear();
+        invalidate({ { 0, 0 }, vec2(size) });
+    }
+
+    hasImmediate = false;
+    current.clear();
+    for(auto* o: objects) {
+        if(o->isInvisible()) continue;
+        if(!o->retained) {
+            hasImmediate = true;
+            continue;
+        }
+
+        bool drawn = false;
+        if(o->layer == nullptr || o->needsRedraw()) drawn = render(*o, uiLevel, scale);
+        if(o->layer == nullptr) continue;
+
+        const Frame area = { glm::floor(o->frame.pos * scale), vec2(o->layerSize) };
+        auto prev = find_if(composed.begin(), composed.end(), [o] (auto &c) { return c.object == o; });
+        if(prev == composed.end()) {
+            invalidate(area);
+        } else if(prev->area != area) {
+            invalidate(prev->area);
+            invalidate(area);
+        } else if(drawn) {
+            invalidate(area);
+        }
+        current.push_back({ o, area });
+    }
+
+    //Objects that were deleted or hidden leave a hole. The pointers are only compared.
+    for(auto &c: composed) {
+        if(find_if(current.begin(), current.end(), [&c] (auto &o) { return o.object == c.object; }) == current.end()) {
+            invalidate(c.area);
+        }
+    }
+
+    composed.swap(current);
+    const bool changed = !dirty.empty();
+    compose();
+    return changed || hasImmediate;
+}
+
+void UILayer::draw() {
+    if(texture != nullptr) SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+}
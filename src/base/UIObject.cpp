@@ -1,8 +1,8 @@
 #include <UIObject.hpp>
 #include <Game.hpp>
+#include <FontCache.hpp>
 #include <utf8.h>
 #include <unordered_map>
-#include <locale>
 
 #if !defined(_WIN32) and !defined(__ANDROID__) && !defined(__IOS__)
 #include <SDL2/SDL.h>
@@ -28,12 +28,59 @@ struct CacheValue {
     vector<ivec2> linesSize;
     vector<SDL_Texture*> linesSurface;
     vector<string> linesText;
+    vector<size_t> linesStart;
+    string text;
+    uint64_t textVersion = 0;
+    int asciiAdvances[128];
+    unordered_map<uint32_t, int> advances;
+
+    CacheValue() {
+        std::fill(asciiAdvances, asciiAdvances + 128, -1);
+    }
+
+    /// Gets the advance of a glyph, asking the font only the first time
+    int advance(TTF_Font* font, uint32_t ch) {
+        if(ch < 128 && asciiAdvances[ch] >= 0) return asciiAdvances[ch];
+        if(ch >= 128) {
+            auto it = advances.find(ch);
+            if(it != advances.end()) return it->second;
+        }
+
+        int adv = 0;
+        if(ch <= 0xFFFF) {
+            int minx, maxx, miny, maxy;
+            if(TTF_GlyphMetrics(font, uint16_t(ch), &minx, &maxx, &miny, &maxy, &adv) != 0) adv = 0;
+        } else {
+            char utf8[5] = { 0 };
+            utf8::append(ch, utf8);
+            TTF_SizeUTF8(font, utf8, &adv, nullptr);
+        }
+
+        if(ch < 128) asciiAdvances[ch] = adv;
+        else advances[ch] = adv;
+        return adv;
+    }
+
+    void popLine() {
+        if(linesSurface.back() != nullptr) SDL_DestroyTexture(linesSurface.back());
+        linesSize.pop_back();
+        linesSurface.pop_back();
+        linesText.pop_back();
+        linesStart.pop_back();
+    }
 
     void clear() {
         for(auto &t: linesSurface) if(t != nullptr) SDL_DestroyTexture(t);
+        linesSize.clear();
+        linesSurface.clear();
+        linesText.clear();
+        linesStart.clear();
     }
 };
 
+static inline bool isSpace(uint32_t ch) {
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
 
 void UIObject::clearCache() {
     if(cacheValue != nullptr) {
@@ -56,7 +103,8 @@ UIObject::UIObject(UIObject* parent, const glm::vec2 &pos, const std::string &na
 
 UIObject::~UIObject() {
     clearCache();
-    if(font != nullptr) TTF_CloseFont(font);
+    if(layer != nullptr) SDL_DestroyTexture(layer);
+    game().fontCache->release(font);
     for(auto* &o: subObjects) delete o;
     if(parent) {
         if(parent->focused == this) {
@@ -85,22 +133,30 @@ void UIObject::setTextBoxLimit(BoxLimit limit, const ivec2 size) {
     }
     clearCache();
     this->boxLimit = limit;
+    dirty = true;
 }
 
 BoxLimit UIObject::getTextBoxLimit() {
     return boxLimit;
 }
 
-void UIObject::setFontWithPath(const string &path, uint32_t size) {
-    if(fontPath == path && fontSize == size) return;
-    if(font != nullptr) TTF_CloseFont(font);
-    font = TTF_OpenFont(path.c_str(), int(size));
-    if(font == nullptr) {
-        throw runtime_error(string("Could not open font ") + path + ": " + TTF_GetError());
-    }
+void UIObject::retainFont() {
+    if(font != nullptr) game().fontCache->retain(font);
+}
+
+void UIObject::changeFont(const string &path, uint32_t size, int style, int outline) {
+    TTF_Font* newFont = game().fontCache->acquire(path, size, style, outline);
+    game().fontCache->release(font);
+    font = newFont;
     fontPath = path;
     fontSize = size;
     clearCache();
+    dirty = true;
+}
+
+void UIObject::setFontWithPath(const string &path, uint32_t size) {
+    if(fontPath == path && fontSize == size) return;
+    changeFont(path, size, TTF_STYLE_NORMAL, 0);
 }
 
 void UIObject::setFont(const string &name, uint32_t size) {
@@ -123,8 +179,7 @@ void UIObject::setFontStyle(FontStyle style) {
     if((style & f::Underline) == f::Underline) _style |= TTF_STYLE_UNDERLINE;
     if((style & f::Strikethrough) == f::Strikethrough) _style |= TTF_STYLE_STRIKETHROUGH;
     if(TTF_GetFontStyle(font) != _style) {
-        TTF_SetFontStyle(font, _style);
-        clearCache();
+        changeFont(fontPath, fontSize, _style, TTF_GetFontOutline(font));
     }
 }
 
@@ -141,8 +196,7 @@ FontStyle UIObject::getFontStyle() {
 
 void UIObject::setFontOutline(uint32_t outlinepx) {
     if(uint32_t(TTF_GetFontOutline(font)) != outlinepx) {
-        TTF_SetFontOutline(font, int(outlinepx));
-        clearCache();
+        changeFont(fontPath, fontSize, TTF_GetFontStyle(font), int(outlinepx));
     }
 }
 
@@ -155,9 +209,10 @@ void UIObject::setText(const string &str) {
         text = str;
         replace_if(text.begin(),
                    text.end(),
-                   [loc=locale("")] (auto &c) { return iscntrl(c, loc) && c != '\n'; },
+                   [] (char c) { return (uint8_t(c) < 0x20 || c == 0x7F) && c != '\n'; },
                    ' ');
-        clearCache();
+        textVersion++;
+        dirty = true;
     }
 }
 
@@ -165,99 +220,102 @@ void UIObject::setTextColor(Color c) {
     if(c != color) {
         color = c;
         clearCache();
+        dirty = true;
     }
 }
 
-static auto split = [] (const string &str, auto delim) -> vector<string> {
-    vector<string> parts;
-    size_t pos, opos = 0;
-    while((pos = str.find(delim, opos)) != string::npos) {
-        parts.push_back(str.substr(opos, pos - opos));
-        opos = pos + strlen(delim);
-    }
-    if(opos < str.size()) parts.push_back(str.substr(opos));
-    return parts;
-};
-
 void UIObject::generateCache() {
     using l = BoxLimit;
-    CacheValue value;
+    if(cacheValue == nullptr) cacheValue = new CacheValue;
+    CacheValue &value = *cacheValue;
+
+    //When the text is the old one with something appended (like a typewriter does), only the
+    //last line can change. The layout starts again from that line, the rest is kept.
+    size_t start = 0;
+    if(!value.linesStart.empty() && text.size() >= value.text.size() && text.compare(0, value.text.size(), value.text) == 0) {
+        start = value.linesStart.back();
+        value.popLine();
+    } else {
+        value.clear();
+    }
+    value.text = text;
+    value.textVersion = textVersion;
+
     SDL_Color col = { uint8_t(color.r), uint8_t(color.g), uint8_t(color.b), uint8_t(color.a) };
-    auto textWidth = [this] (const std::string &t) -> size_t { int w; TTF_SizeUTF8(font, t.c_str(), &w, nullptr); return size_t(w); };
-    if(boxLimit == l::FixedWidthAndHeight || boxLimit == l::FixedWidth) {
-        int w, h;
-        for(auto &originalLine: split(text, "\n")) {
-            TTF_SizeUTF8(font, originalLine.c_str(), &w, &h);
-            float parts = float(textFrame.x) / float(w);
-            auto loc = locale("");
-            auto lastPos = originalLine.begin();
-            size_t numOfChars = utf8::distance(originalLine.begin(), originalLine.end());
-            while(lastPos < originalLine.end() && (boxLimit == l::FixedWidth || value.linesText.size() * TTF_FontLineSkip(font) < textFrame.y)) {
-                auto nextPos = lastPos;
-                utf8::advance(nextPos,
-                              std::min(size_t(utf8::distance(originalLine.begin(), originalLine.end()) * parts), numOfChars),
-                              originalLine.end());
-                auto it = nextPos;
-                auto nextPosSi = nextPos;
-                //If the character is not a space
-                //The current position is greater than the start position for the substring
-                //The current position is less than the size of the text
-                //OR the textWith is higher than the box
-                while((it > lastPos && it < originalLine.end() && !std::isspace(*it, loc)) || textWidth(originalLine.substr(lastPos - originalLine.begin(), it - lastPos)) > textFrame.x) {
-                    utf8::prior(it, originalLine.begin());
-                    nextPos = it;
-                }
-                //If we cannot split, let the whole line be there
-                if(nextPos == lastPos) {
-                    nextPos = nextPosSi;
-                    while(textWidth(originalLine.substr(lastPos - originalLine.begin(), it - lastPos)) > textFrame.x) {
-                        utf8::prior(it, originalLine.begin());
-                        nextPos = it;
-                    }
-                }
-                string line = originalLine.substr(lastPos - originalLine.begin(), nextPos - lastPos);
-                value.linesText.push_back(line);
-                SDL_Surface* surface = TTF_RenderUTF8_Blended(font, line.c_str(), col);
-                if(surface != nullptr) {
-                    value.linesSurface.push_back(SDL_CreateTextureFromSurface(renderer, surface));
-                    value.linesSize.push_back({ surface->w, surface->h });
-                    SDL_FreeSurface(surface);
-                } else {
-                    value.linesSurface.push_back(nullptr);
-                    value.linesSize.push_back({ 0, TTF_FontHeight(font) });
-                }
-                numOfChars -= utf8::distance(lastPos, nextPos);
-                lastPos = nextPos;
-                while(lastPos < originalLine.end() && std::isspace(*lastPos, loc)) {
-                    lastPos++;
-                    numOfChars--;
+    const int lineSkip = TTF_FontLineSkip(font);
+    auto addLine = [this, &value, &col] (size_t begin, size_t end) {
+        string line = text.substr(begin, end - begin);
+        SDL_Surface* surface = line.empty() ? nullptr : TTF_RenderUTF8_Blended(font, line.c_str(), col);
+        if(surface != nullptr) {
+            value.linesSurface.push_back(SDL_CreateTextureFromSurface(renderer, surface));
+            value.linesSize.push_back({ surface->w, surface->h });
+            SDL_FreeSurface(surface);
+        } else {
+            value.linesSurface.push_back(nullptr);
+            value.linesSize.push_back({ 0, TTF_FontHeight(font) });
+        }
+        value.linesText.push_back(std::move(line));
+        value.linesStart.push_back(begin);
+    };
+
+    //Splits a paragraph into lines that fit in the box width, breaking them at spaces when
+    //possible. The width is the sum of the advance of every glyph, so every character is
+    //measured once (or twice, if it is moved to the next line). Returns false when the box
+    //is full.
+    auto wrap = [this, &value, &addLine, lineSkip] (size_t begin, size_t end) -> bool {
+        const int width = int(textFrame.x);
+        size_t lineStart = begin;
+        while(lineStart < end) {
+            if(boxLimit == l::FixedWidthAndHeight && value.linesText.size() * lineSkip >= textFrame.y) return false;
+
+            size_t pos = lineStart, lineEnd = end, breakPos = string::npos;
+            int x = 0;
+            while(pos < end) {
+                auto it = text.begin() + pos;
+                uint32_t ch = utf8::next(it, text.begin() + end);
+                size_t next = size_t(it - text.begin());
+                x += value.advance(font, ch);
+                if(x > width) {
+                    if(isSpace(ch)) lineEnd = pos;
+                    else if(breakPos != string::npos) lineEnd = breakPos;
+                    else lineEnd = pos > lineStart ? pos : next; //If we cannot split, at least one character per line
+                    break;
                 }
+                if(isSpace(ch) && pos > lineStart) breakPos = pos;
+                pos = next;
             }
-        }
 
-        if(boxLimit == l::FixedWidth) {
-            textFrame.y = std::max(value.linesText.size() * TTF_FontLineSkip(font), size_t(textFrame.y));
+            addLine(lineStart, lineEnd);
+            lineStart = lineEnd;
+            while(lineStart < end && isSpace(uint8_t(text[lineStart]))) lineStart++;
         }
+        return true;
+    };
+
+    size_t pos = start;
+    while(pos < text.size()) {
+        size_t end = std::min(text.find('\n', pos), text.size());
+        if(boxLimit == l::Nothing) addLine(pos, end);
+        else if(!wrap(pos, end)) break;
+        pos = end + 1;
+    }
+
+    if(boxLimit == l::FixedWidth) {
+        textFrame.y = std::max(value.linesText.size() * lineSkip, size_t(textFrame.y));
     } else if(boxLimit == l::Nothing) {
         uvec2 textFrame = { 0, 0 };
-        for(auto &originalLine: split(text, "\n")) {
-            SDL_Surface* surface = TTF_RenderUTF8_Blended(font, originalLine.c_str(), col);
-            textFrame.x = std::max(uint32_t(surface->w), textFrame.x);
-            textFrame.y += surface->h;
-            value.linesText.push_back(originalLine);
-            value.linesSurface.push_back(SDL_CreateTextureFromSurface(renderer, surface));
-            value.linesSize.push_back({ surface->w, surface->h });
-            SDL_FreeSurface(surface);
+        for(auto &size: value.linesSize) {
+            textFrame.x = std::max(uint32_t(size.x), textFrame.x);
+            textFrame.y += size.y;
         }
         this->textFrame.x = std::max(textFrame.x, this->textFrame.x);
         this->textFrame.y = std::max(textFrame.y, this->textFrame.y);
     }
-    cacheValue = new CacheValue(value);
 }
 
 void UIObject::renderText(GameActions &ga, const vec2 &pos) {
     using l = BoxLimit;
-    if(cacheValue == nullptr) {
+    if(cacheValue == nullptr || cacheValue->textVersion != textVersion) {
         generateCache();
     }
 
@@ -399,6 +457,26 @@ void UIObject::draw(GameActions &ga) {
     }
 }
 
+bool UIObject::needsRedraw() const {
+    if(dirty || frame.size != layerFrame.size) return true;
+    for(auto* subObject: subObjects) {
+        //The position of a subobject changes what is drawn in this one
+        if(subObject->frame.pos != subObject->layerFrame.pos || subObject->needsRedraw()) return true;
+    }
+    return false;
+}
+
+void UIObject::markDrawn() {
+    dirty = false;
+    layerFrame = frame;
+    for(auto* subObject: subObjects) subObject->markDrawn();
+}
+
+void UIObject::setRetained(bool retained) {
+    this->retained = retained;
+    dirty = true;
+}
+
 void UIObject::saveState(json &j) const {
     Object::saveState(j);
     j["textFrame"] = textFrame;
@@ -427,15 +505,14 @@ void UIObject::restoreState(const json &j) {
     boxLimit = static_cast<BoxLimit>(static_cast<int>(j["boxLimit"]));
     textFrame = j["textFrame"];
     text = j["text"];
+    textVersion++;
     color = j["color"];
     vAlign = static_cast<TextVerticalAlign>(static_cast<int>(j["verticalAlign"]));
     hAlign = static_cast<TextHorizontalAlign>(static_cast<int>(j["horizontalAlign"]));
-    setFontWithPath(j["font"]["path"], j["font"]["size"]);
-    TTF_SetFontStyle(font, j["font"]["style"]);
-    TTF_SetFontOutline(font, j["font"]["outline"]);
-    clearCache();
+    changeFont(j["font"]["path"], j["font"]["size"], j["font"]["style"], j["font"]["outline"]);
+    dirty = true;
 
-    Logger log = Logger::getLogger("UIObject#" + name);
+    Logger &log = Logger::getLogger("UIObject#" + name);
     for(auto &obj: j["subObjects"]) {
         std::string objName = obj["name"];
         auto it = std::find_if(subObjects.begin(), subObjects.end(), [objName] (Object *o) { return !strcmp(o->getName(), objName.c_str()); });
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <functional>
+#include <new>
+#include <stdint.h>
 #include <tuple>
 #include <type_traits>
-#include <memory>
+#include <SmallFunction.hpp>
 
 namespace retro {
 
@@ -35,6 +40,19 @@ namespace retro {
         virtual ~Interpolator() {}
     };
 
+    /// Calls the interpolator stored in an Animation without virtual calls
+    template<class I>
+    struct InterpolatorDispatch {
+        static float interpolate(const void* self, float perc) {
+            //The qualified call is resolved at compile time, and can be inlined
+            return static_cast<const I*>(self)->I::interpolate(perc);
+        }
+
+        static void copy(void* dst, const void* src) {
+            new(dst) I(*static_cast<const I*>(src));
+        }
+    };
+
     ///Animates properties of objects or other kind of ethereum entities
     /**
      * The type of `Arg` must be a numeric one or any kind of type that
@@ -68,40 +86,54 @@ namespace retro {
      * isCompleted(), or update the duration and/or the final value of
      * the animation with updateAnimation().
      *
+     * An Animation doesn't allocate memory: the interpolator is copied inside the
+     * object and it is called through a function that knows its type (no virtual
+     * calls), and the setter is a SmallFunction that stores lambdas that capture
+     * up to four pointers inside. Thousands of them can be updated every frame.
+     *
      * If the property type of something you're trying to animate does weird things,
-     * in general due to the use of integer types, you can specialize Animation::animate
-     * to fix that. Here's an example for Color:
+     * in general due to the use of integer types, you can specialize Animation::valueAt
+     * to fix that. It is used by animate() and setProgress(). Here's the one for Color:
      *
      * ```
-     *
-     * const float perc = animDone / duration();
-     *     if(animDone < 0.0) {
-     *     if(setter) setter(from); //Should not happen this case :/
-     *         animDone += delta;
-     *     } else if(animDone < duration()) {
-     *         const float i = interpolator->interpolate(perc);
-     *         const float r = float(from.r) + (float(to.r) - float(from.r)) * i;
-     *         const float g = float(from.g) + (float(to.g) - float(from.g)) * i;
-     *         const float b = float(from.b) + (float(to.b) - float(from.b)) * i;
-     *         const float a = float(from.a) + (float(to.a) - float(from.a)) * i;
-     *         if(setter) setter({ r, g, b, a });
-     *         animDone += delta;
-     *     } else {
-     *         if(setter) setter(to); //Protect from large animations
-     *     }
+     * template<>
+     * inline Color Animation<Color>::valueAt(float perc) const {
+     *     const float i = interpolate(perc);
+     *     const uint8_t r = Color::channel(float(from.r) + (float(to.r) - float(from.r)) * i);
+     *     const uint8_t g = Color::channel(float(from.g) + (float(to.g) - float(from.g)) * i);
+     *     const uint8_t b = Color::channel(float(from.b) + (float(to.b) - float(from.b)) * i);
+     *     const uint8_t a = Color::channel(float(from.a) + (float(to.a) - float(from.a)) * i);
+     *     return { r, g, b, a };
      * }
      *
      * ```
      **/
     template<typename Arg>
     struct Animation {
-        typedef std::function<void(const Arg&)> Setter; ///< The signature of setter functions
-        typedef std::function<float()> Duration; ///< Duration from a function, should not be modified when the animation is running
+        typedef SmallFunction<void(const Arg&)> Setter; ///< The signature of setter functions
+        typedef std::function<float()> Duration; ///< Duration from a function, deprecated
+
+        /// Maximum size of an interpolator object
+        static constexpr size_t maxInterpolatorSize = 4 * sizeof(void*);
 
-        std::shared_ptr<Interpolator<float>> interpolator = nullptr; ///< The inmutable interpolation implementation
+    private:
+        typedef float (*InterpolateFunc)(const void*, float);
+        typedef void (*CopyFunc)(void*, const void*);
+
+        typename std::aligned_storage<maxInterpolatorSize, alignof(void*)>::type interpolatorStorage;
+        InterpolateFunc interpolateFunc = nullptr;
+        CopyFunc copyFunc = nullptr;
+
+        void copyInterpolator(const Animation<Arg> &o) {
+            interpolateFunc = o.interpolateFunc;
+            copyFunc = o.copyFunc;
+            if(copyFunc) copyFunc(&interpolatorStorage, &o.interpolatorStorage);
+        }
+
+    public:
         Setter setter; ///< The setter (lambda) function
         Arg from, to;
-        Duration duration = [] () { return 0.0f; };
+        float duration = 0.0f; ///< Duration in seconds, should not be modified when the animation is running
         float animDone = 0.0f;
 
         /**
@@ -112,33 +144,28 @@ namespace retro {
          * @param to The final value of the animation
          * @param setter A function that changes the property when a new value is available
          **/
-        template<template<typename> class Inter>
-        Animation(Inter<float> interp, float duration, Arg from, Arg to, const Setter &setter):
-        interpolator(new Inter<float>(interp)),
+        template<class Inter>
+        Animation(Inter interp, float duration, Arg from, Arg to, const Setter &setter):
+        interpolateFunc(&InterpolatorDispatch<Inter>::interpolate),
+        copyFunc(&InterpolatorDispatch<Inter>::copy),
         setter(setter),
         from(from),
         to(to),
-        duration([duration] () -> float { return duration; }) {
-            static_assert(std::is_base_of<Interpolator<float>, Inter<float>>::value, "Type of interpolator must inherit from Interpolator");
+        duration(duration) {
+            static_assert(std::is_base_of<Interpolator<float>, Inter>::value, "Type of interpolator must inherit from Interpolator");
+            static_assert(sizeof(Inter) <= maxInterpolatorSize && alignof(Inter) <= alignof(void*), "Interpolator is too big to be stored in an Animation");
+            new(&interpolatorStorage) Inter(interp);
         }
 
         /**
-         * Creates a new initialized animation with the following parameters.
-         * @param interp An interpolator to be used in the animation
-         * @param duration Duration of the animation in seconds, calculated from a function
-         * @param from The initial value of the animation
-         * @param to The final value of the animation
-         * @param setter A function that changes the property when a new value is available
+         * Creates a new initialized animation with a duration calculated from a function.
+         * The function is called once, here, the animation doesn't see later changes.
+         * @deprecated Use the constructor with the duration in seconds
          **/
-        template<template<typename> class Inter>
-        Animation(Inter<float> interp, Duration duration, Arg from, Arg to, const Setter &setter):
-        interpolator(new Inter<float>(interp)),
-        setter(setter),
-        from(from),
-        to(to),
-        duration(duration) {
-            static_assert(std::is_base_of<Interpolator<float>, Inter<float>>::value, "Type of interpolator must inherit from Interpolator");
-        }
+        template<class Inter>
+        [[deprecated("The duration is no longer lazy, use the constructor with a float")]]
+        Animation(Inter interp, Duration duration, Arg from, Arg to, const Setter &setter):
+        Animation(interp, duration(), from, to, setter) {}
 
         /**
          * Creates an unitialized animation. To initialize it, associate a new
@@ -158,6 +185,16 @@ namespace retro {
 
         ~Animation() {}
 
+        /// Calculates the value of the interpolator for a percentage of the animation done [0..1]
+        inline float interpolate(float perc) const {
+            return interpolateFunc(&interpolatorStorage, perc);
+        }
+
+        /// Calculates the value of the property for a percentage of the animation done [0..1]
+        inline Arg valueAt(float perc) const {
+            return Arg(from + (to - from) * interpolate(perc));
+        }
+
         /**
          * Updates the animation with a new final value. Doesn't alter the duration
          * nor the current time, a jump in the animation can occur.
@@ -192,12 +229,11 @@ namespace retro {
          * @param delta Time passed since last animate call
          **/
         void animate(float delta) {
-            const float perc = animDone / duration();
             if(animDone < 0.0) {
                 if(setter) setter(from); //Should not happen this case :/
                 animDone += delta;
-            } else if(animDone < duration()) {
-                if(setter) setter(Arg(from + (to - from) * interpolator->interpolate(perc)));
+            } else if(animDone < duration) {
+                if(setter) setter(valueAt(animDone / duration));
                 animDone += delta;
             } else {
                 if(setter) setter(to); //Protect from large animations
@@ -207,11 +243,11 @@ namespace retro {
         /**
          * @return `true` if the animation is completed or unitialized
          **/
-        inline bool isCompleted() const { return animDone >= duration(); }
+        inline bool isCompleted() const { return animDone >= duration; }
 
         /// Changes the current state of the animation to complete
         void complete() {
-            animDone = duration();
+            animDone = duration;
             if(setter) setter(to);
         }
 
@@ -221,6 +257,8 @@ namespace retro {
             animDone = std::abs(time);
             if(!wasDone && isCompleted()) {
                 if(setter) setter(to);
+            } else if(!isCompleted() && setter) {
+                setter(valueAt(animDone / duration));
             }
         }
 
@@ -228,12 +266,12 @@ namespace retro {
         inline void reset() { animDone = 0.0; }
 
         constexpr float getDuration() const {
-            return duration();
+            return duration;
         }
 
         /// Asign operator
         inline Animation<Arg>& operator=(const Animation<Arg> &o) {
-            interpolator = o.interpolator;
+            copyInterpolator(o);
             setter = o.setter;
             from = o.from;
             to = o.to;
@@ -244,7 +282,7 @@ namespace retro {
 
         /// Move-asign operator
         inline Animation<Arg>& operator=(Animation<Arg> &&o) {
-            interpolator = o.interpolator; o.interpolator = nullptr;
+            copyInterpolator(o);
             setter = std::move(o.setter);
             from = std::move(o.from);
             to = std::move(o.to);
@@ -255,24 +293,18 @@ namespace retro {
 
     };
 
-    ///Specialization of animate for Colors
+    template<typename Arg>
+    constexpr size_t Animation<Arg>::maxInterpolatorSize;
+
+    ///Specialization of valueAt for Colors, the channels are interpolated as floats
     template<>
-    inline void Animation<Color>::animate(float delta) {
-        const float perc = animDone / duration();
-        if(animDone < 0.0) {
-            if(setter) setter(from); //Should not happen this case :/
-            animDone += delta;
-        } else if(animDone < duration()) {
-            const float i = interpolator->interpolate(perc);
-            const float r = float(from.r) + (float(to.r) - float(from.r)) * i;
-            const float g = float(from.g) + (float(to.g) - float(from.g)) * i;
-            const float b = float(from.b) + (float(to.b) - float(from.b)) * i;
-            const float a = float(from.a) + (float(to.a) - float(from.a)) * i;
-            if(setter) setter({ r, g, b, a });
-            animDone += delta;
-        } else {
-            if(setter) setter(to); //Protect from large animations
-        }
+    inline Color Animation<Color>::valueAt(float perc) const {
+        const float i = interpolate(perc);
+        const uint8_t r = Color::channel(float(from.r) + (float(to.r) - float(from.r)) * i);
+        const uint8_t g = Color::channel(float(from.g) + (float(to.g) - float(from.g)) * i);
+        const uint8_t b = Color::channel(float(from.b) + (float(to.b) - float(from.b)) * i);
+        const uint8_t a = Color::channel(float(from.a) + (float(to.a) - float(from.a)) * i);
+        return { r, g, b, a };
     }
 
     // https://github.com/acron0/Easings/blob/master/Easings.cs
@@ -341,7 +373,10 @@ namespace retro {
         /// Quart interpolator (`x^4`) that starts fast and ends slow
         template<typename T = float>
         struct QuartOut: public Interpolator<T> {
-            constexpr T interpolate(T perc) const override { return -(perc -= T(1)) * perc * perc * perc + T(1); }
+            constexpr T interpolate(T perc) const override {
+                perc -= T(1);
+                return -perc * perc * perc * perc + T(1);
+            }
         };
 
         /// Quart interpolator (`x^4`) that starts slow, continues fast and ends slow
@@ -363,7 +398,10 @@ namespace retro {
         /// Quint interpolator (`x^5`) that starts fast and ends slow
         template<typename T = float>
         struct QuintOut: public Interpolator<T> {
-            constexpr T interpolate(T perc) const override { return -(perc -= T(1)) * perc * perc * perc * perc + T(1); }
+            constexpr T interpolate(T perc) const override {
+                perc -= T(1);
+                return perc * perc * perc * perc * perc + T(1);
+            }
         };
 
         /// Quint interpolator (`x^5`) that starts slow, continues fast and ends slow
@@ -408,7 +446,10 @@ namespace retro {
         template<typename T = float>
         struct BackOut: public Interpolator<T> {
             static constexpr T S = T(1.70158);
-            constexpr T interpolate(T perc) const override { return (perc -= 1) * perc * ((S + 1) * perc + S) + 1; }
+            constexpr T interpolate(T perc) const override {
+                perc -= T(1);
+                return perc * perc * ((S + 1) * perc + S) + 1;
+            }
         };
 
         /// A combination of BackIn and BackOut
@@ -417,7 +458,8 @@ namespace retro {
             static constexpr T S = T(1.70158);
             constexpr T interpolate(T t) const override {
                 if((t *= T(2)) < 1) return T(0.5) * (t * t * (((S * T(1.525)) + T(1)) * t - S * T(1.525)));
-                return T(0.5) * ((t -= 2) * t * (((S * T(1.525)) +T(1)) * t + S * T(1.525)) + T(2));
+                t -= T(2);
+                return T(0.5) * (t * t * (((S * T(1.525)) +T(1)) * t + S * T(1.525)) + T(2));
             }
         };
 
@@ -430,14 +472,20 @@ namespace retro {
         /// An interpolator that starts fast and decrements its speed incrediblement slowly
         template<typename T = float>
         struct CircOut: public Interpolator<T> {
-            constexpr T interpolate(T perc) const override { return std::sqrt(T(1) - (perc -= T(1)) * perc); }
+            constexpr T interpolate(T perc) const override {
+                perc -= T(1);
+                return std::sqrt(T(1) - perc * perc);
+            }
         };
 
         /// An interpolator that starts and ends slowly, and in intermediate positions goes super-fast
         template<typename T = float>
         struct CircInOut: public Interpolator<T> {
             constexpr T interpolate(T perc) const override {
-                return (perc *= T(2)) < 1 ? -T(0.5) * std::sqrt(T(1) - perc * perc) - T(1) : T(1) * (std::sqrt(T(1) - (perc -= T(2)) * perc) + T(1));
+                perc *= T(2);
+                if(perc < T(1)) return -T(0.5) * (std::sqrt(T(1) - perc * perc) - T(1));
+                perc -= T(2);
+                return T(0.5) * (std::sqrt(T(1) - perc * perc) + T(1));
             }
         };
 
@@ -448,11 +496,14 @@ namespace retro {
                 if(perc < T(1)/T(2.75)) {
                     return T(7.5625) * perc * perc;
                 } else if(perc < T(2)/T(2.75)) {
-                    return T(7.5625) * (perc -= T(1.5)/T(2.75)) * perc + T(0.75);
+                    perc -= T(1.5)/T(2.75);
+                    return T(7.5625) * perc * perc + T(0.75);
                 } else if(perc < T(2.5)/T(2.75)) {
-                    return T(7.5625) * (perc -= T(2.25)/T(2.75)) * perc + T(0.9375);
+                    perc -= T(2.25)/T(2.75);
+                    return T(7.5625) * perc * perc + T(0.9375);
                 } else {
-                    return T(7.5625) * (perc -= T(2.625)/T(2.75)) * perc + T(0.984375);
+                    perc -= T(2.625)/T(2.75);
+                    return T(7.5625) * perc * perc + T(0.984375);
                 }
             }
         };
@@ -486,7 +537,8 @@ namespace retro {
             constexpr T interpolate(T t) const override {
                 if(t == T(0) || t == T(1)) return t;
                 T s = p / T(2*PI) * std::asin(T(1) / a);
-                return -(a * std::pow(T(2), -T(10) * (t -= T(1))) * std::sin((t - s) * T(2*PI) / p));
+                t -= T(1);
+                return -(a * std::pow(T(2), -T(10) * t) * std::sin((t - s) * T(2*PI) / p));
             }
         };
 
@@ -522,10 +574,13 @@ namespace retro {
             }
 
             constexpr T interpolate(T t) const override {
-                if(t == T(0) || (t *= T(2)) == T(2)) return t;
+                if(t == T(0) || t == T(1)) return t;
+                t *= T(2);
                 T s = p / T(2*PI) * std::asin(T(1) / a);
-                if(t < 1) return -T(0.5) * (a * std::pow(T(2), T(10) * (t -= T(1)) * std::sin((t - s) * T(2*PI) / p)));
-                else return a * std::pow(T(2), -T(10) * (t -= T(1))) * std::sin((t - s) * T(2*PI) / p) * T(0.5) + T(1);
+                const bool firstHalf = t < 1;
+                t -= T(1);
+                if(firstHalf) return -T(0.5) * (a * std::pow(T(2), T(10) * t * std::sin((t - s) * T(2*PI) / p)));
+                else return a * std::pow(T(2), -T(10) * t) * std::sin((t - s) * T(2*PI) / p) * T(0.5) + T(1);
             }
         };
 
@@ -550,6 +605,82 @@ namespace retro {
             }
         };
 
+        /// Interpolates many values at once
+        /**
+         * Calls the interpolator for every value of `in` and stores the results in `out`
+         * (both arrays of `n` elements, they can be the same array). The type of the
+         * interpolator is known, so there are no virtual calls and the compiler can inline
+         * and vectorise the loop.
+         */
+        template<class I, typename T>
+        inline void interpolate(const I &interp, const T* in, T* out, size_t n) {
+            static_assert(std::is_base_of<Interpolator<T>, I>::value, "Type of interpolator must inherit from Interpolator");
+            for(size_t i = 0; i < n; i++) out[i] = interp.I::interpolate(in[i]);
+        }
+
+        /// Precomputed version of another interpolator
+        /**
+         * Evaluates the interpolator `I` in `N + 1` equidistant points the first time it is
+         * used, and then interpolates linearly between them: a lookup and a multiply-add instead
+         * of calls to `pow`, `sin` or `sqrt`. It pays off for the Sine, Expo and Elastic
+         * interpolators (3 to 4 times faster); the polynomial ones are cheaper to calculate than
+         * to look up.
+         *
+         * With the default 256 points, the error is around 0.00001 for the Sine interpolators and
+         * below 0.001 for Expo and Elastic ones. Where the curve has corners (Bounce) or a vertical
+         * slope (Circ) the error is bigger, up to 0.003 and 0.02 respectively.
+         *
+         * ```
+         * Animation<float>(interpolator::Tabulated<interpolator::ElasticOut<>>(), 1, 0.01f, 0.92f, setter);
+         * ```
+         *
+         * The table is built at runtime (once per interpolator type), because the math functions
+         * from the standard library are not `constexpr`.
+         */
+        template<class I, size_t N = 256>
+        struct Tabulated: public Interpolator<float> {
+            static_assert(std::is_base_of<Interpolator<float>, I>::value, "Type of interpolator must inherit from Interpolator");
+            static_assert(N >= 2, "The table must have at least 2 intervals");
+
+            /// Gets the table of `N + 1` values
+            static const float* table() {
+                static const std::array<float, N + 1> values = [] () {
+                    std::array<float, N + 1> values;
+                    const I interp;
+                    for(size_t i = 0; i <= N; i++) values[i] = interp.I::interpolate(float(i) / float(N));
+                    return values;
+                }();
+                return values.data();
+            }
+
+            float interpolate(float perc) const override {
+                return lookup(table(), perc);
+            }
+
+            /// Interpolates `n` values from `in` into `out` (they can be the same array)
+            /**
+             * This is not a SIMD path: every value needs two loads from the table at an index
+             * that depends on the value (a gather), and the compiler cannot prove that `out`
+             * doesn't overlap the table, so the loop stays scalar. It has no branches (the
+             * clamp is a min and a max and the index is a truncation) and the table fits in
+             * the L1 cache. See `src/benchmarks` for the numbers against the exact interpolators.
+             */
+            void interpolate(const float* in, float* out, size_t n) const {
+                const float* values = table();
+                for(size_t i = 0; i < n; i++) out[i] = lookup(values, in[i]);
+            }
+
+        private:
+
+            static inline float lookup(const float* values, float perc) {
+                const float x = std::min(std::max(perc, 0.0f), 1.0f) * float(N);
+                //x is not negative, so truncating is flooring. For x = N the last interval is used with f = 1
+                const int32_t i = int32_t(std::min(x, float(N) - 0.5f));
+                const float f = x - float(i);
+                return values[i] + (values[i + 1] - values[i]) * f;
+            }
+        };
+
     }
 
 }
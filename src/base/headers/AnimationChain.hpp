@@ -201,9 +201,11 @@ namespace retro {
             reset();
             hasStarted = true;
             it = animations.begin();
-            while(time > 0) {
+            while(it != animations.end() && time > 0) {
                 it->setProgress(time);
+                if(!it->isCompleted()) break;
                 time -= it->getDuration();
+                it++;
             }
         }
 
@@ -240,18 +242,12 @@ namespace retro {
         return Animation<T>(interpolator::Linear<>(), duration, 0, 1, [] (auto&) {});
     }
 
-    /// Empty animation that is useful for making delays in AnimationChain
-    /**
-     * Adds a delay to the AnimationChain, with an Animation that does
-     * nothing but not letting the AnimationChain to change to the next
-     * animation until this bougs Animation ends. In this overload, the
-     * duration is calculated from a function.
-     * @param duration The duration of the delay in seconds, calculated from the function
-     * @return An Animation instance that does nothing
-     */
+    /// Empty animation with the duration calculated from a function, called once here.
+    /// @deprecated Use delay() with the duration in seconds
     template<typename T>
+    [[deprecated("The duration is no longer lazy, use delay() with a float")]]
     inline auto delay(typename Animation<T>::Duration duration) -> Animation<T> {
-        return Animation<T>(interpolator::Linear<>(), duration, T(), T(), [] (auto&) {});
+        return delay<T>(duration());
     }
 
     template<typename T>
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <Image.hpp>
+#include <Map.hpp>
+
+namespace retro {
+
+    class Game;
+    class Logger;
+
+    /// Loads assets in the background.
+    /**
+     * Reading files and decoding pixels is done in worker threads, but creating the GPU
+     * textures must be done in the main thread. So every asset is loaded in two steps:
+     * the _decode_ step runs in a worker, and the _upload_ step is queued to be run by
+     * the game loop, which uploads as many assets as it can in a time budget every frame
+     * (see setUploadBudget()). This way, the next level can stream its assets while the
+     * current one is still playing.
+     *
+     * Usually, you will use it inside Level::preload() to enqueue the assets needed by
+     * the level, and then, inside Level::setup(), you will get them using getImage() or
+     * getMap(). If an asset was not preloaded (or it is not loaded yet), these methods
+     * load it synchronously, so they always return something useful.
+     *
+     * Preloaded assets are handed over once: after getting an asset, the loader forgets
+     * about it. The ones that nobody gets are evicted by the Game after the setup() of the
+     * next level (see evict()).
+     *
+     * Fonts are not loaded here because SDL_ttf cannot be used outside the main thread.
+     **/
+    class AssetLoader {
+
+        Game &game;
+        Logger &log;
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable jobsCondition;
+        std::condition_variable doneCondition;
+        std::deque<std::function<std::function<void()>()>> jobs;
+        std::deque<std::function<void()>> uploads;
+        size_t runningJobs = 0;
+        bool stop = false;
+        double uploadBudget = 0.002;
+
+        std::set<std::string> pending;
+        std::map<std::string, ImagePtr> images;
+        std::map<std::string, std::shared_ptr<Map>> maps;
+
+        void worker();
+        void enqueue(const std::string &path, std::function<std::function<void()>()> &&job);
+
+    public:
+
+        /// Creates the loader with `threads` workers. If 0, a sensible number is chosen.
+        AssetLoader(Game &game, Logger &log, size_t threads = 0);
+        AssetLoader(const AssetLoader &) = delete;
+        ~AssetLoader();
+
+        /// Enqueues an image to be loaded. The texture will be generated with Image::regenerate().
+        /// If `atlas` is true, the image is packed into the game's TextureAtlas (see Image::enableAtlas()).
+        void preloadImage(const std::string &path, Image::Channels desired = Image::Undefined, bool atlas = false);
+        /// Enqueues a map (and its sprites) to be loaded. Textures will be generated too.
+        void preloadMap(const std::string &path);
+
+        /// Gets a preloaded image, or loads it right now if it is not available.
+        /**
+         * The image returned by this method has its texture already generated, so it is not
+         * needed to call Image::regenerate() again (but you can call Image::generateAndDestroy()).
+         * `atlas` is used only if the image was not preloaded, otherwise the one given to
+         * preloadImage() applies.
+         */
+        ImagePtr getImage(const std::string &path, Image::Channels desired = Image::Undefined, bool atlas = false);
+        /// Gets a preloaded map, or loads it right now if it is not available.
+        /// If the map was preloaded, Map::hasTextures() will be true.
+        Map getMap(const std::string &path);
+
+        /// Forgets the preloaded assets that are ready but were not taken with getImage() or getMap().
+        /// Called by the Game after changing the level, assets still being loaded are kept.
+        void evict();
+
+        /// Returns true if there's some asset being decoded or waiting to be uploaded.
+        bool isLoading();
+
+        /// Sets the maximum time (in seconds) spent uploading assets in a frame.
+        inline void setUploadBudget(double seconds) { uploadBudget = seconds; }
+        /// Gets the maximum time (in seconds) spent uploading assets in a frame.
+        constexpr double getUploadBudget() const { return uploadBudget; }
+
+        /// Uploads decoded assets until the upload budget is exhausted. Must be called from the main thread.
+        void upload();
+        /// Waits until every asset is decoded and uploads all of them. Must be called from the main thread.
+        void finish();
+
+    };
+
+}
@@ -1,23 +1,41 @@
 #pragma once
 
+#include <Level.hpp>
 #include <Object.hpp>
 #include <MovableObject.hpp>
 #include <functional>
 
 namespace retro {
 
+    /// An invisible area that tells when an object enters or leaves it
+    /**
+     * The trigger is registered in the TriggerIndex of the Level, which checks it only when
+     * the object is near, and calls onCollisionStart() or onCollisionEnd() (and the listeners)
+     * when the object starts or stops colliding with the frame. Move the trigger with setFrame().
+     * While the trigger is disabled, it sends no events.
+     **/
     class CollisionDetection: public Object {
     public:
         typedef std::function<void(MovableObject &, CollisionFace, const Frame &)> OnCollisionStart;
         typedef std::function<void(MovableObject &, CollisionFace, const Frame &)> OnCollisionEnd;
 
     private:
+        friend class TriggerIndex;
+
         MovableObject* object;
         OnCollisionStart start;
         OnCollisionEnd end;
-        bool isColliding = false;
-        CollisionFace lastFace;
-        Frame lastCollision;
+        uint32_t slot = 0;
+
+        void collisionStarted(CollisionFace face, const Frame &collision) {
+            onCollisionStart(*object, face, collision);
+            if(start) start(*object, face, collision);
+        }
+
+        void collisionEnded(CollisionFace lastFace, const Frame &lastCollision) {
+            onCollisionEnd(*object, lastFace, lastCollision);
+            if(end) end(*object, lastFace, lastCollision);
+        }
 
     protected:
 
@@ -28,6 +46,11 @@ namespace retro {
         CollisionDetection(Game &g, Level &l, const glm::vec2 &pos, const std::string &str, MovableObject* detectable): Object(g, l, pos, str) {
             assert(detectable != nullptr);
             object = detectable;
+            level.triggers.add(this);
+        }
+
+        CollisionDetection(const CollisionDetection &o): Object(o), object(o.object), start(o.start), end(o.end) {
+            level.triggers.add(this);
         }
 
         void setOnCollisionStartListener(const OnCollisionStart &listener) { start = listener; }
@@ -35,30 +58,22 @@ namespace retro {
         void setOnCollisionEndListener(const OnCollisionEnd &listener) { end = listener; }
         void setOnCollisionEndListener(OnCollisionEnd &&listener) { end = std::forward<OnCollisionEnd>(listener); }
 
-        constexpr void setFrame(const Frame &frame) { this->frame = frame; }
-        constexpr void setFrame(const glm::vec2 &pos, const glm::vec2 &size) { this->frame = Frame{ pos, size }; }
+        void setFrame(const Frame &frame) { this->frame = frame; level.triggers.moved(this); }
+        void setFrame(const glm::vec2 &pos, const glm::vec2 &size) { setFrame(Frame{ pos, size }); }
 
         void setup() override {}
         void draw(GameActions &) override {}
+        void update(float, GameActions &) override {}
 
-        void update(float, GameActions &) override {
-            CollisionFace face;
-            Frame collision;
-            std::tie(face, collision) = object->getFrame().collision(frame);
-            if(face != CollisionFace::NONE && !isColliding) {
-                isColliding = true;
-                onCollisionStart(*object, face, collision);
-                if(start) start(*object, face, collision);
-            } else if(face != CollisionFace::NONE && isColliding) {
-                lastFace = face;
-                lastCollision = std::move(collision);
-            } else if(face == CollisionFace::NONE && isColliding) {
-                isColliding = false;
-                onCollisionEnd(*object, lastFace, lastCollision);
-                if(end) end(*object, lastFace, lastCollision);
-            }
+        void restoreState(const json &j) override {
+            Object::restoreState(j);
+            level.triggers.moved(this);
         }
-        
+
+        virtual ~CollisionDetection() {
+            level.triggers.remove(this);
+        }
+
     };
 
 }
@@ -24,6 +24,11 @@ namespace retro {
         r(vtype(r)), g(vtype(g)), b(vtype(b)), a(vtype(a)) {}
         constexpr Color(const Color &c): r(c.r), g(c.g), b(c.b), a(c.a) {}
 
+        /// Rounds a channel computed with floats, clamped to [0, 255] (interpolators can overshoot)
+        static constexpr vtype channel(float v) {
+            return !(v > 0.0f) ? vtype(0) : v >= 255.0f ? vtype(255) : vtype(v + 0.5f);
+        }
+
         constexpr bool operator==(const Color &o) const {
             return r == o.r && g == o.g && b == o.b && a == o.a;
         }
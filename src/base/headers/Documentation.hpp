@@ -253,7 +253,7 @@
  * [{"command": "game", "value": null}]
  * ```
  * ```
- * [{"options":[{"attribute":"currentLevel","type":"Object"},{"attribute":"levels","type":"Array"},{"attribute":"name","type":"String"},{"attribute":"path","type":"String"},{"attribute":"quit","type":"Bool"}]}]
+ * [{"options":[{"attribute":"currentLevel","type":"Object"},{"attribute":"levels","type":"Array"},{"attribute":"name","type":"String"},{"attribute":"path","type":"String"},{"attribute":"quit","type":"Bool"},{"attribute":"textCache","type":"Object"}]}]
  * ```
  *
  * \subsection ex-error Attribute access with error
@@ -288,6 +288,16 @@
  * [{"boxLimit":1,"color":{"a":255,"b":255,"g":254,"r":10},"font":{"outline":0,"path":"/Users/melchor9000/Desktop/retro++/res/Ubuntu-R.ttf","size":26,"style":0},"frame":{"pos":{"x":800.0,"y":100.0},"size":{"x":300.0,"y":300.0}},"horizontalAlign":1,"name":"untexto","subObjects":[{"backgroundColor":null,"borderColor":null,"boxLimit":2,"color":{"a":255,"b":255,"g":255,"r":255},"font":{"outline":0,"path":"/Users/melchor9000/Desktop/retro++/res/Ubuntu-R.ttf","size":11,"style":0},"frame":{"pos":{"x":10.0,"y":10.0},"size":{"x":148.0,"y":14.0}},"horizontalAlign":0,"name":"otroTexto","subObjects":[],"text":"Otro texto normal y corriente","textFrame":{"x":148,"y":14},"verticalAlign":0}],"text":"Hola","textFrame":{"x":300,"y":300},"verticalAlign":1}]
  * ```
  *
+ * \subsection ex-text-cache Text cache statistics
+ * The cache of rendered texts reports its hits, misses and evictions. Its `budget` (in bytes) can be
+ * changed, and the counters can be reset setting them to 0.
+ * ```
+ * [{"command": "game::textCache", "value": {"budget": 4194304, "hits": 0, "misses": 0, "evictions": 0}}]
+ * ```
+ * ```
+ * [{"budget":4194304,"bytes":81920,"entries":3,"evictions":0,"hits":0,"misses":0}]
+ * ```
+ *
  * \subsection ex-multiple-cmd Multiple commands in one request
  * ```
  * [{"command": "game::currentLevel::uiObjects::0::text", "value": null}, {"command": "game::currentLevel::uiObjects::0::font::size", "value": 15}]
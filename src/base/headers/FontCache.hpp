@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <map>
+#include <unordered_map>
+
+typedef struct _TTF_Font TTF_Font;
+
+namespace retro {
+
+    /// Keeps the opened fonts to share them among all the users of the same font.
+    /**
+     * Opening a font reads and parses the whole `ttf` file, and every opened font has its
+     * own glyph cache. The cache opens every combination of path, size, style and outline
+     * only once, and counts how many are using it. SDL_ttf empties the glyph cache of a
+     * font when its style or outline changes, so these are part of the key instead of being
+     * changed on a shared font: **never** change the style or the outline of a font got from
+     * the cache.
+     *
+     * Fonts without users are kept opened until releaseUnused() is called, so creating and
+     * destroying objects that use the same font (like dialogs) doesn't open it again. The
+     * Game calls it when the level changes.
+     **/
+    class FontCache {
+
+        struct Key {
+            std::string path;
+            uint32_t size;
+            int style;
+            int outline;
+
+            inline bool operator<(const Key &o) const {
+                if(size != o.size) return size < o.size;
+                if(style != o.style) return style < o.style;
+                if(outline != o.outline) return outline < o.outline;
+                return path < o.path;
+            }
+        };
+
+        struct Entry {
+            TTF_Font* font;
+            size_t references;
+        };
+
+        std::map<Key, Entry> fonts;
+        std::unordered_map<TTF_Font*, std::map<Key, Entry>::iterator> entries;
+
+    public:
+
+        FontCache() {}
+        FontCache(const FontCache &) = delete;
+        ~FontCache();
+
+        /// Gets the font for the path, size, style and outline, opening it if needed.
+        /**
+         * The style is a combination of `TTF_STYLE_*` values and the outline is in pixels.
+         * Every call must be paired with a release() of the returned font. If the font cannot
+         * be opened, throws an exception.
+         */
+        TTF_Font* acquire(const std::string &path, uint32_t size, int style = 0, int outline = 0);
+        /// Adds a new user to a font got from acquire().
+        void retain(TTF_Font* font);
+        /// Removes a user from a font got from acquire(). `nullptr` is ignored.
+        void release(TTF_Font* font);
+        /// Closes the fonts that no one is using.
+        void releaseUnused();
+
+        /// Gets the number of opened fonts.
+        inline size_t getNumberOfFonts() const { return fonts.size(); }
+
+    };
+
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <glm/vec2.hpp>
+#include <glm/common.hpp>
+#include <limits>
 #include <tuple>
 
 namespace retro {
@@ -94,6 +96,52 @@ namespace retro {
             return std::make_tuple(collision, diff);
         }
 
+        /// Returns the frame that covers this one while it is moved by `motion`
+        inline Frame swept(const glm::vec2 &motion) const {
+            return { glm::min(pos, pos + motion), size + glm::abs(motion) };
+        }
+
+        /**
+         * Moves this frame by `motion` and finds when it starts colliding with `o`, which
+         * doesn't move (for two moving frames, use the motion of this one minus the other's).
+         * Frames that only touch don't collide, and if they are already colliding at the
+         * start, nothing is found.
+         * @param o The other frame
+         * @param motion How much this frame is moved
+         * @param time When they start colliding, as a fraction of the motion from 0 to 1
+         * @param face The face of this frame that touches the other one
+         * @return `true` if they start colliding during the motion
+         **/
+        bool sweep(const Frame &o, const glm::vec2 &motion, float &time, CollisionFace &face) const {
+            const float inf = std::numeric_limits<float>::infinity();
+            float entry[2], exit[2];
+            for(int a = 0; a < 2; a++) {
+                const float start = pos[a], end = pos[a] + size[a];
+                const float oStart = o.pos[a], oEnd = o.pos[a] + o.size[a];
+                if(motion[a] > 0.0f) {
+                    entry[a] = (oStart - end) / motion[a];
+                    exit[a] = (oEnd - start) / motion[a];
+                } else if(motion[a] < 0.0f) {
+                    entry[a] = (oEnd - start) / motion[a];
+                    exit[a] = (oStart - end) / motion[a];
+                } else if(start < oEnd && end > oStart) {
+                    entry[a] = -inf;
+                    exit[a] = inf;
+                } else {
+                    return false;
+                }
+            }
+
+            const float tEntry = glm::max(entry[0], entry[1]);
+            const float tExit = glm::min(exit[0], exit[1]);
+            if(tEntry >= tExit || tEntry < 0.0f || tEntry > 1.0f) return false;
+
+            time = tEntry;
+            if(entry[0] > entry[1]) face = motion.x > 0.0f ? RIGHT : LEFT;
+            else face = motion.y > 0.0f ? BOTTOM : TOP;
+            return true;
+        }
+
         /// Check if a point is inside a Frame
         inline bool isInside(const glm::vec2 point) const {
             return pos.x <= point.x && point.x < pos.x + size.x && pos.y <= point.y && point.y < pos.y + size.y;
@@ -49,6 +49,10 @@ namespace retro {
     class UIObject;
     class Timer;
     class Image;
+    class AssetLoader;
+    class TextureAtlas;
+    class GlyphAtlas;
+    class FontCache;
 
     /// The game. Everything lies on it.
     /**
@@ -354,13 +358,19 @@ namespace retro {
         SDL_Renderer* renderer;
         std::string gamePath;
         TTF_Font* font = nullptr;
+        GlyphAtlas* glyphAtlas = nullptr;
         Optional<Palette> palette;
         bool quit = false;
         std::map<std::string, Level*> levels;
         Level* currentLevel = nullptr, *nextCurrentLevel = nullptr;
         float scaleFactor = 1.0f;
         class retro::Timer* timerPtr = nullptr;
+        AssetLoader* assetLoader = nullptr;
+        TextureAtlas* textureAtlas = nullptr;
+        FontCache* fontCache = nullptr;
         CanvasMode mode;
+        uint32_t wakeUpEvent = 0;
+        uint32_t wakeUpTicks = 0;
 
         void importPaletteFromGimp(const std::string &path);
         void importPaletteFromPhotoshop(const std::string &path);
@@ -368,6 +378,7 @@ namespace retro {
         void updateObjects(Timer&);
         void deletePendingObjects();
         void parseCommands();
+        void waitForEvents();
 
     protected:
         Logger &log;
@@ -394,6 +405,7 @@ namespace retro {
         inline void setPalette(const P &p) {
             static_assert(std::is_base_of<Palette, P>::value, "Type must extend from Palette");
             this->palette = p;
+            this->palette->build();
         }
         /// Import a palette from a file that is available inside the game path. Supports Photoshop palettes or Gimp palettes.
         void importPalette(const std::string &path);
@@ -420,11 +432,27 @@ namespace retro {
         /// Changes the current level to another one. Use correct names, or your game will crash.
         void changeLevel(const char* name);
 
+        /// Starts loading in background the assets of a level, calling its Level::preload().
+        /**
+         * Call it some time before changeLevel() (for example, when a fade out starts) so
+         * the transition to the next level doesn't block the game while loading everything.
+         **/
+        void preloadLevel(const char* name);
+
         /// Starts the game itself: initializes some stuff and starts the game loop.
         void loop();
         /// Tells the game to stop the loop.
         void end();
 
+        /// Wakes up the game loop if the current Level is sleeping (see Level::renderOnDemand()).
+        /**
+         * With `seconds` being 0, the loop runs again as soon as possible. This can be called
+         * from any thread. With a bigger value, the loop will run again after that time, if
+         * nothing wakes it up before; this one must be called from the game loop.
+         * @param seconds Time from now when the loop must run again
+         **/
+        void requestFrame(float seconds = 0);
+
         /// Opens a read stream to a file
         /**
          * Opens a file to be read, either in the current locale encoding (UTF-8 by default) or
@@ -470,6 +498,12 @@ namespace retro {
         /// won't have any effect (no surprise exceptions this case).
         Audio& getAudio() { return audio; }
 
+        /// Gets the reference to the asset loader, to load assets in background.
+        AssetLoader& getAssetLoader();
+
+        /// Gets the texture atlas where small images are packed together.
+        TextureAtlas& getTextureAtlas();
+
         /// Enable capturing the mouse inside the window.
         void captureMouse(bool capture);
 
@@ -507,6 +541,7 @@ namespace retro {
         friend Sprites;
         friend UIObject;
         friend Image;
+        friend AssetLoader;
 
     };
 
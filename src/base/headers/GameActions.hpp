@@ -69,7 +69,7 @@ namespace retro {
         void print(const std::string &str, const glm::vec2 &pos);
         /// Shows a text in a position using a colour from the palette.
         void print(const std::string &str, const glm::vec2 &pos, size_t color);
-        /// Shows a text in a position using a RGBA colour.
+        /// Shows a text in a position using a RGBA colour. Glyphs are rendered once and reused, so changing text is cheap.
         void print(const std::string &str, const glm::vec2 &pos, const Color &color);
         /// Calculates the size of the text shown in the screen.
         glm::ivec2 sizeOfText(const std::string &str);
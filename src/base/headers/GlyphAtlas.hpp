@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <glm/vec2.hpp>
+#include <Color.hpp>
+#include <TextureAtlas.hpp>
+
+typedef struct _TTF_Font TTF_Font;
+
+namespace retro {
+
+    /// Draws text using glyphs rasterised only once.
+    /**
+     * Every glyph of a font is rendered in white the first time it appears, and it is
+     * stored in a TextureAtlas. Then, a text is drawn as a sequence of copies of these
+     * glyphs, colouring them through the texture colour modulation. Drawing text that
+     * changes every frame (scores, timers, dialogs...) doesn't allocate anything nor
+     * uploads new textures.
+     *
+     * Only characters of the Basic Multilingual Plane can be drawn this way (that's what
+     * SDL_ttf supports for glyphs). Check a string with canDraw() before using it.
+     **/
+    class GlyphAtlas {
+
+        struct Glyph {
+            TextureAtlas::Region region;
+            int advance;
+            bool hasPixels;
+        };
+
+        TTF_Font* font;
+        SDL_Renderer* renderer;
+        TextureAtlas atlas;
+        Glyph ascii[128];
+        bool asciiLoaded[128] = { false };
+        std::unordered_map<uint16_t, Glyph> glyphs;
+        int height;
+
+        Glyph load(uint16_t ch);
+        const Glyph& glyph(uint16_t ch);
+
+    public:
+
+        /// Creates an empty atlas for the font. The font must live while the atlas is alive.
+        GlyphAtlas(TTF_Font* font, SDL_Renderer* renderer);
+        GlyphAtlas(const GlyphAtlas &) = delete;
+
+        /// Checks if the string is valid UTF-8 and all characters can be drawn from the atlas.
+        static bool canDraw(const std::string &str);
+
+        /// Gets the size (in pixels) of the string once drawn.
+        glm::ivec2 sizeOf(const std::string &str);
+        /// Draws the string with its top-left corner at `pos` (in renderer pixels).
+        void draw(const std::string &str, const glm::ivec2 &pos, const Color &color);
+
+    };
+
+}
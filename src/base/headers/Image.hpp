@@ -46,6 +46,10 @@ namespace retro {
      * three methods, the position is not checked, so invalid positions could lead into
      * undefined behaviour and even to crash the game.
      *
+     * Small images (like HUD icons) can be packed into the game's TextureAtlas instead
+     * of having its own texture. Enable it with enableAtlas() before calling regenerate()
+     * or generateAndDestroy(). Images with linear sampling enabled are never packed.
+     *
      * @see https://github.com/nothings/stb/blob/master/stb_image.h stb_image.h
      */
     class Image {
@@ -55,6 +59,8 @@ namespace retro {
         void* texture = nullptr;
         size_t width, height;
         bool linear = false, doNotFree = false;
+        bool atlas = false, inAtlas = false;
+        glm::uvec2 atlasPos;
         std::atomic_size_t& references;
 
     public:
@@ -147,6 +153,12 @@ namespace retro {
         constexpr void enableLinearSampling(bool linear) { this->linear = linear; }
         /// Check if linear sampling is activated
         constexpr bool isLinearSamplingEnabled() { return linear; }
+        /// Enables or disables packing the image into the game's TextureAtlas. Takes effect in the next regenerate().
+        constexpr void enableAtlas(bool atlas) { this->atlas = atlas; }
+        /// Check if the image will be packed into the game's TextureAtlas
+        constexpr bool isAtlasEnabled() { return atlas; }
+        /// Check if the texture of the image is a region of the game's TextureAtlas
+        constexpr bool isInAtlas() { return inAtlas; }
 
         /// Generate the GPU texture and frees any resources (cannot modify or get pixels)
         /**
@@ -7,6 +7,9 @@
 #include <ControlledPlayer.hpp>
 #include <GameActions.hpp>
 #include <UIObject.hpp>
+#include <AssetLoader.hpp>
+#include <Tweens.hpp>
+#include <TriggerIndex.hpp>
 #include <algorithm>
 #include "json.hpp"
 
@@ -39,6 +42,7 @@ namespace retro {
      *  - update()
      *  - draw()
      *  - **optional** predraw()
+     *  - **optional** renderOnDemand()
      *  - **optional** cleanup() (must call Level::cleanup() always to avoid memory leaks)
      *
      * Also, the Level provides some event listeners that you can easily catch up by overriding
@@ -93,6 +97,8 @@ namespace retro {
         friend class GameActions;
         friend class UIObject;
         friend class Image;
+        friend class CollisionDetection;
+        friend class UILayer;
         
         friend void to_json(json &j, const Level &level);
         friend void from_json(const json &j, Level &level);
@@ -103,8 +109,11 @@ namespace retro {
         GameActions ga; ///< GameAction
         Logger &log; ///< A Logger, to log things.
         Game::Audio &audio; ///< Audio object, to make audio things
+        AssetLoader &assets; ///< Asset loader, to load things in background
+        Tweens tweens; ///< Tweens of the level, updated before the objects
+        TriggerIndex triggers; ///< CollisionDetection triggers of the level, checked after the objects
 
-        Level(Game &game, const char* name): g(game), name(name), ga(game, *this), log(Logger::getLogger(name)), audio(game.audio) {
+        Level(Game &game, const char* name): g(game), name(name), ga(game, *this), log(Logger::getLogger(name)), audio(game.audio), assets(game.getAssetLoader()) {
             log.debug("Created level");
         }
 
@@ -160,6 +169,13 @@ namespace retro {
         /// When the window has been resized
         virtual void windowResized(const glm::ivec2 &newSize, const glm::ivec2 &oldSize) {}
 
+        /// Preload method. Called before setup(), or before when Game::preloadLevel() is used.
+        /**
+         * Enqueue here the assets that setup() will need, using {@link #assets}. The assets
+         * are loaded in background, and setup() won't be called until all of them are ready.
+         * Don't create objects here, this level could still not be in the scene.
+         **/
+        virtual void preload() {}
         /// Setup method. Called everytime a Level enters in the scene.
         virtual void setup() = 0;
         /// Update method, done before any object's update. If return `false`, no object will be updated.
@@ -169,11 +185,23 @@ namespace retro {
         /// If this method returns false, the method draw() is not called in this frame.
         /// You can use this method to draw things before {@link Object}s are drawn.
         virtual bool predraw() { return true; }
+        /// If this method returns true, the Game sleeps while nothing happens in the Level.
+        /**
+         * After a frame where predraw() returned `false`, no tweens are running and the UI
+         * objects haven't changed, the game loop waits for an input event instead of running
+         * again. Good for tools and menus that only change when the user does something.
+         *
+         * While the loop is sleeping, update() is not called and the Timer is paused. If
+         * something must change after some time (a notification that hides, a blinking
+         * cursor...), call Game::requestFrame() with that time.
+         **/
+        virtual bool renderOnDemand() { return false; }
         /// Draw method. Where everything else (like the HUD) is be drawn.
         /// Draws over all {@link Object}s.
         virtual void draw() = 0;
         /// Cleanup method. Called when the Level won't be used anymore.
         virtual void cleanup() {
+            tweens.clear();
             for(Object* obj: objects) delete obj;
             for(UIObject* obj: uiObjects) delete obj;
         }
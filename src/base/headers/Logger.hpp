@@ -1,8 +1,32 @@
 #pragma once
 
-#include <iostream>
+#include <stdint.h>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
 #include <string>
-#include <map>
+
+/// Maximum level of the messages compiled in (0 error, 1 warning, 2 info, 3 debug)
+/**
+ * The `RETRO_LOG_*` macros of a level above this one are removed by the compiler. The
+ * engine drops the messages above the level it was built with, whatever the level of the
+ * code that logs them, so the game and the engine can be built with different levels.
+ * By default, debug builds keep everything and release builds keep up to info messages.
+ * Define it before building to change it.
+ *
+ * Logger::setLogLevel() cannot bring back what is compiled out: with a release build of
+ * the engine, setting the level to Debug shows nothing more than Info (a warning is printed
+ * when that happens). Build with `-DRETRO_LOG_LEVEL=3` to be able to enable debug messages
+ * at runtime.
+ **/
+#ifndef RETRO_LOG_LEVEL
+#ifndef NDEBUG
+#define RETRO_LOG_LEVEL 3
+#else
+#define RETRO_LOG_LEVEL 2
+#endif
+#endif
 
 namespace retro {
 
@@ -10,34 +34,122 @@ namespace retro {
     /**
      *  Utility class to make some nice logs. Manages
      *  unique instances of named loggers.
+     *
+     *  Logging doesn't write anything in the thread that logs: the message is formatted
+     *  into a slot of a lock-free ring buffer, together with its level, the time and the id
+     *  of the logger, and a background thread takes them out and writes them into the
+     *  sinks. The time is formatted in that thread too. If the buffer is full, the message
+     *  is discarded and the number of discarded messages is written later.
+     *
+     *  By default, messages are written into the standard output. Other sinks can be
+     *  added with addSink():
+     *
+     *  ```
+     *  Logger::addSink(std::unique_ptr<Logger::Sink>(new Logger::JsonSink("log.json")));
+     *  ```
+     *
+     *  Messages are written in the same order they were logged by one thread, but messages
+     *  from different threads may be interleaved in any order.
      **/
     class Logger {
     public:
-        
+
         enum LogLevel { Error, Warning, Info, Debug };
-        
+
+        /// A message ready to be written into a Sink
+        struct Record {
+            LogLevel level;           ///< Level of the message
+            int64_t time;             ///< Time when the message was logged, in nanoseconds since the epoch
+            uint32_t logger;          ///< Id of the logger, unique in the execution
+            const std::string &name;  ///< Name of the logger
+            const char* message;      ///< The message already formatted
+            size_t length;            ///< Length of the message
+        };
+
+        /// Something where the log is written. The methods are called from the logger thread.
+        class Sink {
+        public:
+            virtual ~Sink() {}
+            /// Writes a message
+            virtual void write(const Record &record) = 0;
+            /// Called when no more messages are ready to write, for now
+            virtual void flush() {}
+        };
+
+        /// Writes messages as text lines (the default sink writes into the standard output)
+        class TextSink: public Sink {
+            FILE* file;
+            bool owned;
+            int64_t lastSecond = -1;
+            char timeStr[80];
+        public:
+            /// Writes into a file already opened (not closed by the sink)
+            TextSink(FILE* file = stdout);
+            /// Creates (or truncates) the file to write into
+            TextSink(const std::string &path);
+            virtual ~TextSink();
+            virtual void write(const Record &record) override;
+            virtual void flush() override;
+        };
+
+        /// Writes one JSON object per line: `{"time":...,"level":"...","logger":"...","message":"..."}`
+        /**
+         * The time is in nanoseconds since the epoch. It is easier to filter and process
+         * this log with tools than the text one.
+         **/
+        class JsonSink: public Sink {
+            FILE* file;
+            std::string line;
+        public:
+            /// Creates (or truncates) the file to write into
+            JsonSink(const std::string &path);
+            virtual ~JsonSink();
+            virtual void write(const Record &record) override;
+            virtual void flush() override;
+        };
+
+        /// Writes the records as they are, in binary, with the endianness of the machine
+        /**
+         * The file starts with `RLOG` and a `uint32_t` version (1). Then there are entries,
+         * starting with a byte with its kind:
+         *
+         *  - `0` a logger: `uint32_t` id, `uint16_t` length of the name and the name. Appears before
+         *    the first message of this logger.
+         *  - `1` a message: `uint8_t` level, `int64_t` time, `uint32_t` id of the logger,
+         *    `uint32_t` length of the message and the message.
+         **/
+        class BinarySink: public Sink {
+            FILE* file;
+            std::unique_ptr<bool[]> known;
+            size_t knownSize = 0;
+        public:
+            /// Creates (or truncates) the file to write into
+            BinarySink(const std::string &path);
+            virtual ~BinarySink();
+            virtual void write(const Record &record) override;
+            virtual void flush() override;
+        };
+
     private:
-        
-        static std::map<std::string, Logger> loggers;
+
         static LogLevel logLevel;
-        std::string name;
-        
+        uint32_t id;
+
         static const char* logLevelToString(LogLevel);
-        
-        void printTime();
+
         void print(LogLevel level, const char* msg, va_list args);
-        
-        Logger(const std::string &name);
+
+        Logger(uint32_t id);
     public:
         Logger();
         Logger(const Logger &l);
-        
+
 #ifndef _WIN32
 #define attrPrintf __attribute__((format(printf, 2, 3)))
 #else
 #define attrPrintf //TODO
 #endif
-        
+
         /**
          *  Prints an error message to the log. Uses a printf-like
          *  sintax to format the string.
@@ -46,7 +158,7 @@ namespace retro {
          **/
         attrPrintf
         void error(const char* msg, ...);
-        
+
         /**
          *  Prints a warning message to the log. Uses a printf-like
          *  sintax to format the string.
@@ -55,7 +167,7 @@ namespace retro {
          **/
         attrPrintf
         void warn(const char* msg, ...);
-        
+
         /**
          *  Prints an informational message to the log. Uses a printf-like
          *  sintax to format the string.
@@ -64,7 +176,7 @@ namespace retro {
          **/
         attrPrintf
         void info(const char* msg, ...);
-        
+
         /**
          *  Prints a debug message to the log. Uses a printf-like
          *  sintax to format the string.
@@ -73,21 +185,109 @@ namespace retro {
          **/
         attrPrintf
         void debug(const char* msg, ...);
-        
+
 #undef attrPrintf
-        
+
+        /**
+         *  Prints a message of any level to the log. Uses a printf-like
+         *  sintax to format the string. Used by the `RETRO_LOG_*` macros.
+         *  @param level The level of the message
+         *  @param msg The formatted message
+         *  @param ... The arguments for the formatted string
+         **/
+#ifndef _WIN32
+        __attribute__((format(printf, 3, 4)))
+#endif
+        void log(LogLevel level, const char* msg, ...);
+
+        /// Returns `true` if a message of this level will be written. The RETRO_LOG_LEVEL of
+        /// the engine is already applied to the level set with setLogLevel().
+        static inline bool isEnabled(LogLevel level) {
+#ifndef __ANDROID__
+            return level <= logLevel;
+#else
+            return true;
+#endif
+        }
+
+        /// Limits how many times a message is logged per second. Used by RETRO_LOG_LIMITED().
+        class RateLimit {
+            std::atomic<int64_t> windowStart { 0 };
+            std::atomic<uint32_t> count { 0 };
+            std::atomic<uint32_t> skipped { 0 };
+            const uint32_t perSecond;
+        public:
+            RateLimit(uint32_t perSecond): perSecond(perSecond) {}
+            /// Returns `true` if the message can be logged now, and in `skippedBefore` the ones discarded before
+            bool allow(uint32_t &skippedBefore);
+        };
+
+        /// Gets the name of the logger
+        const std::string& getName() const;
+
         /**
          *  Gets the unique logger for that name (usually a class)
          *  @param name Name of the logger, or name of the class for the logger
          *  @return A reference to the Logger
          **/
         static Logger& getLogger(const std::string &name);
-        
+
         /**
-         *  Sets the global level for the logging
+         *  Sets the global level for the logging. Levels above the RETRO_LOG_LEVEL of the
+         *  engine stay disabled, because their messages are not compiled in.
          *  @param level LogLevel
          **/
         static void setLogLevel(LogLevel level);
+
+        /**
+         *  Adds a sink where the messages will be written, besides the others
+         *  @param sink The Sink
+         **/
+        static void addSink(std::unique_ptr<Sink> sink);
+
+        /// Removes all sinks, including the default one. Messages will be discarded until a sink is added.
+        static void clearSinks();
+
+        /// Waits until all messages logged until now are written
+        static void flush();
     };
 
 }
+
+/**
+ * Logs a message if its level is enabled. The arguments are not evaluated when it is not,
+ * and the whole call is removed by the compiler when the level is above RETRO_LOG_LEVEL.
+ * Use it for messages with arguments that cost something to get:
+ *
+ * ```
+ * RETRO_LOG_DEBUG(log, "Received command '%s' with argument '%s'", cmd.c_str(), value.dump().c_str());
+ * ```
+ **/
+#define RETRO_LOG(logger, level, ...) do { \
+    if((level) <= RETRO_LOG_LEVEL && ::retro::Logger::isEnabled(level)) (logger).log((level), __VA_ARGS__); \
+} while(0)
+
+#define RETRO_LOG_ERROR(logger, ...) RETRO_LOG(logger, ::retro::Logger::Error, __VA_ARGS__)
+#define RETRO_LOG_WARN(logger, ...) RETRO_LOG(logger, ::retro::Logger::Warning, __VA_ARGS__)
+#define RETRO_LOG_INFO(logger, ...) RETRO_LOG(logger, ::retro::Logger::Info, __VA_ARGS__)
+#define RETRO_LOG_DEBUG(logger, ...) RETRO_LOG(logger, ::retro::Logger::Debug, __VA_ARGS__)
+
+/**
+ * Like RETRO_LOG(), but this call (this line of code) logs at most `perSecond` messages
+ * every second. The rest are discarded and, when it logs again, tells how many
+ * were discarded. Useful for messages inside the game loop.
+ *
+ * ```
+ * RETRO_LOG_LIMITED(log, Logger::Debug, 2, "Window must be redrawn");
+ * ```
+ **/
+#define RETRO_LOG_LIMITED(logger, level, perSecond, ...) do { \
+    if((level) <= RETRO_LOG_LEVEL && ::retro::Logger::isEnabled(level)) { \
+        static ::retro::Logger::RateLimit retroRateLimit_(perSecond); \
+        uint32_t retroSkipped_; \
+        if(retroRateLimit_.allow(retroSkipped_)) { \
+            if(retroSkipped_ > 0) (logger).log((level), "(%u similar messages were discarded)", retroSkipped_); \
+            (logger).log((level), __VA_ARGS__); \
+        } \
+    } \
+} while(0)
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <atomic>
 #include <string>
+#include <vector>
 #include <Frame.hpp>
 #include <Sprites.hpp>
 
@@ -14,23 +15,56 @@ namespace retro {
     class Game;
     class Palette;
 
+    /// A layer of a Map.
+    struct MapLayer {
+        uint16_t* cells = nullptr;          ///< Cells of the layer, row after row. 0 is transparent and the rest is the `sprite index+1`.
+        glm::vec2 parallax = { 1, 1 };      ///< How much the layer moves with the camera: 1 moves like the map, 0.5 at half the speed (backgrounds) and 0 doesn't move.
+        bool visible = true;                ///< Hidden layers are not drawn, but they still collide.
+        uint32_t collisionMask = 1;         ///< Groups of collision of the layer, see MapObject::isSolid(). 0 never collides.
+    };
+
     /// A map file, but as a C++ object.
     /**
      * A map is just numbers and a reference to a `.spr` file (a Sprites file).
      * Stores only cells of 8x8 canvas pixels, and every cell references a sprite
-     * of that file. Can only reference up to 256 sprites.
+     * of that file. Cells are 16 bit, so a map can reference up to 65535 sprites.
+     *
+     * A map has one or more layers (up to 64) of the same size, drawn one over the other.
+     * Every layer has its own parallax, visibility and collision mask (see MapLayer).
+     * at() without a layer and the other methods work with the first layer.
+     *
+     * The map is drawn in chunks of 16x16 cells, only the chunks inside the screen get a
+     * texture, and consecutive visible layers with the same parallax share the same chunk
+     * textures. So a big map, or one with many layers, doesn't need a texture for the whole
+     * map per layer, and a layer costs no draw calls if it is merged with the one below.
+     *
+     * The `.map` file is saved compressed with a header (see TileFile), legacy files are
+     * still read.
      **/
     class Map {
 
+        struct Chunk {
+            uint64_t layers;        //Bitmask of the layers composed into the chunk
+            glm::uvec2 pos;         //In chunks
+            SDL_Texture* texture;
+            uint64_t lastUsed;
+            bool dirty;
+        };
+
         Game &game;
-        uint8_t* &data;
+        std::vector<MapLayer> &layers;
         glm::uvec2 size;
         std::string path;
         Sprites* sprites;
-        uint32_t* pixels;
-        SDL_Surface* surface;
-        SDL_Texture* texture;
+        std::vector<Chunk> &chunks;
+        uint64_t &frameCount;
+        bool texturesReady = false;
         std::atomic_size_t& references;
+        std::atomic<uint32_t>& version;
+
+        Chunk& chunk(uint64_t layerMask, const glm::uvec2 &pos);
+        void compose(Chunk &chunk);
+        void invalidateChunks(const glm::uvec2 &start, const glm::uvec2 &end);
 
     public:
 
@@ -45,24 +79,67 @@ namespace retro {
 
         /// Returns the size of the map (not in pixels, in map cells).
         inline const glm::uvec2 getSize() const { return size; }
-        /// Returns a reference of the sprite value (from the memory) located in a map cell. 0 is for transparent sprite and the rest is the `sprite index+1`.
-        uint8_t& at(size_t x, size_t y);
-        /// Returns the sprite value located in a map cell.
-        constexpr const uint8_t& at(size_t x, size_t y) const { return data[y * size.x + x]; }
-        /// Returns the sprite value located in a map cell.
-        constexpr const uint8_t& at(const glm::ivec2 &pos) const { return at(pos.x, pos.y); }
+        /// Returns a reference of the sprite value (from the memory) located in a map cell of the first layer. 0 is for transparent sprite and the rest is the `sprite index+1`.
+        /// The cell is considered modified, see getVersion(). To read a cell use the `const` overload, and to change one prefer set().
+        uint16_t& at(size_t x, size_t y);
+        /// Returns a reference of the sprite value located in a map cell of a layer. The cell is considered modified, see getVersion().
+        uint16_t& at(size_t x, size_t y, size_t layer);
+        /// Changes the sprite value of a map cell of the first layer. The map is only considered modified if the value is different.
+        inline void set(size_t x, size_t y, uint16_t sprite) { set(x, y, 0, sprite); }
+        /// Changes the sprite value of a map cell of a layer. The map is only considered modified if the value is different.
+        void set(size_t x, size_t y, size_t layer, uint16_t sprite);
+        /// Returns the sprite value located in a map cell of the first layer.
+        inline const uint16_t& at(size_t x, size_t y) const { return layers[0].cells[y * size.x + x]; }
+        /// Returns the sprite value located in a map cell of a layer.
+        inline const uint16_t& at(size_t x, size_t y, size_t layer) const { return layers[layer].cells[y * size.x + x]; }
+        /// Returns the sprite value located in a map cell of the first layer.
+        inline const uint16_t& at(const glm::ivec2 &pos) const { return at(pos.x, pos.y); }
+        /// Gets a rectangle of map cells of a layer, clipped to the bounds of the map, to change many of them at once.
+        /// The cells are considered modified, see getVersion().
+        MapRegion region(const Frame &cells, size_t layer = 0);
+        /// Returns the number of layers of the map, at least 1.
+        inline size_t getLayerCount() const { return layers.size(); }
+        /// Gets a layer to change its properties or cells. The layer is considered modified, see getVersion().
+        MapLayer& layer(size_t n);
+        /// Gets a layer.
+        inline const MapLayer& layer(size_t n) const { return layers.at(n); }
+        /// Adds an empty layer over the others, that doesn't collide, and returns its index.
+        size_t addLayer(const glm::vec2 &parallax = { 1, 1 });
+        /// Removes a layer. The last layer of the map cannot be removed.
+        void removeLayer(size_t n);
         void resize(const glm::uvec2 &size);
+        /// Returns a number that changes every time the cells may have been modified (shared by all copies of the map).
+        inline uint32_t getVersion() const { return version.load(std::memory_order_relaxed); }
         /// Regenerates the textures to match the changes done in the map.
         void regenerateTextures();
+        /// Regenerates only the chunks that have the map cells inside `cells` (in map cells, not in pixels).
+        /// Faster than regenerateTextures() when a few cells change. The sprites must not have changed.
+        void regenerateTextures(const Frame &cells);
+        /// Regenerates the pixels of the sprites with the palette of the game, but not the textures.
+        /// Must be called from the main thread, the palette can be changed there at any time.
+        void regeneratePixels();
+        /// Regenerates the pixels of the sprites with a copy of the table of a palette (see
+        /// Palette::data()), but not the textures. Can be called from any thread, the chunks
+        /// are not touched until uploadTextures().
+        void regeneratePixels(const uint32_t* colors);
+        /// Uploads the regenerated pixels into textures. Must be called from the main thread.
+        /// The chunks are composed again when they appear in the screen.
+        void uploadTextures();
+        /// Returns true if the textures of the map have been generated.
+        inline bool hasTextures() const { return texturesReady; }
         /// Saves the changes done in the map.
         void save();
         /// Reloads the map from the `.map` file.
         void reload();
-        /// Draws the map inside a Frame (using canvas pixels, not map cells).
+        /// Draws the visible layers of the map inside a Frame (using canvas pixels, not map cells).
+        /// The layers are moved with the camera using their parallax.
         void draw(const Frame &frame);
         /// Get the Sprites object used in this map.
         const Sprites* getSprites() const;
 
+        /// Gets the map from the AssetLoader if it was preloaded, or loads it from the `.map` file.
+        static Map load(const std::string &path, Game &g);
+
         static Map createMap(const std::string &path, Game &g, const Sprites &sprites, const glm::uvec2 &initialSize = { 128, 32 });
 
     };
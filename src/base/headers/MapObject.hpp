@@ -2,60 +2,127 @@
 
 #include <Map.hpp>
 #include <Object.hpp>
+#include <bitset>
 #include <vector>
 
 namespace retro {
 
+    /// Result of MapObject::sweep()
+    struct MapHit {
+        float time;           ///< Fraction of the motion done before touching the cell, from 0 to 1
+        CollisionFace face;   ///< Face of the moving frame that touches the cell
+        glm::ivec2 cell;      ///< Map cell that was hit
+    };
+
     /// A map, but as an Object.
+    /**
+     * For collision detection, some sprites are considered invalid (solid): by default, only
+     * the transparent one (0). The map keeps one bit per cell and layer telling if it is solid,
+     * so checking a position is a lookup in those bitsets. The bitsets are rebuilt when the
+     * invalid sprites change or a cell of the map could have changed (through Map::set(), the
+     * non-`const` Map::at(), Map::layer() or Map::reload()).
+     *
+     * Only the layers whose MapLayer::collisionMask has some bit of the mask of the query
+     * collide. By default all groups are checked, and only the first layer has a group.
+     **/
     class MapObject: public Map, public Object {
 
-        std::vector<uint8_t> invalidSprites = { 0 };
+        std::bitset<65536> invalidSprites = 1;
+        mutable std::vector<std::vector<uint64_t>> solidCells;
+        mutable uint32_t solidVersion = 0;
+        mutable bool solidDirty = true;
+        uint32_t boundsVersion = 0;
+
+        void rebuildSolidCells() const;
+
+        inline const std::vector<std::vector<uint64_t>>& solid() const {
+            if(solidDirty || solidVersion != getVersion()) rebuildSolidCells();
+            return solidCells;
+        }
 
     public:
 
         /**
          * Loads a Map with functionality of an Object. Instead of the name, you must set the
-         * map. The name will be the file name.
+         * map. The name will be the file name. If the map was preloaded using the AssetLoader,
+         * the preloaded one will be used.
          **/
-        MapObject(Game &game, Level &level, const glm::vec2 &pos, const std::string &path): Map(path, game), Object(game, level, pos, path.substr(path.rfind('/') + 1, path.rfind('.'))) {}
+        MapObject(Game &game, Level &level, const glm::vec2 &pos, const std::string &path): Map(Map::load(path, game)), Object(game, level, pos, path.substr(path.rfind('/') + 1, path.rfind('.'))) {}
 
         virtual void setup() override {
-            regenerateTextures();
+            if(!hasTextures()) regenerateTextures();
             frame.size = Map::getSize() * 8u;
         }
 
-        virtual void update(float, GameActions &) override {}
+        virtual void update(float, GameActions &) override {
+            //The draw bounds depend on the parallax of the layers
+            if(boundsVersion != getVersion()) {
+                boundsVersion = getVersion();
+                invalidateDrawBounds();
+            }
+        }
 
         virtual void draw(GameActions&) override {
             Map::draw(frame);
         }
 
+        /// Layers with parallax are drawn away from the frame, then the map is always drawn.
+        virtual Frame getDrawBounds() const override {
+            for(size_t n = 0; n < getLayerCount(); n++) {
+                if(layer(n).parallax != glm::vec2(1, 1)) return {};
+            }
+            return getFrame();
+        }
+
         /// Sets the position of the map
         inline void setPosition(const glm::ivec2 &pos) {
             frame.pos = pos;
         }
 
         /// Updates the invalid sprite list with a new list of values. Invalid sprites are for collision detection.
-        inline void updateInvalidSprites(std::initializer_list<uint8_t> list) {
-            invalidSprites.clear();
-            invalidSprites.insert(invalidSprites.begin(), list);
+        inline void updateInvalidSprites(std::initializer_list<uint16_t> list) {
+            invalidSprites.reset();
+            for(uint16_t s: list) invalidSprites.set(s);
+            solidDirty = true;
         }
 
         /// Adds a new invalid sprite to the list. Invalid sprites are for collision detection.
-        inline void addInvalidSprites(uint8_t s) {
-            invalidSprites.push_back(s);
+        inline void addInvalidSprites(uint16_t s) {
+            invalidSprites.set(s);
+            solidDirty = true;
         }
 
-        /// Checks if this position is a valid position or its in a cell with an invalid sprite. If the position is outside the bounds of the map, it will return `true`.
-        inline bool validPosition(const glm::ivec2 &pos) {
-            glm::ivec2 mapPos = (pos - glm::ivec2(frame.pos)) / 8;
-            if(mapPos.x >= 0 && mapPos.y >= 0 && mapPos.x < int(getSize().x) && mapPos.y < int(getSize().y)) {
-                return std::find(invalidSprites.begin(), invalidSprites.end(), at(mapPos.x, mapPos.y)) == invalidSprites.end();
-            } else {
-                return true;
+        /// Checks if the cell has an invalid sprite in some layer that collides with `mask`. Cells outside the map are not solid.
+        inline bool isSolid(const glm::ivec2 &cell, uint32_t mask = ~uint32_t(0)) const {
+            if(cell.x < 0 || cell.y < 0 || cell.x >= int(getSize().x) || cell.y >= int(getSize().y)) return false;
+            size_t i = size_t(cell.y) * getSize().x + size_t(cell.x);
+            const auto &layers = solid();
+            for(size_t n = 0; n < layers.size(); n++) {
+                if((layer(n).collisionMask & mask) && ((layers[n][i / 64] >> (i % 64)) & 1)) return true;
             }
+            return false;
+        }
+
+        /// Checks if this position is a valid position or its in a cell with an invalid sprite (in the layers that collide with `mask`). If the position is outside the bounds of the map, it will return `true`.
+        inline bool validPosition(const glm::ivec2 &pos, uint32_t mask = ~uint32_t(0)) const {
+            glm::ivec2 p = pos - glm::ivec2(frame.pos);
+            //Rounding towards -inf, so positions just before the map are not taken as the first cell
+            return !isSolid({ p.x >= 0 ? p.x / 8 : -1, p.y >= 0 ? p.y / 8 : -1 }, mask);
         }
 
+        /**
+         * Moves the frame `box` by `motion` (both in canvas pixels) and finds the first solid
+         * cell it touches. Only the cells along the motion are checked, so fast objects
+         * cannot go through thin walls and corners are not missed. Cells that the frame
+         * already overlaps at the start are ignored, so an object inside a wall can get out.
+         * @param box The frame at the start of the motion
+         * @param motion How much the frame is moved
+         * @param hit If some cell is hit, where and when it happens
+         * @param mask Only the layers that collide with this mask are checked
+         * @return `true` if some solid cell is hit
+         **/
+        bool sweep(const Frame &box, const glm::vec2 &motion, MapHit &hit, uint32_t mask = ~uint32_t(0)) const;
+
     };
 
 }
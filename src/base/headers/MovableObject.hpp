@@ -1,6 +1,8 @@
 #pragma once
 
 #include <Object.hpp>
+#include <cmath>
+#include <glm/common.hpp>
 
 namespace retro {
 
@@ -25,16 +27,59 @@ namespace retro {
 
     public:
 
+        /// Maximum number of steps in which the motion is split by timeOfImpact()
+        static const int maxSubsteps = 16;
+
+        /// Returns how much the object moves in `delta` seconds, if nothing changes
+        inline glm::vec2 motion(float delta) const {
+            return speed * delta + acceleration * delta * delta / 2.0f;
+        }
+
         /// Returns a preview of where the Movable Object will be after the update process
         Frame nextFrame(float delta) const {
-            return { frame.pos + speed * delta + acceleration * delta * delta / 2.0f, frame.size };
+            return { frame.pos + motion(delta), frame.size };
+        }
+
+        /**
+         * Finds when this object starts colliding with the frame `other` during the next
+         * `delta` seconds, if `other` moves `otherMotion` in that time. If the object moves
+         * further than its size (relative to the other), the motion is split in shorter
+         * steps that follow the curve made by the acceleration, up to maxSubsteps.
+         * @param other The frame of the other object, at the start
+         * @param otherMotion How much the other object moves in `delta` seconds
+         * @param delta The time of the step, in seconds
+         * @param contact How much this object has moved when they touch
+         * @param face The face of this object that touches the other one
+         * @return `true` if they start colliding during the step
+         **/
+        bool timeOfImpact(const Frame &other, const glm::vec2 &otherMotion, float delta, glm::vec2 &contact, CollisionFace &face) const {
+            const glm::vec2 relative = motion(delta) - otherMotion;
+            const glm::vec2 ratio = glm::abs(relative) / glm::max(frame.size, glm::vec2(1.0f));
+            const int steps = glm::clamp(int(std::ceil(glm::max(ratio.x, ratio.y))), 1, maxSubsteps);
+
+            glm::vec2 prev = { 0, 0 }, prevOther = { 0, 0 };
+            for(int i = 1; i <= steps; i++) {
+                const float t = float(i) / float(steps);
+                const glm::vec2 cur = motion(delta * t);
+                const glm::vec2 curOther = otherMotion * t;
+                const Frame from = { frame.pos + prev, frame.size };
+                const Frame otherFrom = { other.pos + prevOther, other.size };
+                float time;
+                if(from.sweep(otherFrom, (cur - prev) - (curOther - prevOther), time, face)) {
+                    contact = prev + (cur - prev) * time;
+                    return true;
+                }
+                prev = cur;
+                prevOther = curOther;
+            }
+            return false;
         }
 
         virtual void update(float delta, GameActions&) override {
             instantSpeed = (frame.pos - oldPos) / (delta + lastDelta) * 2.0f;
             oldPos = frame.pos;
             lastDelta = delta;
-            frame.pos += speed * delta + acceleration * delta * delta / 2.0f;
+            frame.pos += motion(delta);
         }
 
         virtual void saveState(json &j) const override {
@@ -28,6 +28,9 @@ namespace retro {
     class Object {
 
         Game &g;
+        mutable Frame drawBounds;
+        mutable Frame drawBoundsFrame;
+        mutable bool drawBoundsValid = false;
 
     protected:
 
@@ -50,6 +53,9 @@ namespace retro {
             return (LevelType&) level;
         }
 
+        /// Tells that getDrawBounds() may return something else, when it depends on more than the frame.
+        inline void invalidateDrawBounds() { drawBoundsValid = false; }
+
     public:
 
         virtual void setup() = 0;
@@ -58,6 +64,24 @@ namespace retro {
 
         virtual Frame& getFrame() { return frame; }
         virtual const Frame& getFrame() const { return frame; }
+
+        /// Returns the area where the object draws things, by default its frame.
+        /**
+         * The Game doesn't call draw() when this area is outside the camera, so override it if
+         * the object draws outside its frame. If the area has no size, the object is always drawn.
+         * The Game keeps the area until the frame changes, call invalidateDrawBounds() if it
+         * depends on something else.
+         **/
+        virtual Frame getDrawBounds() const { return getFrame(); }
+        /// Returns getDrawBounds(), computed again only when the frame has changed or after invalidateDrawBounds().
+        inline const Frame& getCachedDrawBounds() const {
+            if(!drawBoundsValid || drawBoundsFrame != frame) {
+                drawBounds = getDrawBounds();
+                drawBoundsFrame = frame;
+                drawBoundsValid = true;
+            }
+            return drawBounds;
+        }
         const char* getName() const { return name.c_str(); }
 
         constexpr bool isDisabled() { return disabled; }
@@ -3,13 +3,28 @@
 #include <glm/vec4.hpp>
 #include <Platform.hpp>
 #include <cstring>
+#include <stdexcept>
+#include <string>
 #include <Color.hpp>
 #include "Optional.hpp"
 
 namespace retro {
 
     /// A palette of colours.
+    /**
+     * Besides the virtual methods, a palette keeps its colours in a table of 256 packed
+     * colours (`0xAABBGGRR`, the same format of the pixels of Image, Map and Sprites) and a
+     * bitmap that tells which ones exist. The table is filled once, with setColour() in the
+     * constructor of the implementation or with build() (called by Game::setPalette()), so
+     * getting a colour by index is one load: use has() and at(), or data() and toPixels()
+     * to convert many indices at once.
+     **/
     class Palette {
+
+        uint32_t colors[256] = { 0 };
+        uint64_t valid[4] = { 1, 0, 0, 0 };
+        bool built = false;
+
     protected:
 
         /// A colour from your implementation. From 1 to size - 1.
@@ -17,12 +32,42 @@ namespace retro {
         /// A colour from your implementation, by name.
         virtual Optional<Color> getColourByName(const char*) const = 0;
 
+        /// Stores the colour at the index in the table (0 is always transparent). Marks the table as built.
+        void setColour(size_t idx, const Color &color) {
+            if(idx == 0 || idx >= 256) return;
+            colors[idx] = pack(color);
+            valid[idx / 64] |= uint64_t(1) << (idx % 64);
+            built = true;
+        }
+
     public:
 
+        /// Packs a colour into `0xAABBGGRR`
+        static constexpr uint32_t pack(const Color &c) {
+            return uint32_t(c.a) << 24 | uint32_t(c.b) << 16 | uint32_t(c.g) << 8 | uint32_t(c.r);
+        }
+
+        /// Unpacks a colour from `0xAABBGGRR`
+        static constexpr Color unpack(uint32_t c) {
+            return { uint8_t(c), uint8_t(c >> 8), uint8_t(c >> 16), uint8_t(c >> 24) };
+        }
+
+        /// Fills the table with the colours from getColour(), if the implementation didn't fill it.
+        void build() {
+            if(built) return;
+            for(size_t i = 1; i < 256; i++) {
+                auto color = getColour(i);
+                if(color) setColour(i, *color);
+            }
+            built = true;
+        }
+
         /// Gets a colour by index, if exists.
         Optional<Color> operator[](size_t idx) const {
             if(idx == 0) return 0_rgba;
-            else return getColour(idx);
+            else if(!built) return getColour(idx);
+            else if(has(idx)) return at(idx);
+            else return {};
         }
 
         /// Gets a colour by name, if exists.
@@ -32,6 +77,41 @@ namespace retro {
             } else return getColourByName(name);
         }
 
+        /// `true` if the colour at this index exists in the table
+        inline bool has(size_t idx) const {
+            return idx < 256 && (valid[idx / 64] >> (idx % 64) & 1) != 0;
+        }
+
+        /// Gets the colour at the index from the table, without any check. Use has() before.
+        inline Color at(size_t idx) const {
+            return unpack(colors[idx]);
+        }
+
+        /// Gets the 256 colours of the table, packed as `0xAABBGGRR`. Colours that don't exist are 0.
+        inline const uint32_t* data() const {
+            return colors;
+        }
+
+        /// Converts `n` colour indices into pixels (packed colours), colours that don't exist become transparent.
+        inline void toPixels(const uint8_t* indices, uint32_t* pixels, size_t n) const {
+            toPixels(colors, indices, pixels, n);
+        }
+
+        /// Converts `n` colour indices into pixels using a table of 256 packed colours, like a copy of data().
+        static void toPixels(const uint32_t* colors, const uint8_t* indices, uint32_t* pixels, size_t n) {
+            //Four independent loads per iteration, the table is small enough to stay in the L1 cache
+            size_t i = 0;
+            for(; i + 4 <= n; i += 4) {
+                uint32_t p0 = colors[indices[i]], p1 = colors[indices[i + 1]];
+                uint32_t p2 = colors[indices[i + 2]], p3 = colors[indices[i + 3]];
+                pixels[i] = p0;
+                pixels[i + 1] = p1;
+                pixels[i + 2] = p2;
+                pixels[i + 3] = p3;
+            }
+            for(; i < n; i++) pixels[i] = colors[indices[i]];
+        }
+
         /// Gets the number of colours in total.
         virtual size_t size() const { return 1; }
         /// Gets the number of colours in total.
@@ -43,36 +123,78 @@ namespace retro {
     /// Implementation of Palette that reads a Gimp palette file.
     class GimpPalette: public Palette {
 
-        Optional<Color> colors[256];
         size_t len;
 
     protected:
 
         virtual Optional<Color> getColour(size_t idx) const override {
-            return this->colors[idx];
+            if(has(idx)) return at(idx);
+            return {};
         }
 
         virtual Optional<Color> getColourByName(const char*) const override {
             return {};
         }
 
-    public:
+    private:
+
+        static inline bool isBlank(char c) {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        static inline bool isDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        //Reads a number after some blanks, like `>>` but without building strings
+        static bool number(const char* &p, const char* end, uint32_t &num) {
+            while(p < end && isBlank(*p)) p++;
+            if(p == end || !isDigit(*p)) return false;
+            num = 0;
+            while(p < end && isDigit(*p)) num = num * 10 + uint32_t(*p++ - '0');
+            return true;
+        }
+
+        void parse(const char* data, size_t size) {
+            const char* p = data;
+            const char* end = data + size;
+            if(size < 12 || strncmp(data, "GIMP Palette", 12) != 0) {
+                throw std::runtime_error("The file is not a GIMP palette");
+            }
 
-        /// Reads from an input stream and creates the Palette from it.
-        GimpPalette(InputFile &i) {
-            i.seeki(13);
-            while(i.get() != '\n');
-            while(i.get() != '\n');
             size_t pos = 0;
-            while(!i.eof()) {
-                uint32_t r, g, b, a;
-                i >> r >> g >> b >> a;
-                if(a == pos) {
-                    this->colors[pos] = rgba(r, g, b, 255);
+            while(p < end) {
+                //Skip the rest of the line, the first time the header
+                const char* nl = static_cast<const char*>(memchr(p, '\n', size_t(end - p)));
+                p = nl != nullptr ? nl + 1 : end;
+                while(p < end && isBlank(*p)) p++;
+                if(p == end || !isDigit(*p)) continue; //Empty lines, comments, Name: and Columns:
+
+                //The name of the colour must be its position, or the colour is undefined
+                uint32_t r, g, b, index;
+                if(number(p, end, r) && number(p, end, g) && number(p, end, b)) {
+                    if(number(p, end, index) && index == pos && (p == end || isBlank(*p) || *p == '\n')) {
+                        setColour(pos, rgba(r, g, b, 255));
+                    }
+                    pos++;
                 }
-                pos++;
             }
-            this->len = pos - 1;
+            this->len = pos;
+        }
+
+    public:
+
+        /// Parses a palette already in memory (the contents of a `.gpl` file).
+        GimpPalette(const char* data, size_t size) {
+            parse(data, size);
+            build();
+        }
+
+        /// Reads from an input stream and creates the Palette from it.
+        GimpPalette(InputFile &i) {
+            auto data = i.readAll();
+            parse(reinterpret_cast<const char*>(data.data()), data.size());
+            build();
         }
 
         virtual size_t size() const override { return len; }
@@ -84,51 +206,53 @@ namespace retro {
     /// Implementation of Palette that reads a Photoshop palette file.
     class PhotoshopPalette: public Palette {
 
-        Optional<Color> colors[256];
         size_t len;
 
-        inline uint16_t rword(InputFile &i) {
-            uint8_t a, b;
-            i.read<uint8_t>(&a, 1);
-            i.read<uint8_t>(&b, 1);
-            return uint16_t(uint16_t(a) << 8) | b;
+        static inline uint16_t rword(const uint8_t* &p, const uint8_t* end) {
+            if(end - p < 2) throw std::runtime_error("The Photoshop palette is truncated");
+            uint16_t word = uint16_t(uint16_t(p[0]) << 8 | p[1]);
+            p += 2;
+            return word;
         }
 
-        inline Optional<Color> readColor(InputFile &i, uint16_t ver) {
-            uint16_t colorSpace = rword(i);
+        static Optional<Color> readColor(const uint8_t* &p, const uint8_t* end, uint16_t ver) {
+            uint16_t colorSpace = rword(p, end);
+            uint16_t w = rword(p, end), x = rword(p, end), y = rword(p, end);
+            rword(p, end);
             Optional<Color> color;
             if(colorSpace == 0) {
-                color = Color {
-                    rword(i) / 256,
-                    rword(i) / 256,
-                    rword(i) / 256,
-                    0xFF
-                };
-                rword(i);
+                color = Color { w / 256, x / 256, y / 256, 0xFF };
             } else if(colorSpace == 1) {
-                color = HSBtoRGB({
-                    rword(i) / 182.04f,
-                    rword(i) / 655.35f,
-                    rword(i) / 655.35f,
-                    0xFF
-                });
-                rword(i);
+                color = HSBtoRGB({ w / 182.04f, x / 655.35f, y / 655.35f, 0xFF });
             }
 
             if(ver == 2) {
-                rword(i);
-                uint16_t skip = rword(i);
-                i.seeki(skip);
-                rword(i);
+                //A zero and the name as UTF-16, its length (with the ending null) in characters
+                rword(p, end);
+                size_t skip = size_t(rword(p, end)) * 2;
+                if(size_t(end - p) < skip) throw std::runtime_error("The Photoshop palette is truncated");
+                p += skip;
             }
 
             return color;
         }
 
+        void parse(const uint8_t* data, size_t size) {
+            const uint8_t* p = data;
+            const uint8_t* end = data + size;
+            uint16_t ver = rword(p, end);
+            this->len = rword(p, end);
+            for(size_t pos = 0; pos < this->len; pos++) {
+                auto color = readColor(p, end, ver);
+                if(color) setColour(pos, *color);
+            }
+        }
+
     protected:
 
         virtual Optional<Color> getColour(size_t idx) const override {
-            return this->colors[idx];
+            if(has(idx)) return at(idx);
+            return {};
         }
 
         virtual Optional<Color> getColourByName(const char*) const override {
@@ -137,13 +261,17 @@ namespace retro {
 
     public:
 
+        /// Parses a palette already in memory (the contents of an `.aco` file).
+        PhotoshopPalette(const uint8_t* data, size_t size) {
+            parse(data, size);
+            build();
+        }
+
         /// Reads from an input stream and creates a Palette from it.
         PhotoshopPalette(InputFile &i) {
-            uint16_t ver = rword(i);
-            this->len = rword(i);
-            for(size_t pos = 0; pos < this->len; pos++) {
-                this->colors[pos] = readColor(i, ver);
-            }
+            auto data = i.readAll();
+            parse(data.data(), data.size());
+            build();
         }
 
         virtual size_t size() const override { return len; }
@@ -72,6 +72,24 @@ namespace retro {
         return list;
     }
 
+    /// A view of some contiguous elements, that doesn't own them
+    template<typename T>
+    class Span {
+        T* ptr = nullptr;
+        size_t len = 0;
+    public:
+        constexpr Span() {}
+        constexpr Span(T* ptr, size_t len): ptr(ptr), len(len) {}
+        constexpr T* data() const { return ptr; }
+        constexpr size_t size() const { return len; }
+        constexpr bool empty() const { return len == 0; }
+        constexpr T* begin() const { return ptr; }
+        constexpr T* end() const { return ptr + len; }
+        constexpr T& operator[](size_t i) const { return ptr[i]; }
+        /// Gets a view of `count` elements starting at `offset`
+        constexpr Span<T> subspan(size_t offset, size_t count) const { return { ptr + offset, count }; }
+    };
+
     /// Allow you to open a file, but in fact, is an interface
     class BasicFile {
     public:
@@ -125,6 +143,7 @@ namespace retro {
     /// Class that allows you to read files
     class InputFile: public virtual BasicFile {
         virtual size_t read(void* buff, size_t n, size_t sizeOfCType);
+        std::vector<uint8_t> contents;
 
         template<typename T, typename lim = std::numeric_limits<T>>
         void conversion(const std::string &nstr, T &num, std::enable_if_t<lim::is_integer && !lim::is_signed>* = 0) {
@@ -238,16 +257,21 @@ namespace retro {
         virtual off_t telli();
         virtual ~InputFile();
 
+        /// Reads the rest of the file at once
+        /**
+         * The data is kept inside the InputFile, until the next call to readAll() or
+         * until the object is destroyed, and the returned Span points to it, so it can
+         * be parsed without copying it again. When the platform can tell the size of
+         * the file, the buffer is allocated once and filled with one read.
+         * @return A view of the data read, empty on failure or at the end of the file
+         */
+        Span<const uint8_t> readAll();
+
         //Extra read functions
         /// Reads the entire file as a std::string
         std::string read() {
-            std::stringstream ss;
-            char tmp[1024];
-            size_t size;
-            while((size = read(tmp, 1024)) != 0) {
-                ss.write(tmp, size);
-            }
-          return ss.str();
+            auto all = readAll();
+            return std::string(reinterpret_cast<const char*>(all.data()), all.size());
         }
 
         /// Read a line
@@ -438,6 +462,11 @@ namespace retro {
 
     struct Command { nlohmann::json data; void* _priv_data; };
     Optional<Command> getCommand();
+    /// Blocks until getCommand() has a command to read. Returns `false` when stopWaitingForCommands()
+    /// has been called or when the commands cannot be received (then it's not worth calling it again).
+    bool waitForCommand();
+    /// Makes waitForCommand() return `false`, the current call and the next ones. Can be called from any thread.
+    void stopWaitingForCommands();
     void sendCommandResponse(const Command &, const nlohmann::json &);
 
 #if defined(__APPLE__) && defined(__MACH__)
@@ -45,6 +45,33 @@ namespace retro {
             return dir;
         }
 
+        /**
+         * Checks whether this Player will collide with a Collisionable during the next `delta`
+         * seconds, even if they cross each other between two frames. If it will, the Player is
+         * moved until they touch, and stops moving in that direction. If they already collide,
+         * it works like checkCollision(const Collisionable&).
+         * @param c The other object
+         * @param otherMotion How much the other object moves in that time, if it moves
+         * @param delta The time of the next update, in seconds
+         **/
+        CollisionFace checkCollision(const Collisionable &c, const glm::vec2 &otherMotion, float delta) {
+            const Frame &other = c.getFrame();
+            //Broad phase: the areas covered by both objects during the step
+            if(!frame.swept(motion(delta)).collides(other.swept(otherMotion))) return NONE;
+            if(frame.collides(other)) return checkCollision(c);
+
+            glm::vec2 contact;
+            CollisionFace dir;
+            if(!timeOfImpact(other, otherMotion, delta, contact, dir)) return NONE;
+
+            if(dir & BOTTOM) { cannotMoveDown = true; cannotMoveDiff.y += contact.y; speed.y = 0; acceleration.y = 0; }
+            else if(dir & TOP) { cannotMoveUp = true; cannotMoveDiff.y += contact.y; speed.y = 0; acceleration.y = 0; }
+            else if(dir & LEFT) { cannotMoveLeft = true; cannotMoveDiff.x += contact.x; speed.x = 0; acceleration.x = 0; }
+            else if(dir & RIGHT) { cannotMoveRight = true; cannotMoveDiff.x += contact.x; speed.x = 0; acceleration.x = 0; }
+
+            return dir;
+        }
+
         /// Checks whether this Player collides with the map, and if it is, it will move the Player back to a non-colliding position. It won't check for the map bounds.
         virtual void collisionWithMap(CollisionFace c) {
             if(c & TOP) {
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace retro {
+
+    template<typename Signature, size_t Size = 4 * sizeof(void*)>
+    class SmallFunction;
+
+    /// A `std::function` that stores small callables inside itself
+    /**
+     * Works like [std::function](http://en.cppreference.com/w/cpp/utility/functional/function),
+     * but any callable that fits in `Size` bytes (by default, a lambda capturing up to four
+     * pointers) is stored inside the object, so creating, copying and calling it never
+     * allocates memory. Bigger callables are stored in the heap.
+     *
+     * Calling it is an indirect call to a function generated for the type of the callable,
+     * which calls it directly (the compiler can inline the lambda inside).
+     *
+     * ```
+     * SmallFunction<void(const float&)> setter = [this] (const float &f) { alpha = f; };
+     * if(setter) setter(0.5f);
+     * ```
+     **/
+    template<typename R, typename... Args, size_t Size>
+    class SmallFunction<R(Args...), Size> {
+
+        struct Ops {
+            R (*invoke)(void*, Args...);
+            void (*copy)(void*, const void*);
+            void (*move)(void*, void*);
+            void (*destroy)(void*);
+        };
+
+        template<class F>
+        struct InlineOps {
+            static R invoke(void* f, Args... args) { return (*static_cast<F*>(f))(std::forward<Args>(args)...); }
+            static void copy(void* dst, const void* src) { new(dst) F(*static_cast<const F*>(src)); }
+            static void move(void* dst, void* src) { new(dst) F(std::move(*static_cast<F*>(src))); }
+            static void destroy(void* f) { static_cast<F*>(f)->~F(); }
+            static constexpr Ops ops = { &invoke, &copy, &move, &destroy };
+        };
+
+        template<class F>
+        struct HeapOps {
+            static F*& ptr(void* f) { return *static_cast<F**>(f); }
+            static R invoke(void* f, Args... args) { return (*ptr(f))(std::forward<Args>(args)...); }
+            static void copy(void* dst, const void* src) { new(dst) F*(new F(**static_cast<F* const*>(src))); }
+            static void move(void* dst, void* src) { new(dst) F*(ptr(src)); ptr(src) = nullptr; }
+            static void destroy(void* f) { delete ptr(f); }
+            static constexpr Ops ops = { &invoke, &copy, &move, &destroy };
+        };
+
+        template<class F>
+        using fitsInside = std::integral_constant<bool, sizeof(F) <= Size && alignof(F) <= alignof(void*) && std::is_nothrow_move_constructible<F>::value>;
+
+        typename std::aligned_storage<Size, alignof(void*)>::type storage;
+        const Ops* ops = nullptr;
+
+        template<class F>
+        void store(F &&f, std::true_type) {
+            using Fn = typename std::decay<F>::type;
+            new(&storage) Fn(std::forward<F>(f));
+            ops = &InlineOps<Fn>::ops;
+        }
+
+        template<class F>
+        void store(F &&f, std::false_type) {
+            using Fn = typename std::decay<F>::type;
+            new(&storage) Fn*(new Fn(std::forward<F>(f)));
+            ops = &HeapOps<Fn>::ops;
+        }
+
+    public:
+
+        /// Creates an empty function
+        SmallFunction() {}
+        /// Creates an empty function
+        SmallFunction(std::nullptr_t) {}
+
+        /// Creates a function that stores the callable `f`
+        template<class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, SmallFunction>::value>::type>
+        SmallFunction(F &&f) {
+            store(std::forward<F>(f), fitsInside<typename std::decay<F>::type>());
+        }
+
+        SmallFunction(const SmallFunction &o): ops(o.ops) {
+            if(ops) ops->copy(&storage, &o.storage);
+        }
+
+        SmallFunction(SmallFunction &&o) noexcept: ops(o.ops) {
+            if(ops) {
+                ops->move(&storage, &o.storage);
+                ops->destroy(&o.storage);
+                o.ops = nullptr;
+            }
+        }
+
+        ~SmallFunction() {
+            if(ops) ops->destroy(&storage);
+        }
+
+        SmallFunction& operator=(const SmallFunction &o) {
+            //Copied before destroying the current callable, if the copy throws nothing changes
+            if(this != &o) *this = SmallFunction(o);
+            return *this;
+        }
+
+        SmallFunction& operator=(SmallFunction &&o) noexcept {
+            if(this != &o) {
+                this->~SmallFunction();
+                ops = o.ops;
+                if(ops) {
+                    ops->move(&storage, &o.storage);
+                    ops->destroy(&o.storage);
+                    o.ops = nullptr;
+                }
+            }
+            return *this;
+        }
+
+        /// Calls the stored callable. The function must not be empty.
+        R operator()(Args... args) const {
+            return ops->invoke(const_cast<void*>(static_cast<const void*>(&storage)), std::forward<Args>(args)...);
+        }
+
+        /// `true` if there's a callable stored
+        explicit operator bool() const { return ops != nullptr; }
+
+    };
+
+    template<typename R, typename... Args, size_t Size>
+    template<class F>
+    constexpr typename SmallFunction<R(Args...), Size>::Ops SmallFunction<R(Args...), Size>::InlineOps<F>::ops;
+
+    template<typename R, typename... Args, size_t Size>
+    template<class F>
+    constexpr typename SmallFunction<R(Args...), Size>::Ops SmallFunction<R(Args...), Size>::HeapOps<F>::ops;
+
+}
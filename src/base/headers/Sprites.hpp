@@ -4,6 +4,7 @@
 #include <atomic>
 #include <stdexcept>
 #include <Frame.hpp>
+#include <TileRegion.hpp>
 
 struct SDL_Surface;
 struct SDL_Texture;
@@ -58,6 +59,8 @@ namespace retro {
         void draw_thicc(const Frame &frame) const;
         /// Gets the Frame of the Sprite.
         Frame frame() const;
+        /// Gets the pixels of the Sprite, to change many of them at once.
+        TileRegion region() const;
     };
 
     /// A sprites file, but as a C++ object.
@@ -65,6 +68,9 @@ namespace retro {
      * A Sprites file (`.spr`) is a file that contains 16 sprites in a row, and multiple rows.
      * A sprite is a 8x8 pixels where every pixel refers to an index of a colour from
      * a Palette. Can only reference 256 colours.
+     *
+     * The `.spr` file is saved compressed with a header (see TileFile), legacy files are
+     * still read.
      **/
     class Sprites {
 
@@ -109,10 +115,24 @@ namespace retro {
         void reload();
         /// Regenerates the textures that will be used to draw the sprites.
         void regenerateTextures();
+        /// Regenerates only the part of the texture inside `region`, in pixels of the file
+        /// (16 sprites of 8 pixels per row). Faster than regenerateTextures() for small changes.
+        void regenerateTextures(const Frame &region);
+        /// Regenerates the pixels with the palette of the game, but not the textures.
+        /// Must be called from the main thread, the palette can be changed there at any time.
+        void regeneratePixels();
+        /// Regenerates the pixels with a copy of the table of a palette (see Palette::data()),
+        /// but not the textures. Can be called from any thread.
+        void regeneratePixels(const uint32_t* colors);
+        /// Uploads the regenerated pixels into textures. Must be called from the main thread.
+        void uploadTextures();
         /// Returns the number of sprites. Will be always multiple of 16.
         size_t size() const;
+        /// Gets a rectangle of pixels of the file (16 sprites of 8 pixels per row), clipped to the bounds of the file.
+        TileRegion region(const Frame &pixels) const;
         /// Loads a `.spr` from the game path, or creates a new one with 64 empty sprites.
-        void load(const std::string &path) throw();
+        /// @throws std::runtime_error If the file cannot be read or created, or is corrupt
+        void load(const std::string &path);
 
     };
 
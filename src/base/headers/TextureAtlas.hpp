@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <Optional.hpp>
+
+struct SDL_Renderer;
+struct SDL_Texture;
+struct SDL_Surface;
+
+namespace retro {
+
+    /// Packs many small images into a few big textures.
+    /**
+     * Every page of the atlas is a texture of a fixed size, and the images are placed
+     * inside using a _skyline_ bottom-left packer: the page keeps track of the top edge
+     * of the packed images, and a new image is placed where its bottom side will be the
+     * lowest. It is fast and wastes little space for images of similar heights, which is
+     * the usual case for HUD icons and sprites.
+     *
+     * Drawing images from the same page one after the other doesn't need to change the
+     * bound texture, so the renderer can batch these draws.
+     *
+     * A region that is not used anymore is given back with release(). The space is kept
+     * in a list of free rectangles of its page, and insert() looks there before going to
+     * the skyline: a free rectangle that fits is split in the part used and the two parts
+     * left (right and below). When every region of a page is released, the page is reset
+     * as if it was new. clear() frees everything at once.
+     **/
+    class TextureAtlas {
+    public:
+
+        /// A region inside a page of the atlas.
+        struct Region {
+            SDL_Texture* texture; ///< The texture of the page where the region is.
+            glm::uvec2 pos;       ///< Position of the region inside the texture.
+            glm::uvec2 size;      ///< Size of the region.
+        };
+
+    private:
+
+        struct Node {
+            uint32_t x, y, width;
+        };
+
+        struct Rect {
+            glm::uvec2 pos, size;
+        };
+
+        struct Page {
+            SDL_Texture* texture;
+            std::vector<Node> skyline;
+            std::vector<Rect> freeRects;
+            size_t regions;
+        };
+
+        SDL_Renderer* renderer;
+        glm::uvec2 pageSize;
+        std::vector<Page> pages;
+
+        bool fits(const Page &page, size_t index, const glm::uvec2 &size, uint32_t &y) const;
+        bool findPosition(const Page &page, const glm::uvec2 &size, glm::uvec2 &pos, size_t &index) const;
+        void addSkylineLevel(Page &page, size_t index, const glm::uvec2 &pos, const glm::uvec2 &size);
+        bool takeFreeRect(Page &page, const glm::uvec2 &size, glm::uvec2 &pos);
+        Page& newPage();
+
+    public:
+
+        /// Creates an empty atlas whose pages will have the size `pageSize`.
+        TextureAtlas(SDL_Renderer* renderer, const glm::uvec2 &pageSize = { 1024, 1024 });
+        TextureAtlas(const TextureAtlas &) = delete;
+        ~TextureAtlas();
+
+        /// Puts the pixels of the surface in some place of the atlas.
+        /**
+         * If the surface is bigger than a page, returns nothing. The surface can be in any
+         * pixel format, it will be converted if needed.
+         */
+        Optional<Region> insert(SDL_Surface* surface);
+        /// Replaces the pixels of a region with the ones of the surface. Both must have the same size.
+        void update(const Region &region, SDL_Surface* surface);
+        /// Gives back a region returned by insert(), so its space can be used by another one.
+        /// The region must not be used after that.
+        void release(const Region &region);
+        /// Destroys all pages, making all regions invalid.
+        void clear();
+
+        /// Gets the number of pages (textures) in use.
+        inline size_t getNumberOfPages() const { return pages.size(); }
+        /// Gets the size of every page.
+        inline const glm::uvec2& getPageSize() const { return pageSize; }
+
+    };
+
+}
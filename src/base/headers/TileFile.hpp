@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <Platform.hpp>
+
+namespace retro {
+
+    /// The version 3 of the `.map` and `.spr` files, used by Map and Sprites.
+    /**
+     * The file starts with a header, so it is read from the beginning and it is known what
+     * is inside before decoding it (all numbers are stored as in memory, like the legacy files):
+     *
+     *  - magic: 4 bytes, `RMAP` for a map or `RSPR` for a sprites file
+     *  - version: `uint16_t`, 3. Version 2 is also read, it is the same without the flags
+     *    TileFile::WideCells and TileFile::Layers (one layer of cells of 8 bit)
+     *  - flags: `uint16_t`, see TileFile::Flags
+     *  - width and height: `uint32_t` each, the size of the grid of cells. For a map, see
+     *    below; for a sprites file, 64 and the number of sprites.
+     *  - payload size: `uint32_t`, bytes of cells stored after the extra data
+     *  - checksum: `uint32_t`, Adler-32 of the cells once decoded
+     *  - extra size: `uint32_t`, followed by that number of bytes. The path to the sprites
+     *    file (and the layers) for a map, nothing for a sprites file.
+     *  - payload: the cells, row after row, compressed or not
+     *
+     * The compression is a run-length encoding (like PackBits): a byte `n` below 128 is
+     * followed by `n + 1` bytes copied as they are, and a byte `n` of 128 or more is followed
+     * by one byte repeated `n - 125` times. Maps are mostly empty cells, so they get much
+     * smaller, and decoding is a sequence of `memcpy` and `memset` into the destination.
+     *
+     * A map stores its cells of 16 bit as two planes of bytes per layer, the low bytes and then
+     * the high bytes (almost all zero, so they take nearly nothing once compressed), so the
+     * height of the grid is `2 * layers * height`. After the path of the sprites, a null
+     * character and, for every layer, its parallax (two `float`), visibility (`uint8_t`)
+     * and collision mask (`uint32_t`).
+     *
+     * Legacy files (raw cells with the size, or the count of sprites, at the end) don't have
+     * the header, so when parse() returns `false` the file must be read the old way.
+     **/
+    struct TileFile {
+
+        /// Flags of the file
+        enum Flags: uint16_t {
+            /// The payload is compressed with run-length encoding
+            RunLength = 1,
+            /// The cells are 16 bit, stored as two planes of bytes
+            WideCells = 2,
+            /// The extra data describes some layers, and the grid has the cells of all of them
+            Layers = 4
+        };
+
+        /// Version written by write(), parse() reads this one and the version 2
+        static constexpr uint16_t version = 3;
+
+        uint16_t flags = 0;                 ///< Flags of the file
+        glm::uvec2 size = { 0, 0 };         ///< Size of the grid of cells
+        uint32_t checksum = 0;              ///< Adler-32 of the cells
+        std::string extra;                  ///< Extra data of the file
+        Span<const uint8_t> payload;        ///< The cells as stored in the file
+
+        /// Number of cells in the file.
+        inline size_t cells() const { return size_t(size.x) * size_t(size.y); }
+
+        /**
+         * Reads the header of a file already in memory.
+         * @param file The contents of the file
+         * @param magic The magic expected, `RMAP` or `RSPR`
+         * @param out Where to store the header, the payload points into `file`
+         * @return `false` if the file is a legacy file
+         * @throws std::runtime_error If the file has a header but is truncated, or has an unknown version or flags
+         **/
+        static bool parse(Span<const uint8_t> file, const char magic[4], TileFile &out);
+
+        /**
+         * Decodes the cells straight into `out` and checks the checksum.
+         * @param out Where to store the cells, must have cells() bytes
+         * @throws std::runtime_error If the payload is corrupt
+         **/
+        void decode(uint8_t* out) const;
+
+        /**
+         * Writes a file, compressing the cells when it makes the file smaller.
+         * @param o The file where to write
+         * @param magic `RMAP` or `RSPR`
+         * @param size The size of the grid of cells
+         * @param cells The cells, row after row
+         * @param extra Extra data (the path to the sprites for a map)
+         * @param flags Flags that describe the cells, TileFile::RunLength is added by this method
+         **/
+        static void write(OutputFile &o, const char magic[4], const glm::uvec2 &size, const uint8_t* cells, const std::string &extra = "", uint16_t flags = 0);
+
+        /// Compresses `size` bytes with the run-length encoding, appending them to `out`.
+        static void encodeRunLength(const uint8_t* data, size_t size, std::vector<uint8_t> &out);
+        /// Computes the Adler-32 checksum of some bytes.
+        static uint32_t adler32(const uint8_t* data, size_t size);
+
+    };
+
+}
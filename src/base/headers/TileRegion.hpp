@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <glm/vec2.hpp>
+
+namespace retro {
+
+    /// A rectangle of cells inside a bigger grid, like the pixels of some sprites or the cells of a map.
+    /**
+     * The cells are `T`, `uint8_t` for the pixels of the sprites (TileRegion) and `uint16_t`
+     * for the cells of a map (MapRegion).
+     *
+     * The region doesn't own the cells, it only points to them: a change done through the region
+     * is done in the Sprites or the Map where it comes from. Get one using Sprite::region(),
+     * Sprites::region() or Map::region().
+     *
+     * The operations work with whole rows at once (`memcpy`, `memmove`, `memset`...), so they
+     * are much faster than changing the cells one by one with Sprite::at() or Map::at(). After
+     * changing the cells, remember to regenerate the textures.
+     **/
+    template<typename T>
+    struct BasicTileRegion {
+        T* data = nullptr;              ///< First cell of the region
+        size_t stride = 0;              ///< Number of cells between the start of two rows of the grid
+        glm::uvec2 size = { 0, 0 };     ///< Width and height of the region, in cells
+
+        /// Gets the first cell of a row of the region.
+        inline T* row(size_t y) const { return data + y * stride; }
+        /// Gets a cell of the region.
+        inline T& at(size_t x, size_t y) const { return data[y * stride + x]; }
+        /// Gets a part of this region. The part is clipped to the bounds of this region.
+        BasicTileRegion sub(const glm::uvec2 &pos, const glm::uvec2 &size) const;
+        /// Number of cells in the region.
+        inline size_t cells() const { return size_t(size.x) * size_t(size.y); }
+
+        /// Copies the cells into `out`, row after row. `out` must have cells() elements.
+        void copyTo(T* out) const;
+        /// Copies `from`, a rectangle of `fromSize` cells stored row after row, into the region. What doesn't fit is ignored.
+        void paste(const T* from, const glm::uvec2 &fromSize) const;
+        /// Sets every cell to `value`.
+        void fill(T value) const;
+        /// Mirrors the cells, left to right.
+        void flipHorizontal() const;
+        /// Mirrors the cells, top to bottom.
+        void flipVertical() const;
+        /// Rotates the cells 90 degrees. Only square regions can be rotated, returns `false` for the others.
+        bool rotate(bool clockwise = true) const;
+        /// Changes every cell for `table[cell]`, useful to change the colours of a sprite.
+        /// The table must have an entry for every value a cell can have (256 for TileRegion).
+        void remap(const T* table) const;
+        /// Moves the cells inside the region, the cells that are left empty are set to `value`.
+        void shift(const glm::ivec2 &offset, T value = 0) const;
+    };
+
+    /// A rectangle of pixels of some sprites.
+    typedef BasicTileRegion<uint8_t> TileRegion;
+    /// A rectangle of cells of a map.
+    typedef BasicTileRegion<uint16_t> MapRegion;
+
+    extern template struct BasicTileRegion<uint8_t>;
+    extern template struct BasicTileRegion<uint16_t>;
+
+}
@@ -1,7 +1,11 @@
 #pragma once
 
 #include <AnimationChain.hpp>
-#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <typeindex>
+#include <vector>
 
 namespace retro {
 
@@ -33,10 +37,16 @@ namespace retro {
      * so in general is safe to use them indistingibly. This methods are animate(),
      * isCompleted(), reset() and getDuration().
      *
+     * The dependencies are resolved once, when the timeline starts (or after a change): every
+     * AnimationChain gets an absolute start and end time. Then, every animate() only touches
+     * the chains that are running, and seek() can jump to any point of the timeline. Getting
+     * a chain with get() or at() counts as a change, because a duration can be modified
+     * through the reference: the times are calculated again in the next step and, if they
+     * moved, the running chains are placed where they should be at the current time.
+     *
      *  > **FYI** to avoid problems for calling methods on a unknown template type
-     *  > in runtime, I use [std::bind](http://en.cppreference.com/w/cpp/utility/functional/bind)
-     *  > to bind the correct methods with the instance of the object stored in
-     *  > the `std::vector`. See Timeline::Anim code :)
+     *  > in runtime, the Timeline stores pointers to functions generated for the type
+     *  > of every AnimationChain. See Timeline::Anim code :)
      *
      * An example:
      * ```
@@ -61,27 +71,147 @@ namespace retro {
      * ```
      */
     class Timeline {
+        enum class Dependency { None, With, After };
+
         struct Anim {
             void* ptr;
-            Animation<float> delay;
-            std::function<bool()> isCompleted;
-            std::function<void(float)> animate;
-            std::function<float()> getDuration;
-            std::function<void()> reset;
-            template<class T> Anim(AnimationChain<T>* p) {
-                ptr = p;
-                isCompleted = std::bind(&AnimationChain<T>::isCompleted, p);
-                animate = std::bind(&AnimationChain<T>::animate, p, std::placeholders::_1);
-                getDuration = std::bind(&AnimationChain<T>::getDuration, p);
-                reset = std::bind(&AnimationChain<T>::reset, p);
+            std::type_index type;
+            Dependency dependency;
+            size_t dependsOn;
+            mutable float start, end;
+            void (*animate)(void*, float);
+            void (*setProgress)(void*, float);
+            float (*getDuration)(const void*);
+            bool (*isCompleted)(const void*);
+            void (*reset)(void*);
+            void* (*clone)(const void*);
+            void (*destroy)(void*);
+
+            template<class T> Anim(AnimationChain<T>* p, Dependency dependency, size_t dependsOn):
+            ptr(p), type(typeid(T)), dependency(dependency), dependsOn(dependsOn), start(0), end(0) {
+                using C = AnimationChain<T>;
+                animate = [] (void* c, float delta) { static_cast<C*>(c)->animate(delta); };
+                setProgress = [] (void* c, float time) { static_cast<C*>(c)->setProgress(time); };
+                getDuration = [] (const void* c) { return static_cast<const C*>(c)->getDuration(); };
+                isCompleted = [] (const void* c) { return static_cast<const C*>(c)->isCompleted(); };
+                reset = [] (void* c) { static_cast<C*>(c)->reset(); };
+                clone = [] (const void* c) -> void* { return new C(*static_cast<const C*>(c)); };
+                destroy = [] (void* c) { delete static_cast<C*>(c); };
             }
         };
 
         std::vector<Anim> chains;
+        mutable std::vector<size_t> byStart; //Positions of the chains sorted by start time
+        std::vector<size_t> running;
+        size_t nextToStart = 0;
+        float time = 0.0f;
+        mutable bool compiled = false;
+        mutable bool timesChanged = false; //compile() moved some chain, the running ones must be placed again
         bool allEnded = false;
 
+        template<typename T>
+        size_t push(AnimationChain<T>* chain, Dependency dependency, size_t i) {
+            if(dependency != Dependency::None && i >= chains.size()) {
+                delete chain;
+                throw std::out_of_range("Position " + std::to_string(i) + " is not inside the Timeline");
+            }
+            chains.emplace_back(chain, dependency, i);
+            compiled = false;
+            return chains.size() - 1;
+        }
+
+        /// Calculates the absolute start and end time of every chain
+        void compile() const {
+            //Dependencies always point to a previous chain, so one pass is enough
+            for(auto &anim: chains) {
+                const float start = anim.start, end = anim.end;
+                if(anim.dependency == Dependency::With) anim.start = chains[anim.dependsOn].start;
+                else if(anim.dependency == Dependency::After) anim.start = chains[anim.dependsOn].end;
+                else anim.start = 0.0f;
+                anim.end = anim.start + anim.getDuration(anim.ptr);
+                if(anim.start != start || anim.end != end || byStart.size() != chains.size()) timesChanged = true;
+            }
+
+            byStart.resize(chains.size());
+            for(size_t i = 0; i < chains.size(); i++) byStart[i] = i;
+            std::stable_sort(byStart.begin(), byStart.end(), [this] (size_t a, size_t b) { return chains[a].start < chains[b].start; });
+            compiled = true;
+        }
+
+        void copyFrom(const Timeline &o) {
+            chains = o.chains;
+            for(auto &anim: chains) anim.ptr = anim.clone(anim.ptr);
+            byStart = o.byStart;
+            running = o.running;
+            nextToStart = o.nextToStart;
+            time = o.time;
+            compiled = o.compiled;
+            timesChanged = o.timesChanged;
+            allEnded = o.allEnded;
+        }
+
+        void destroyChains() {
+            for(auto &anim: chains) anim.destroy(anim.ptr);
+            chains.clear();
+        }
+
+        /// Places every chain where it should be at the time `t`
+        void place(float t) {
+            time = t;
+            auto started = std::upper_bound(byStart.begin(), byStart.end(), time, [this] (float value, size_t i) { return value < chains[i].start; });
+            nextToStart = size_t(started - byStart.begin());
+            running.clear();
+            for(size_t n = 0; n < byStart.size(); n++) {
+                auto &anim = chains[byStart[n]];
+                anim.reset(anim.ptr);
+                if(n < nextToStart) {
+                    anim.setProgress(anim.ptr, time - anim.start);
+                    if(!anim.isCompleted(anim.ptr)) running.push_back(byStart[n]);
+                }
+            }
+            allEnded = nextToStart == byStart.size() && running.empty();
+        }
+
+        /// Calculates the times again if something changed, and places the chains if they moved while running
+        void update() {
+            if(!compiled) compile();
+            if(timesChanged) {
+                timesChanged = false;
+                if(nextToStart > 0) place(time);
+            }
+        }
+
     public:
 
+        Timeline() {}
+        Timeline(const Timeline &o) { copyFrom(o); }
+        Timeline(Timeline &&o) = default;
+        ~Timeline() { destroyChains(); }
+
+        Timeline& operator=(const Timeline &o) {
+            if(this != &o) {
+                destroyChains();
+                copyFrom(o);
+            }
+            return *this;
+        }
+
+        Timeline& operator=(Timeline &&o) {
+            if(this != &o) {
+                destroyChains();
+                chains = std::move(o.chains);
+                o.chains.clear();
+                byStart = std::move(o.byStart);
+                running = std::move(o.running);
+                nextToStart = o.nextToStart;
+                time = o.time;
+                compiled = o.compiled;
+                timesChanged = o.timesChanged;
+                allEnded = o.allEnded;
+            }
+            return *this;
+        }
+
         /// Adds an animation that will apply after the animation[i]
         /**
          * The animation will be applied when the animation with numer `i` has
@@ -96,9 +226,7 @@ namespace retro {
          **/
         template<typename T>
         size_t addAfter(size_t i, const AnimationChain<T> &chain) {
-            chains.push_back(new AnimationChain<T>(chain));
-            chains.back().delay = delay<float>([i, this] () { return this->chains[i].getDuration() + this->chains[i].delay.getDuration(); });
-            return chains.size() - 1;
+            return push(new AnimationChain<T>(chain), Dependency::After, i);
         }
 
         /// Adds an animation that will apply after the animation[i]
@@ -115,9 +243,7 @@ namespace retro {
          **/
         template<typename T>
         size_t addAfter(size_t i, AnimationChain<T> &&chain) {
-            chains.push_back(new AnimationChain<T>(std::forward<AnimationChain<T>>(chain)));
-            chains.back().delay = delay<float>([i, this] () { return this->chains[i].getDuration() + this->chains[i].delay.getDuration(); });
-            return chains.size() - 1;
+            return push(new AnimationChain<T>(std::forward<AnimationChain<T>>(chain)), Dependency::After, i);
         }
 
         /// Adds an animation that will apply at the same time of animation[i] does
@@ -134,9 +260,7 @@ namespace retro {
          */
         template<typename T>
         size_t addWith(size_t i, const AnimationChain<T> &chain) {
-            chains.push_back(new AnimationChain<T>(chain));
-            chains.back().delay = delay<float>([i, this] () { return this->chains[i].delay.getDuration(); });
-            return chains.size() - 1;
+            return push(new AnimationChain<T>(chain), Dependency::With, i);
         }
 
         /// Adds an animation that will apply at the same time of animation[i] does
@@ -153,9 +277,7 @@ namespace retro {
          */
         template<typename T>
         size_t addWith(size_t i, AnimationChain<T> &&chain) {
-            chains.push_back(new AnimationChain<T>(std::forward<AnimationChain<T>>(chain)));
-            chains.back().delay = delay<float>([i, this] () { return this->chains[i].delay.getDuration(); });
-            return chains.size() - 1;
+            return push(new AnimationChain<T>(std::forward<AnimationChain<T>>(chain)), Dependency::With, i);
         }
 
         /// Adds an animation that will apply from the beginning of the timeline
@@ -169,9 +291,7 @@ namespace retro {
          */
         template<typename T>
         size_t add(const AnimationChain<T> &chain) {
-            chains.push_back(new AnimationChain<T>(chain));
-            chains.back().delay = delay<float>(0);
-            return chains.size() - 1;
+            return push(new AnimationChain<T>(chain), Dependency::None, 0);
         }
 
         /// Adds an animation that will apply from the beginning of the timeline
@@ -185,9 +305,7 @@ namespace retro {
          */
         template<typename T>
         size_t add(AnimationChain<T> &&chain) {
-            chains.push_back(new AnimationChain<T>(std::forward<AnimationChain<T>>(chain)));
-            chains.back().delay = delay<float>(0);
-            return chains.size() - 1;
+            return push(new AnimationChain<T>(std::forward<AnimationChain<T>>(chain)), Dependency::None, 0);
         }
 
         /// Gets an AnimationChain positioned at `pos` (safe version)
@@ -206,12 +324,13 @@ namespace retro {
          */
         template<typename T>
         AnimationChain<T>& get(size_t pos) {
-            auto a = reinterpret_cast<AnimationChain<float>*>(chains.at(pos).ptr);
-            if(a->itype == std::type_index(typeid(T))) {
-                return *reinterpret_cast<AnimationChain<T>*>(a);
+            auto &anim = chains.at(pos);
+            if(anim.type == std::type_index(typeid(T))) {
+                compiled = false;
+                return *static_cast<AnimationChain<T>*>(anim.ptr);
             } else {
                 throw std::runtime_error("Type in AnimationChain mismatch: expected '" +
-                    std::string(typeid(T).name()) + "', got '" + a->itype.name() + "' instead");
+                    std::string(typeid(T).name()) + "', got '" + anim.type.name() + "' instead");
             }
         }
 
@@ -224,34 +343,67 @@ namespace retro {
          * @return A reference to the AnimationChain object stored at this position
          */
         template<typename T>
-        AnimationChain<T> at(size_t pos) {
-            return *reinterpret_cast<AnimationChain<T>*>(chains[pos].ptr);
+        AnimationChain<T>& at(size_t pos) {
+            compiled = false;
+            return *static_cast<AnimationChain<T>*>(chains[pos].ptr);
         }
 
         /// Gets the duration of an animation plus the delay introduced by the dependencies
-        float durationWithDelay(size_t pos) {
-            return chains[pos].getDuration() + chains[pos].delay.getDuration();
+        float durationWithDelay(size_t pos) const {
+            if(!compiled) compile();
+            return chains[pos].end;
         }
 
         /// Applies one animation step
         void animate(float delta) {
-            if(!isCompleted()) {
-                allEnded = true;
-                for(auto &anim: chains) {
-                    if(!anim.delay.isCompleted()) {
-                        allEnded = false;
-                        anim.delay.animate(delta);
-                    } else if(!anim.isCompleted()) {
-                        allEnded = false;
-                        anim.animate(delta);
-                    }
+            update();
+            if(isCompleted()) return;
+            time += delta;
+
+            for(size_t r = 0; r < running.size();) {
+                auto &anim = chains[running[r]];
+                anim.animate(anim.ptr, delta);
+                if(anim.isCompleted(anim.ptr)) {
+                    running[r] = running.back();
+                    running.pop_back();
+                } else {
+                    r++;
                 }
             }
+
+            //Chains are started in order, with the time that has passed since their start
+            while(nextToStart < byStart.size() && chains[byStart[nextToStart]].start <= time) {
+                size_t i = byStart[nextToStart++];
+                chains[i].animate(chains[i].ptr, time - chains[i].start);
+                if(!chains[i].isCompleted(chains[i].ptr)) running.push_back(i);
+            }
+
+            allEnded = nextToStart == byStart.size() && running.empty();
         }
 
+        /// Moves the timeline to the _(absolute)_ time `t` (in seconds)
+        /**
+         * The chains that should have ended are completed, the ones that should be running
+         * are moved to their position, and the rest are reset. Finding which chains have
+         * started is a binary search.
+         */
+        void seek(float t) {
+            if(!compiled) compile();
+            timesChanged = false;
+            place(std::max(t, 0.0f));
+        }
+
+        /// Gets the current time of the timeline
+        inline float getTime() const { return time; }
+
         /// Resets the animation to the initial state
         void reset() {
-            for(auto &anim: chains) anim.reset();
+            for(auto &anim: chains) anim.reset(anim.ptr);
+            running.clear();
+            nextToStart = 0;
+            time = 0.0f;
+            allEnded = false;
+            compiled = false;
         }
 
         /// Returns `true` if all the animations have ended
@@ -261,8 +413,9 @@ namespace retro {
 
         /// Returns the duration of the animation
         float getDuration() const {
+            if(!compiled) compile();
             float dur = 0;
-            for(auto &anim: chains) dur = std::max(dur, anim.getDuration() + anim.delay.getDuration());
+            for(auto &anim: chains) dur = std::max(dur, anim.end);
             return dur;
         }
     };
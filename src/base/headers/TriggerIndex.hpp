@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include <Frame.hpp>
+
+namespace retro {
+
+    class CollisionDetection;
+    class MovableObject;
+
+    /// Finds when the objects enter or leave the CollisionDetection triggers of a Level
+    /**
+     * The triggers are stored in a grid of cells of cellSize canvas pixels, so every frame
+     * only the triggers near the objects they detect are checked. The pairs (trigger, object)
+     * that collide are compared with the ones of the previous frame, and only the triggers
+     * that start or stop colliding are called. The cost depends on the objects detected
+     * and the triggers around them, not on how many triggers the level has.
+     *
+     * Every Level has one of these, which is updated by the Game after the objects. The
+     * triggers add and remove themselves, it's not needed to use it directly.
+     **/
+    class TriggerIndex {
+
+        struct Entry {
+            CollisionDetection* trigger = nullptr;
+            MovableObject* object = nullptr;
+            Frame frame;
+            uint32_t checked = 0;   ///< Last pass in which it was checked
+            CollisionFace face = NONE;
+            Frame collision;
+        };
+
+        std::vector<Entry> entries;
+        std::vector<uint32_t> freeSlots;
+        std::vector<uint32_t> releasedSlots;    ///< Removed while sending the events, reused after them
+        std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+        std::vector<std::pair<MovableObject*, size_t>> watched;
+        std::vector<uint32_t> colliding, current, entered, exited;
+        uint32_t pass = 0;
+        bool dispatching = false;
+
+        static inline uint64_t key(int32_t x, int32_t y) { return (uint64_t(uint32_t(x)) << 32) | uint32_t(y); }
+        template<typename Func>
+        void forEachCell(const Frame &frame, Func &&func);
+        void insert(uint32_t slot);
+        void erase(uint32_t slot);
+
+    public:
+
+        static const int cellSize = 64; ///< Size of the cells of the grid, in canvas pixels
+
+        /// Registers a trigger, which detects the object it has
+        void add(CollisionDetection* trigger);
+        /// Unregisters a trigger. No event is sent.
+        void remove(CollisionDetection* trigger);
+        /// Tells that the frame of the trigger has changed
+        void moved(CollisionDetection* trigger);
+        /// Checks the triggers near the objects and sends the start and end events. Called by the Game.
+        void update();
+        /// Gets the number of triggers registered
+        inline size_t size() const { return entries.size() - freeSlots.size() - releasedSlots.size(); }
+
+    };
+
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <glm/vec2.hpp>
+#include <Color.hpp>
+#include <Animation.hpp>
+#include <SmallFunction.hpp>
+
+namespace retro {
+
+    /// Animates many properties at the same time, in one pass per frame
+    /**
+     * A tween animates a property (a `float`, `glm::vec2`, Color or `size_t`) from its current
+     * value to another one, during some time and with an Interpolator. Instead of calling a
+     * setter, the tween writes directly the new value into the property, so the property must
+     * live until the tween ends or it is cancelled.
+     *
+     * All tweens of the same type are stored in flat arrays and are updated together: first
+     * the progress of all of them (a loop the compiler can vectorise), then the interpolators
+     * and at last the new values. When some tweens end, their callbacks are called after
+     * all tweens have been updated, so a callback can add new tweens (to chain animations) or
+     * cancel others safely. The order of the callbacks is not defined.
+     *
+     * Every Level has one of these, that is updated by the Game before the objects, see
+     * Level::tweens.
+     *
+     * ```
+     * //Fades the HUD in 0.5s and then moves the dialog to its place
+     * tweens.add(interpolator::CubicOut<>(), hudAlpha, 255.0f, 0.5f, [this] () {
+     *     tweens.add(interpolator::QuadInOut<>(), dialogPos, vec2{ 10, 100 }, 1.0f);
+     * });
+     * ```
+     *
+     * The interpolator is only used to know its type, it is created again with its default
+     * constructor when needed.
+     **/
+    class Tweens {
+    public:
+
+        typedef uint32_t Id;                  ///< Identifies a tween, to cancel it
+        typedef SmallFunction<void()> Callback; ///< Function called when a tween ends
+
+    private:
+
+        typedef float (*Ease)(float);
+
+        template<class I>
+        static float ease(float perc) {
+            return I().I::interpolate(perc);
+        }
+
+        template<typename T>
+        static inline T lerp(const T &from, const T &to, float t) {
+            return T(from + (to - from) * t);
+        }
+
+        static inline Color lerp(const Color &from, const Color &to, float t) {
+            return {
+                Color::channel(float(from.r) + (float(to.r) - float(from.r)) * t),
+                Color::channel(float(from.g) + (float(to.g) - float(from.g)) * t),
+                Color::channel(float(from.b) + (float(to.b) - float(from.b)) * t),
+                Color::channel(float(from.a) + (float(to.a) - float(from.a)) * t)
+            };
+        }
+
+        static inline size_t lerp(size_t from, size_t to, float t) {
+            //Unsigned, so it must be done with signed numbers to go backwards. Interpolators that
+            //overshoot can go below 0, and the biggest double that fits in a size_t is the limit
+            constexpr double biggest = double(std::numeric_limits<size_t>::max() >> 11 << 11);
+            const double v = double(from) + (double(to) - double(from)) * double(t);
+            return !(v > 0.0) ? 0 : v >= biggest ? size_t(biggest) : size_t(v + 0.5);
+        }
+
+        template<typename T>
+        struct Track {
+            std::vector<T*> targets;
+            std::vector<T> from, to;
+            std::vector<float> elapsed, duration, perc;
+            std::vector<Ease> eases;
+            std::vector<Id> ids;
+            std::vector<Callback> callbacks;
+
+            void add(Id id, T* target, const T &end, float time, Ease ease, Callback &&callback) {
+                targets.push_back(target);
+                from.push_back(*target);
+                to.push_back(end);
+                elapsed.push_back(0.0f);
+                duration.push_back(time);
+                eases.push_back(ease);
+                ids.push_back(id);
+                callbacks.push_back(std::move(callback));
+            }
+
+            void remove(size_t i) {
+                const size_t last = targets.size() - 1;
+                if(i != last) {
+                    targets[i] = targets[last];
+                    from[i] = from[last];
+                    to[i] = to[last];
+                    elapsed[i] = elapsed[last];
+                    duration[i] = duration[last];
+                    eases[i] = eases[last];
+                    ids[i] = ids[last];
+                    callbacks[i] = std::move(callbacks[last]);
+                }
+                targets.pop_back();
+                from.pop_back();
+                to.pop_back();
+                elapsed.pop_back();
+                duration.pop_back();
+                eases.pop_back();
+                ids.pop_back();
+                callbacks.pop_back();
+            }
+
+            bool remove(Id id) {
+                auto it = std::find(ids.begin(), ids.end(), id);
+                if(it == ids.end()) return false;
+                remove(size_t(it - ids.begin()));
+                return true;
+            }
+
+            void removeTarget(const void* target) {
+                for(size_t i = targets.size(); i-- > 0;) {
+                    if(targets[i] == target) remove(i);
+                }
+            }
+
+            void update(float delta, std::vector<Callback> &ended) {
+                const size_t n = targets.size();
+                perc.resize(n);
+                float* p = perc.data();
+                float* e = elapsed.data();
+                const float* d = duration.data();
+                for(size_t i = 0; i < n; i++) {
+                    e[i] += delta;
+                    p[i] = e[i] >= d[i] ? 1.0f : e[i] / d[i];
+                }
+
+                for(size_t i = 0; i < n; i++) p[i] = eases[i](p[i]);
+                for(size_t i = 0; i < n; i++) *targets[i] = lerp(from[i], to[i], p[i]);
+
+                //Backwards, so removing one doesn't move the ones not checked yet
+                for(size_t i = n; i-- > 0;) {
+                    if(e[i] >= d[i]) {
+                        *targets[i] = to[i];
+                        if(callbacks[i]) ended.push_back(std::move(callbacks[i]));
+                        remove(i);
+                    }
+                }
+            }
+
+            void clear() {
+                targets.clear();
+                from.clear();
+                to.clear();
+                elapsed.clear();
+                duration.clear();
+                eases.clear();
+                ids.clear();
+                callbacks.clear();
+            }
+        };
+
+        Track<float> floats;
+        Track<glm::vec2> vec2s;
+        Track<Color> colors;
+        Track<size_t> sizes;
+        std::vector<Callback> ended;
+        Id nextId = 1;
+
+        inline Track<float>& track(float*) { return floats; }
+        inline Track<glm::vec2>& track(glm::vec2*) { return vec2s; }
+        inline Track<Color>& track(Color*) { return colors; }
+        inline Track<size_t>& track(size_t*) { return sizes; }
+
+    public:
+
+        /// Animates the property `target` from its current value to `to` during `duration` seconds.
+        /**
+         * @param interp The interpolator, see Interpolator
+         * @param target The property to animate, which must live while the tween is running
+         * @param to The final value of the property
+         * @param duration Duration of the animation in seconds
+         * @param onEnd Optional function to call when the animation ends
+         * @return The id of the tween, to cancel it if needed
+         */
+        template<class Inter, typename T>
+        Id add(Inter interp, T &target, const T &to, float duration, Callback onEnd = nullptr) {
+            static_assert(std::is_base_of<Interpolator<float>, Inter>::value, "Type of interpolator must inherit from Interpolator");
+            Id id = nextId++;
+            track(&target).add(id, &target, to, duration, &ease<Inter>, std::move(onEnd));
+            return id;
+        }
+
+        /// Stops the tween, leaving the property with its current value. Its callback is not called.
+        bool cancel(Id id) {
+            return floats.remove(id) || vec2s.remove(id) || colors.remove(id) || sizes.remove(id);
+        }
+
+        /// Stops all tweens animating the property, leaving it with its current value.
+        template<typename T>
+        void cancelAll(T &target) {
+            track(&target).removeTarget(&target);
+        }
+
+        /// Stops all tweens. No callback is called.
+        void clear() {
+            floats.clear();
+            vec2s.clear();
+            colors.clear();
+            sizes.clear();
+        }
+
+        /// Gets the number of tweens running
+        size_t size() const {
+            return floats.targets.size() + vec2s.targets.size() + colors.targets.size() + sizes.targets.size();
+        }
+
+        /// Applies one animation step to all tweens. Called by the Game.
+        void update(float delta) {
+            floats.update(delta, ended);
+            vec2s.update(delta, ended);
+            colors.update(delta, ended);
+            sizes.update(delta, ended);
+
+            //Swapped out, because callbacks can add new tweens that end in this same call
+            std::vector<Callback> callbacks;
+            callbacks.swap(ended);
+            for(auto &callback: callbacks) callback();
+            callbacks.clear();
+            if(ended.empty()) ended.swap(callbacks);
+        }
+
+    };
+
+}
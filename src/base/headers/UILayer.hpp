@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <glm/vec2.hpp>
+#include <Frame.hpp>
+
+typedef struct SDL_Renderer SDL_Renderer;
+typedef struct SDL_Texture SDL_Texture;
+
+namespace retro {
+
+    class Level;
+    class UIObject;
+
+    /// Keeps the UIObjects drawn between frames
+    /**
+     * Every UIObject is drawn into its own texture, and it is drawn again only when it changes
+     * (see UIObject::invalidate()). The textures are composed into a texture with the size of
+     * the window, but only the areas where some object has changed, moved, appeared or
+     * disappeared are composed again. At last, the whole layer is copied over the canvas with
+     * one copy. A HUD that doesn't change costs that copy and nothing more.
+     *
+     * Objects that are not retained (see UIObject::setRetained()) are not part of the layer,
+     * the Game draws them every frame after the layer.
+     *
+     * Used by the Game, there's one for the whole game loop.
+     **/
+    class UILayer {
+
+        struct Composed {
+            const UIObject* object;
+            Frame area;
+        };
+
+        SDL_Renderer* renderer;
+        SDL_Texture* texture = nullptr;
+        glm::ivec2 size = { 0, 0 };
+        const Level* lastLevel = nullptr;
+        std::vector<Composed> composed, current;
+        std::vector<Frame> dirty;
+        bool hasImmediate = false;
+
+        bool render(UIObject &object, Level &uiLevel, float scale);
+        void invalidate(const Frame &area);
+        void compose();
+
+    public:
+
+        UILayer(SDL_Renderer* renderer): renderer(renderer) {}
+        UILayer(const UILayer &) = delete;
+        ~UILayer();
+
+        /**
+         * Draws again the objects that changed and composes the areas of the layer that changed.
+         * Must be called with the UI level as the current level of the Game.
+         * @param level The level whose UI objects are shown
+         * @param objects The UI objects of that level
+         * @param uiLevel The level used to draw the UI objects
+         * @param windowSize Size of the window in pixels
+         * @param scale Scale factor of the window
+         * @return `true` if the layer changed or there are objects that are not retained
+         **/
+        bool update(const Level &level, const std::vector<UIObject*> &objects, Level &uiLevel, const glm::ivec2 &windowSize, float scale);
+
+        /// Copies the layer into the current render target, covering all of it
+        void draw();
+
+        /// `true` if there are objects that must be drawn every frame
+        inline bool hasImmediateObjects() const { return hasImmediate; }
+
+    };
+
+}
@@ -6,6 +6,7 @@
 
 typedef struct _TTF_Font TTF_Font;
 typedef struct SDL_Renderer SDL_Renderer;
+typedef struct SDL_Texture SDL_Texture;
 struct CacheValue;
 
 namespace retro {
@@ -70,7 +71,9 @@ namespace retro {
      * See setFont(), setFontStyle(), setFontOutline(), setText(), setTextColor() (or
      * setTextColour()), setAlign(), setTextBoxLimit() and renderText(). All these
      * methods are protected, so you must call them in the Object::setup(),
-     * Object::draw() or Object::update().
+     * Object::draw() or Object::update(). Fonts are shared among all UIObjects
+     * through the game's FontCache, so using the same font in many objects opens
+     * the file once.
      *
      * The Object::frame attribute is semicalculated by the UIObject. Let me explain.
      * The position is up to you 100%, but the size is controlled by you but with some
@@ -83,7 +86,9 @@ namespace retro {
      * The UIObject stores in cache the rendered version of the text. Any of the
      * following method calls will clear the cache, but only if there's a difference
      * between the current value and the new: setTextBoxLimit() (_will clear it always_),
-     * setFont(), setFontStyle(), setText(), setTextColor(), restoreState().
+     * setFont(), setFontStyle(), setTextColor(), restoreState(). Changing the text
+     * keeps the cache when the new text is the old one with something appended: only
+     * the last line is rendered again. This makes typewriter-like effects cheap.
      *
      * Well, there's a lot about text. But, _what you should do if you don't want to
      * render text?_ Simply, don't call any text/font related method :) But if you want,
@@ -109,6 +114,13 @@ namespace retro {
      * text when BoxLimit::Nothing is set. Must ensure that the objects fit inside
      * the parent. No clip can be done.
      *
+     * UIObjects are retained: the object is drawn into a texture, and draw() is only called
+     * again when something changes. Changes in the text, the colour, the font, the alignment,
+     * the frame or the subobjects are detected. If draw() shows something else that changes
+     * (a value of the game, an animation...), call invalidate() when it changes, or use
+     * setRetained() to draw the object every frame as before. Everything must be drawn
+     * inside the Object::frame, the rest is clipped. See UILayer.
+     *
      * For the input events, there's a bunch of methods that can be overridden to
      * know when an input event has occurred. **Always call the super-implementation**,
      * to avoid strange behaviours. The methods you can use are: focus(), lostFocus(),
@@ -130,6 +142,7 @@ namespace retro {
         glm::uvec2 textFrame = { 0, 0 };
         BoxLimit boxLimit = BoxLimit::Nothing; /// < Use setTextBoxStyle() instead of this
         std::string text;
+        uint64_t textVersion = 0;           ///< Changes with the text, to know if the cache is outdated
         Color color = 0xFFFFFF_rgb;
         std::string gamePath;
         std::string fontPath;
@@ -140,6 +153,11 @@ namespace retro {
         UIObject* parent = nullptr, *focused = nullptr;
         bool wasInside = false, isFocused = false;
         int pressed = 0;
+        SDL_Texture* layer = nullptr;       ///< The object drawn, see UILayer
+        glm::ivec2 layerSize = { 0, 0 };
+        Frame layerFrame;                   ///< Frame when the object was drawn into the layer
+        bool dirty = true;
+        bool retained = true;
 
         /// Does some magics for getAlign()
         struct TextAlign {
@@ -152,11 +170,16 @@ namespace retro {
         void clearCache();
         void generateCache();
         void setFontWithPath(const std::string &path, uint32_t size);
+        void changeFont(const std::string &path, uint32_t size, int style, int outline);
+        void retainFont();
+        bool needsRedraw() const;
+        void markDrawn();
 
     protected:
 
         friend Game;
         friend Level;
+        friend class UILayer;
 
         UIObject(Game &game, Level &level, const glm::vec2 &pos, const std::string &name);
         UIObject(UIObject* parent, const glm::vec2 &pos, const std::string &name);
@@ -221,15 +244,15 @@ namespace retro {
          * ```
          * void keyUp(int key) override {
          *     UIObject::keyUp(key); //Always call super implementation!
-         *     if(hasFocus() && key == SDL_SCANCODE_BACKSPACE && !text.empty()) {
-         *         auto prev = text();
-         *         utf8::prior(prev, text()); //Searches for the last Unicode code point in the UTF-8 string
-         *         text = text.substr(0, prev - text()); //Delete it
+         *     if(hasFocus() && key == SDL_SCANCODE_BACKSPACE && !getText().empty()) {
+         *         auto prev = getText().end();
+         *         utf8::prior(prev, getText().begin()); //Searches for the last Unicode code point in the UTF-8 string
+         *         setText(getText().substr(0, prev - getText().begin())); //Delete it
          *     }
          * }
          * void charKey(std::string input) override {
          *     UIObject::charKey(input); //Remember to do that always :)
-         *     text += input;
+         *     setText(getText() + input);
          * }
          * ```
          *
@@ -271,15 +294,20 @@ namespace retro {
         virtual void mouseClick(int) {}
         virtual void mouseMoved(const glm::ivec2 &pos, const glm::ivec2 &desp);
 
+        /// Draws the object every frame (`false`) or only when it changes (`true`, by default)
+        void setRetained(bool retained);
+
     public:
 
         UIObject(const UIObject &o): Object(o) {
             renderer = o.renderer;
             font = o.font;
-            cacheValue = o.cacheValue;
+            //Each copy renders and frees its own cache of the text
+            cacheValue = nullptr;
             textFrame = o.textFrame;
             boxLimit = o.boxLimit;
             text = o.text;
+            textVersion = o.textVersion;
             color = o.color;
             gamePath = o.gamePath;
             fontPath = o.fontPath;
@@ -292,6 +320,8 @@ namespace retro {
             wasInside = o.wasInside;
             isFocused = o.isFocused;
             pressed = o.pressed;
+            retained = o.retained;
+            retainFont();
         }
 
         /// Move constructor
@@ -303,6 +333,7 @@ namespace retro {
             textFrame = std::move(o.textFrame);
             boxLimit = o.boxLimit;
             text = std::move(o.text);
+            textVersion = o.textVersion;
             color = std::move(o.color);
             gamePath = o.gamePath;
             fontPath = std::move(o.fontPath);
@@ -315,8 +346,16 @@ namespace retro {
             wasInside = o.wasInside;
             isFocused = o.isFocused;
             pressed = o.pressed;
+            layer = moveAndNull(o.layer);
+            layerSize = o.layerSize;
+            layerFrame = o.layerFrame;
+            dirty = o.dirty;
+            retained = o.retained;
         }
 
+        /// Tells that the object has changed, and must be drawn again
+        inline void invalidate() { dirty = true; }
+
         /// Returns `true` if this UIObject has the input focus
         constexpr bool hasInputFocus() const { return isFocused && focused == nullptr; }
 
@@ -369,13 +408,14 @@ namespace retro {
 
         /**
          * Changes the text to be rendered to the new one. New lines can be
-         * represented too. Can clear the cache.
+         * represented too. If the new text starts with the old one, only the last
+         * line will be rendered again.
          * @param str The new text
          */
         void setText(const std::string &str);
 
-        /// Gets the text (reference) of the UIObject
-        constexpr std::string& getText() { return text; }
+        /// Gets the text of the UIObject. Use setText() to change it.
+        inline const std::string& getText() const { return text; }
 
         /**
          * Changes the text color. Can clear the cache.
@@ -393,10 +433,10 @@ namespace retro {
         constexpr Colour getTextColour() const { return color; }
 
         /// Changes the vertical align
-        constexpr void setAlign(TextHorizontalAlign h) { hAlign = h; }
+        constexpr void setAlign(TextHorizontalAlign h) { if(hAlign != h) { hAlign = h; dirty = true; } }
 
         ///Changes the horizontal align
-        constexpr void setAlign(TextVerticalAlign v) { vAlign = v; }
+        constexpr void setAlign(TextVerticalAlign v) { if(vAlign != v) { vAlign = v; dirty = true; } }
 
         ///Returns the TextVerticalAlign or TextHorizontalAlign, dependening on your needs ;)
         constexpr TextAlign getAlign() { return { vAlign, hAlign }; }
@@ -419,6 +459,7 @@ namespace retro {
             static_assert(!std::is_abstract<T>::value, "The type cannot be an abstract class");
             subObjects.push_back(new T(std::forward<T>(o)));
             subObjects.back()->setup();
+            dirty = true;
         }
 
         /// Deletes the subobject. **Deletes must be done in the update method**.
@@ -429,6 +470,7 @@ namespace retro {
             if(it != subObjects.end()) {
                 delete *it;
                 subObjects.erase(it);
+                dirty = true;
             }
         }
 
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+#include <stddef.h>
+
+namespace retro {
+
+    /// Small helpers to measure parts of the engine, used by the benchmarks in this folder.
+    /**
+     * The benchmarks are built only when the CMake option `BUILD_BENCHMARKS` is enabled,
+     * and they are run with `retro-benchmarks` (build them in release mode, the numbers of
+     * a debug build mean nothing).
+     **/
+    namespace benchmark {
+
+        /// Runs `f` once to warm up and then `iterations` times, returns the mean time of a run in seconds.
+        template<class F>
+        inline double run(size_t iterations, F &&f) {
+            f();
+            const auto start = std::chrono::steady_clock::now();
+            for(size_t i = 0; i < iterations; i++) f();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            return elapsed.count() / double(iterations);
+        }
+
+        /// Compares the exact interpolators against the tabulated ones (speed and error).
+        void interpolators();
+
+        /// Measures the loads of maps, sprites, palettes and saved games, and compares
+        /// InputFile::readAll() against reading the file with streams.
+        /// Needs a video driver, run it with `SDL_VIDEODRIVER=dummy` where there is no display.
+        void loads();
+
+    }
+
+}
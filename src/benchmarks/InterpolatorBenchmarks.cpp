@@ -0,0 +1,57 @@
+#include "Benchmark.hpp"
+#include <Color.hpp>
+#include <Animation.hpp>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace retro;
+using namespace std;
+
+//Enough values to not fit in the caches, like animating many objects at once
+static const size_t values = 1 << 20;
+static const size_t iterations = 20;
+
+template<class I>
+static void compare(const char* name, const vector<float> &in, vector<float> &exact, vector<float> &tabulated) {
+    const I interp;
+    const interpolator::Tabulated<I> table;
+    const double exactTime = benchmark::run(iterations, [&] () { interpolator::interpolate(interp, in.data(), exact.data(), values); });
+    const double tableTime = benchmark::run(iterations, [&] () { table.interpolate(in.data(), tabulated.data(), values); });
+    //The virtual call, as it is done by Animation (through its dispatcher) and Tweens
+    const Interpolator<float> &single = table;
+    const double singleTime = benchmark::run(iterations, [&] () {
+        for(size_t i = 0; i < values; i++) tabulated[i] = single.interpolate(in[i]);
+    });
+
+    float maxError = 0;
+    for(size_t i = 0; i < values; i++) maxError = std::max(maxError, std::abs(exact[i] - tabulated[i]));
+    printf("%-12s %10.2f %10.2f %10.2f %8.2fx %12.7f\n",
+           name,
+           exactTime * 1e9 / values,
+           tableTime * 1e9 / values,
+           singleTime * 1e9 / values,
+           exactTime / tableTime,
+           maxError);
+}
+
+void benchmark::interpolators() {
+    vector<float> in(values), exact(values), tabulated(values);
+    mt19937 random(42);
+    uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    for(auto &v: in) v = distribution(random);
+
+    printf("Interpolators, %zu values (ns per value)\n", values);
+    printf("%-12s %10s %10s %10s %9s %12s\n", "", "exact", "table", "one by one", "speedup", "max error");
+    compare<interpolator::QuadOut<>>("QuadOut", in, exact, tabulated);
+    compare<interpolator::CubicInOut<>>("CubicInOut", in, exact, tabulated);
+    compare<interpolator::SineIn<>>("SineIn", in, exact, tabulated);
+    compare<interpolator::SineInOut<>>("SineInOut", in, exact, tabulated);
+    compare<interpolator::CircIn<>>("CircIn", in, exact, tabulated);
+    compare<interpolator::BackOut<>>("BackOut", in, exact, tabulated);
+    compare<interpolator::BounceOut<>>("BounceOut", in, exact, tabulated);
+    compare<interpolator::ElasticOut<>>("ElasticOut", in, exact, tabulated);
+    compare<interpolator::ExpoInOut<>>("ExpoInOut", in, exact, tabulated);
+    printf("\n");
+}
@@ -0,0 +1,151 @@
+#include "Benchmark.hpp"
+#include <Game.hpp>
+#include <Map.hpp>
+#include <Sprites.hpp>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace retro;
+using namespace glm;
+using namespace std;
+
+namespace {
+
+    const char* const paletteFile = "benchmark.gpl";
+    const char* const spritesFile = "benchmark.spr";
+    const char* const mapFile = "benchmark.map";
+    const char* const saveName = "benchmark";
+    const size_t iterations = 20;
+
+    class BenchmarkObject: public Object {
+    public:
+        BenchmarkObject(Game &game, Level &level, const vec2 &pos, const string name): Object(game, level, pos, name) {}
+        void setup() override {}
+        void update(float delta, GameActions &ga) override {}
+        void draw(GameActions &ga) override {}
+    };
+
+    class BenchmarkLevel: public Level {
+    public:
+        BenchmarkLevel(Game &game, const char* name): Level(game, name) {}
+        void setup() override {}
+        void update(float delta) override {}
+        void draw() override {}
+    };
+
+    class BenchmarkGame: public Game {
+    protected:
+        void setup() override {}
+        void cleanup() override {}
+
+    public:
+        BenchmarkGame(const Builder &builder): Game(builder) {}
+        using Game::importPalette;
+        using Game::addLevel;
+    };
+
+    //Files a bit bigger than the ones of a usual game: a 512x512 map with 2 layers,
+    //1024 sprites and a saved game with 1000 objects
+    void createFiles(BenchmarkGame &game) {
+        mt19937 random(42);
+
+        {
+            OutputFile o = game.openWriteFile(paletteFile, false);
+            string palette = "GIMP Palette\nName: Benchmark\nColumns: 16\n#\n";
+            for(int i = 1; i < 256; i++) palette += to_string(i) + " " + to_string(255 - i) + " " + to_string(i * 7 % 256) + "\tColour " + to_string(i) + "\n";
+            o.write(palette.c_str(), palette.size());
+            o.close();
+        }
+        game.importPalette(paletteFile);
+
+        {
+            remove((game.getGamePath() + spritesFile).c_str());
+            Sprites sprites(spritesFile, game);
+            while(sprites.size() < 1024) sprites.addSpritesRow();
+            //Half of the sprites are noise, the other half are flat shapes
+            TileRegion all = sprites.region({ { 0, 0 }, { 128, float(sprites.size() / 16 * 8) } });
+            for(size_t y = 0; y < all.size.y; y++) {
+                uint8_t* row = all.row(y);
+                for(size_t x = 0; x < all.size.x; x++) row[x] = y < all.size.y / 2 ? uint8_t(random() % 256) : uint8_t(1 + (x / 8 + y / 8) % 16);
+            }
+            sprites.save();
+
+            Map map = Map::createMap(mapFile, game, sprites, { 512, 512 });
+            map.addLayer({ 0.5f, 0.5f });
+            //Ground with some variation, and a sparse layer of decoration
+            MapRegion ground = map.region({ { 0, 0 }, { 512, 512 } }, 0);
+            MapRegion decoration = map.region({ { 0, 0 }, { 512, 512 } }, 1);
+            for(size_t y = 0; y < 512; y++) {
+                for(size_t x = 0; x < 512; x++) {
+                    ground.row(y)[x] = y < 200 ? 0 : uint16_t(y < 210 ? 16 : 32 + random() % 4);
+                    decoration.row(y)[x] = random() % 50 == 0 ? uint16_t(64 + random() % 64) : 0;
+                }
+            }
+            map.save();
+        }
+
+        auto &level = game.addLevel<BenchmarkLevel>("benchmark", true);
+        for(size_t i = 0; i < 1000; i++) {
+            level.addObject<BenchmarkObject>(vec2(random() % 4096, random() % 4096), "object" + to_string(i));
+        }
+        game.saveGame(saveName);
+    }
+
+    //How files were read before InputFile::readAll(), for comparison
+    size_t readWithStream(const string &path) {
+        ifstream file(path, ios::binary);
+        stringstream contents;
+        contents << file.rdbuf();
+        return contents.str().size();
+    }
+
+    void compareRead(BenchmarkGame &game, const char* name, const string &file) {
+        const string path = game.getGamePath() + file;
+        size_t size = 0;
+        const double stream = benchmark::run(iterations, [&] () { size = readWithStream(path); });
+        const double readAll = benchmark::run(iterations, [&] () {
+            InputFile i = game.openReadFile(file);
+            size = i.readAll().size();
+        });
+        printf("%-20s %10zu %10.3f %10.3f %8.2fx\n", name, size, stream * 1e3, readAll * 1e3, stream / readAll);
+    }
+
+    void printLoad(const char* name, double seconds) {
+        printf("%-20s %10.3f\n", name, seconds * 1e3);
+    }
+
+}
+
+void benchmark::loads() {
+    auto game = Game::Builder()
+        .setSize(320, 240)
+        .setName("retro++ benchmarks")
+        .setVisible(false)
+        .setGamePath("./")
+        .build<BenchmarkGame>();
+    createFiles(*game);
+
+    printf("Reading files (ms per file): ifstream + stringstream vs InputFile::readAll()\n");
+    printf("%-20s %10s %10s %10s %9s\n", "", "bytes", "stream", "readAll", "speedup");
+    compareRead(*game, "Palette", paletteFile);
+    compareRead(*game, "Sprites", spritesFile);
+    compareRead(*game, "Map", mapFile);
+    compareRead(*game, "Saved game", saveName + string(".save"));
+    printf("\n");
+
+    printf("Loading assets (ms per load)\n");
+    printLoad("Palette", benchmark::run(iterations, [&] () { game->importPalette(paletteFile); }));
+    printLoad("Sprites", benchmark::run(iterations, [&] () { Sprites sprites(spritesFile, *game); }));
+    printLoad("Map", benchmark::run(iterations, [&] () { Map map(mapFile, *game); }));
+    Map map(mapFile, *game);
+    printLoad("Map pixels", benchmark::run(iterations, [&] () { map.regeneratePixels(); }));
+    printLoad("Saved game", benchmark::run(iterations, [&] () { game->restoreGame(saveName); }));
+    printf("\n");
+
+    delete game;
+    for(auto file: { paletteFile, spritesFile, mapFile }) remove(file);
+    remove((saveName + string(".save")).c_str());
+}
@@ -0,0 +1,9 @@
+#include "Benchmark.hpp"
+
+using namespace retro;
+
+int main() {
+    benchmark::interpolators();
+    benchmark::loads();
+    return 0;
+}
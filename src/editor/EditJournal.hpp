@@ -0,0 +1,170 @@
+#ifndef retroeditor
+#error "Cannot include this file standalone, is a private implementation for the editor"
+#endif
+
+/// Undo and redo history of the changes done in a grid of cells of type `T` (map cells or sprite pixels).
+/// Every change is stored as runs of consecutive cells with the value before and after it,
+/// so a fill of a big area costs a few bytes per cell, and nothing is stored for the cells
+/// that didn't change.
+template<typename T>
+class EditJournal {
+
+    struct Run { uint32_t offset; uint32_t length; size_t bytes; };
+    struct Entry { size_t firstRun; size_t runs; uint32_t width; Frame area; };
+
+    vector<Run> runs;
+    vector<T> bytes; //Pairs of (before, after) for every cell of every run
+    vector<Entry> entries;
+    size_t position = 0;
+    bool open = false;
+    uvec2 changedStart = { 0, 0 }, changedEnd = { 0, 0 };
+
+    static void grow(Frame &area, const uvec2 &pos) {
+        if(area.size.x == 0) {
+            area = { pos, { 1, 1 } };
+        } else {
+            const vec2 start = glm::min(area.pos, vec2(pos));
+            const vec2 end = glm::max(area.pos + area.size, vec2(pos) + 1.0f);
+            area = { start, end - start };
+        }
+    }
+
+    void dropOldest() {
+        const Entry &first = entries.front();
+        const size_t dropBytes = first.runs > 0 ? runs[first.firstRun + first.runs - 1].bytes + 2 * runs[first.firstRun + first.runs - 1].length : 0;
+        const size_t dropRuns = first.firstRun + first.runs;
+        runs.erase(runs.begin(), runs.begin() + dropRuns);
+        bytes.erase(bytes.begin(), bytes.begin() + dropBytes);
+        for(auto &r: runs) r.bytes -= dropBytes;
+        entries.erase(entries.begin());
+        for(auto &e: entries) e.firstRun -= dropRuns;
+        position--;
+    }
+
+    void add(const uvec2 &pos, T before, T after) {
+        Entry &e = entries.back();
+        const uint32_t offset = pos.y * e.width + pos.x;
+        if(e.runs > 0 && runs.back().offset + runs.back().length == offset) {
+            runs.back().length++;
+        } else {
+            runs.push_back({ offset, 1, bytes.size() });
+            e.runs++;
+        }
+        bytes.push_back(before);
+        bytes.push_back(after);
+
+        grow(e.area, pos);
+        if(changedStart.x == changedEnd.x) {
+            changedStart = pos;
+            changedEnd = pos + 1u;
+        } else {
+            changedStart = glm::min(changedStart, pos);
+            changedEnd = glm::max(changedEnd, pos + 1u);
+        }
+    }
+
+    Frame apply(T* data, const Entry &e, bool forward) {
+        //A cell can be changed more than once in a change, so undoing goes backwards to end with its first value
+        if(forward) {
+            for(size_t r = e.firstRun; r < e.firstRun + e.runs; r++) {
+                const Run &run = runs[r];
+                for(uint32_t i = 0; i < run.length; i++) data[run.offset + i] = bytes[run.bytes + 2 * i + 1];
+            }
+        } else {
+            for(size_t r = e.firstRun + e.runs; r-- > e.firstRun;) {
+                const Run &run = runs[r];
+                for(uint32_t i = run.length; i-- > 0;) data[run.offset + i] = bytes[run.bytes + 2 * i];
+            }
+        }
+        return e.area;
+    }
+
+public:
+
+    size_t maxEntries = 100; ///< The oldest changes are forgotten
+
+    /// Starts a change. The changes that were undone cannot be redone anymore.
+    void begin(uint32_t width) {
+        if(open) end();
+        entries.resize(position);
+        const size_t nruns = entries.empty() ? 0 : entries.back().firstRun + entries.back().runs;
+        runs.resize(nruns);
+        bytes.resize(nruns == 0 ? 0 : runs.back().bytes + 2 * runs.back().length);
+        entries.push_back({ runs.size(), 0, width, {} });
+        position++;
+        open = true;
+    }
+
+    /// Returns true if a change has been started and not ended yet.
+    inline bool isOpen() const { return open; }
+
+    /// Changes the value of a cell and records it. Only works between begin() and end().
+    void set(T &cell, const uvec2 &pos, T value) {
+        if(!open || cell == value) return;
+        add(pos, cell, value);
+        cell = value;
+    }
+
+    /// Changes many cells at once with `op(region)`, and records the ones that changed.
+    /// `pos` is where the region starts in the grid. Only records between begin() and end().
+    template<typename Func>
+    void record(const BasicTileRegion<T> &region, const uvec2 &pos, Func &&op) {
+        vector<T> before(region.cells());
+        region.copyTo(before.data());
+        op(region);
+        if(!open) return;
+        for(uint32_t y = 0; y < region.size.y; y++) {
+            const T* old = before.data() + y * region.size.x;
+            const T* row = region.row(y);
+            if(memcmp(old, row, region.size.x * sizeof(T)) == 0) continue;
+            for(uint32_t x = 0; x < region.size.x; x++) {
+                if(old[x] != row[x]) add(pos + uvec2{ x, y }, old[x], row[x]);
+            }
+        }
+    }
+
+    /// Ends the change started with begin(). A change that did nothing is forgotten.
+    void end() {
+        if(!open) return;
+        open = false;
+        if(entries.back().runs == 0) {
+            entries.pop_back();
+            position--;
+        } else if(entries.size() > maxEntries) {
+            dropOldest();
+        }
+    }
+
+    /// Returns the cells that changed since the last call, to update only that part of the texture.
+    Frame takeChanged() {
+        const Frame area = { changedStart, changedEnd - changedStart };
+        changedStart = changedEnd = { 0, 0 };
+        return area;
+    }
+
+    /// Reverts the last change and returns the cells that changed, or an empty Frame if there's nothing to undo.
+    Frame undo(T* data) {
+        end();
+        if(position == 0) return {};
+        position--;
+        return apply(data, entries[position], false);
+    }
+
+    /// Applies again the last change undone and returns the cells that changed, or an empty Frame if there's nothing to redo.
+    Frame redo(T* data) {
+        end();
+        if(position == entries.size()) return {};
+        return apply(data, entries[position++], true);
+    }
+
+    /// Forgets everything, for example when the data is reloaded from the file.
+    void clear() {
+        runs.clear();
+        bytes.clear();
+        entries.clear();
+        position = 0;
+        open = false;
+        changedStart = changedEnd = { 0, 0 };
+    }
+
+};
@@ -18,6 +18,8 @@ using namespace retro;
 using namespace glm;
 using namespace std;
 
+#include "EditJournal.hpp"
+
 #include "SelectMapFileScreen.hpp"
 
 #include "CreateMapFileScreen.hpp"
@@ -9,7 +9,8 @@ protected:
     Map* map = nullptr;
     
     size_t spritesPage = 0;
-    uint8_t selectedSprite = 0;
+    uint16_t selectedSprite = 0;
+    size_t currentLayer = 0;
     
     bool savedPressedDone = false;
     
@@ -28,7 +29,9 @@ protected:
     Frame selection;
     
     bool copyPressedDone = false;
-    struct { uint8_t* pixels = nullptr; uvec2 size; } copyBuffer;
+    struct { uint16_t* pixels = nullptr; uvec2 size; } copyBuffer;
+    
+    EditJournal<uint16_t> journal;
     
     virtual void setup() override {
         redraw = true;
@@ -42,6 +45,8 @@ protected:
             if(diff.count() >= 4.0) {
                 this->notificationMessage = "";
                 redraw = true;
+            } else {
+                game().requestFrame(float(4.0 - diff.count()));
             }
         }
     }
@@ -51,28 +56,31 @@ protected:
     virtual void mouseDown(int button, int) override {
         const Frame canvasPos { { 0, 0 }, { 128, 52 } };
         const ivec2 pos = ga.getMousePosition();
+        const Map &cells = *map;
         if(button == SDL_BUTTON_LEFT) {
             if(mode == DRAW && canvasPos.isInside(pos)) {
                 ivec2 ppos = -mapPosition + ivec2(mouseCanvasPos / 8u);
-                map->at(ppos.x, ppos.y) = selectedSprite + 1;
-                map->regenerateTextures();
+                setCell(ppos, selectedSprite + 1);
+                updateTextures();
                 redraw = true;
             } else if(mode == FILL && canvasPos.isInside(pos)) {
                 ivec2 ppos = -mapPosition + ivec2(mouseCanvasPos / 8u);
-                if(map->at(ppos.x, ppos.y) != selectedSprite + 1) {
+                if(isInsideMap(ppos) && cells.at(ppos.x, ppos.y, currentLayer) != selectedSprite + 1) {
                     redraw = true;
-                    fill(ppos, map->at(ppos.x, ppos.y));
-                    map->regenerateTextures();
+                    fill(ppos, cells.at(ppos.x, ppos.y, currentLayer));
+                    journal.end();
+                    updateTextures();
                 }
             } else if(mode == RUBBER && canvasPos.isInside(pos)) {
                 ivec2 ppos = -mapPosition + ivec2(mouseCanvasPos / 8u);
-                if(map->at(ppos.x, ppos.y) != 0) {
-                    map->at(ppos.x, ppos.y) = 0;
-                    map->regenerateTextures();
+                if(isInsideMap(ppos) && cells.at(ppos.x, ppos.y, currentLayer) != 0) {
+                    setCell(ppos, 0);
+                    updateTextures();
                     redraw = true;
                 }
             } else if(mode == SELECT && canvasPos.isInside(pos)) {
                 ivec2 ppos = -mapPosition + ivec2(mouseCanvasPos / 8u);
+                if(!isInsideMap(ppos)) return;
                 hasSelection = true;
                 selection.pos = ppos;
                 selection.size = { 1, 1 };
@@ -93,6 +101,8 @@ protected:
         const ivec2 pos = ga.getMousePosition();
         
         if(button == SDL_BUTTON_LEFT) {
+            //A stroke is undone at once
+            journal.end();
             if(drawToolFrame.isInside(pos)) {
                 redraw = true;
                 mode = DRAW;
@@ -121,8 +131,9 @@ protected:
         } else if(button == SDL_BUTTON_RIGHT) {
             if(canvasPos.isInside(pos)) {
                 ivec2 ppos = -mapPosition + ivec2(mouseCanvasPos / 8u);
-                if(map->at(ppos.x, ppos.y) != 0) {
-                    selectedSprite = map->at(ppos.x, ppos.y) - 1;
+                const Map &cells = *map;
+                if(isInsideMap(ppos) && cells.at(ppos.x, ppos.y, currentLayer) != 0) {
+                    selectedSprite = cells.at(ppos.x, ppos.y, currentLayer) - 1;
                 }
                 redraw = true;
             }
@@ -147,9 +158,9 @@ protected:
                     int32_t distance = sqrt(diff.x*diff.x + diff.y*diff.y);
                     for(int32_t i = 0; i <= distance; i++) {
                         vec2 paintPos = vec2(lastPos) + diff * (float(i) / float(distance + 1));
-                        map->at(paintPos.x, paintPos.y) = mode == DRAW ? selectedSprite + 1 : 0;
+                        setCell(paintPos, mode == DRAW ? selectedSprite + 1 : 0);
                     }
-                    map->regenerateTextures();
+                    updateTextures();
                     static int ixD = 0;
                     printf("%d xD\n", ixD++);
                 } else if(ga.isMousePressed(SDL_BUTTON_LEFT) && mode == PAN) {
@@ -199,8 +210,21 @@ protected:
                 redraw = true;
                 map->reload();
                 map->regenerateTextures();
+                journal.clear();
+                currentLayer = std::min(currentLayer, map->getLayerCount() - 1);
                 notificationMessage = "Reloaded";
                 notificationStartTime = chrono::system_clock::now();
+            } else if(scancode == SDL_SCANCODE_L) {
+                //Adds a layer over the others and edits it
+                redraw = true;
+                try {
+                    currentLayer = map->addLayer();
+                    journal.clear();
+                    notificationMessage = "Layer " + to_string(currentLayer + 1) + " added";
+                } catch(const runtime_error &e) {
+                    notificationMessage = "Too many layers";
+                }
+                notificationStartTime = chrono::system_clock::now();
             } else if(scancode == SDL_SCANCODE_C && hasSelection && !copyPressedDone) {
                 if(selection.size.x < 0) {
                     selection.pos.x += selection.size.x + 1;
@@ -210,14 +234,10 @@ protected:
                     selection.pos.y += selection.size.y + 1;
                     selection.size.y *= -1.0f;
                 }
-                copyBuffer.pixels = (uint8_t*) realloc(copyBuffer.pixels, selection.size.x * selection.size.y);
-                copyBuffer.size = selection.size;
-                for(uint32_t y = selection.pos.y; y < selection.pos.y + selection.size.y; y++) {
-                    uint32_t row = (y - selection.pos.y) * uint32_t(selection.size.x);
-                    for(uint32_t x = selection.pos.x; x < selection.pos.x + selection.size.x; x++) {
-                        copyBuffer.pixels[row + x - uint32_t(selection.pos.x)] = map->at(x, y);
-                    }
-                }
+                const MapRegion region = map->region(selection, currentLayer);
+                copyBuffer.pixels = (uint16_t*) realloc(copyBuffer.pixels, region.cells() * sizeof(uint16_t));
+                copyBuffer.size = region.size;
+                region.copyTo(copyBuffer.pixels);
                 redraw = true;
                 copyPressedDone = true;
                 notificationMessage = "Copied";
@@ -228,18 +248,29 @@ protected:
                     pos = -mapPosition + ivec2(mouseCanvasPos / 8u);
                 }
                 if(0 <= pos.x && pos.x + copyBuffer.size.x <= map->getSize().x && 0 <= pos.y && pos.y + copyBuffer.size.y <= map->getSize().y) {
-                    for(uint32_t y = 0; y < copyBuffer.size.y; y++) {
-                        uint32_t row = y * uint32_t(copyBuffer.size.x);
-                        for(uint32_t x = 0; x < copyBuffer.size.x; x++) {
-                            map->at(pos.x + x, pos.y + y) = copyBuffer.pixels[row + x];
-                        }
-                    }
-                    map->regenerateTextures();
+                    editCells({ pos, copyBuffer.size }, [this] (const MapRegion &r) { r.paste(copyBuffer.pixels, copyBuffer.size); });
+                    redraw = true;
+                }
+            } else if(scancode == SDL_SCANCODE_Z || scancode == SDL_SCANCODE_Y) {
+                //Ctrl+Z undoes, Ctrl+Shift+Z or Ctrl+Y redoes
+                const bool undo = scancode == SDL_SCANCODE_Z && !ga.isModKeyPressed(KMOD_SHIFT);
+                const Frame changed = undo ? journal.undo(&map->at(0, 0, currentLayer)) : journal.redo(&map->at(0, 0, currentLayer));
+                if(changed.size.x > 0) {
+                    map->regenerateTextures(changed);
                     redraw = true;
                 }
             }
         }
         
+        if(scancode == SDL_SCANCODE_TAB && map->getLayerCount() > 1) {
+            //The history is of the cells of one layer
+            redraw = true;
+            journal.clear();
+            currentLayer = (currentLayer + 1) % map->getLayerCount();
+            notificationMessage = "Layer " + to_string(currentLayer + 1);
+            notificationStartTime = chrono::system_clock::now();
+        }
+        
         if(hasSelection) {
             if(selection.size.x < 0) {
                 selection.pos.x += selection.size.x + 1;
@@ -249,63 +280,48 @@ protected:
                 selection.pos.y += selection.size.y + 1;
                 selection.size.y *= -1.0f;
             }
+            const bool modifier = ga.isModKeyPressed(KMOD_CTRL) || ga.isModKeyPressed(KMOD_GUI);
             if(scancode == SDL_SCANCODE_LEFT && selection.pos.x > 0.9f) {
                 redraw = true;
-                for(size_t y = selection.pos.y; y < selection.pos.y + selection.size.y; y++) {
-                    for(int64_t x = selection.pos.x; x < selection.pos.x + selection.size.x; x++) {
-                        map->at(x - 1, y) = map->at(x, y);
-                    }
-                    map->at(selection.pos.x + selection.size.x - 1, y) = 0;
-                }
+                editCells({ selection.pos - vec2{ 1, 0 }, selection.size + vec2{ 1, 0 } }, [] (const MapRegion &r) { r.shift({ -1, 0 }); });
                 selection.pos -= vec2{ 1, 0 };
-                map->regenerateTextures();
             } else if(scancode == SDL_SCANCODE_RIGHT && selection.pos.x + selection.size.x < map->getSize().x) {
                 redraw = true;
-                for(size_t y = selection.pos.y; y < selection.pos.y + selection.size.y; y++) {
-                    for(int64_t x = selection.pos.x + selection.size.x - 1; x >= selection.pos.x; x--) {
-                        map->at(x + 1, y) = map->at(x, y);
-                    }
-                    map->at(selection.pos.x, y) = 0;
-                }
+                editCells({ selection.pos, selection.size + vec2{ 1, 0 } }, [] (const MapRegion &r) { r.shift({ 1, 0 }); });
                 selection.pos += vec2{ 1, 0 };
-                map->regenerateTextures();
             } else if(scancode == SDL_SCANCODE_UP && selection.pos.y > 0.9f) {
                 redraw = true;
-                for(int64_t x = selection.pos.x; x < selection.pos.x + selection.size.x; x++) {
-                    for(size_t y = selection.pos.y; y < selection.pos.y + selection.size.y; y++) {
-                        map->at(x, y - 1) = map->at(x, y);
-                    }
-                    map->at(x, selection.pos.y + selection.size.y - 1) = 0;
-                }
+                editCells({ selection.pos - vec2{ 0, 1 }, selection.size + vec2{ 0, 1 } }, [] (const MapRegion &r) { r.shift({ 0, -1 }); });
                 selection.pos -= vec2{ 0, 1 };
-                map->regenerateTextures();
             } else if(scancode == SDL_SCANCODE_DOWN && selection.pos.y + selection.size.y < map->getSize().y) {
                 redraw = true;
-                for(size_t x = selection.pos.x; x < selection.pos.x + selection.size.x; x++) {
-                    for(int64_t y = selection.pos.y + selection.size.y - 1; y >= selection.pos.y; y--) {
-                        map->at(x, y + 1) = map->at(x, y);
-                    }
-                    map->at(x, selection.pos.y) = 0;
-                }
+                editCells({ selection.pos, selection.size + vec2{ 0, 1 } }, [] (const MapRegion &r) { r.shift({ 0, 1 }); });
                 selection.pos += vec2{ 0, 1 };
-                map->regenerateTextures();
+            } else if(scancode == SDL_SCANCODE_H && !modifier) {
+                redraw = true;
+                editCells(selection, [] (const MapRegion &r) { r.flipHorizontal(); });
+            } else if(scancode == SDL_SCANCODE_V && !modifier) {
+                redraw = true;
+                editCells(selection, [] (const MapRegion &r) { r.flipVertical(); });
+            } else if(scancode == SDL_SCANCODE_R && !modifier && selection.size.x == selection.size.y) {
+                //Shift+R rotates counter-clockwise
+                redraw = true;
+                const bool clockwise = !ga.isModKeyPressed(KMOD_SHIFT);
+                editCells(selection, [clockwise] (const MapRegion &r) { r.rotate(clockwise); });
             } else if(scancode == SDL_SCANCODE_ESCAPE) {
                 hasSelection = false;
                 redraw = true;
             } else if(scancode == SDL_SCANCODE_DELETE) {
-                for(uint32_t y = selection.pos.y; y < selection.pos.y + selection.size.y; y++) {
-                    for(uint32_t x = selection.pos.x; x < selection.pos.x + selection.size.x; x++) {
-                        map->at(x, y) = 0;
-                    }
-                }
+                editCells(selection, [] (const MapRegion &r) { r.fill(0); });
                 redraw = true;
-                map->regenerateTextures();
             }
         }
     }
     
     virtual bool predraw() override { return redraw; }
     
+    virtual bool renderOnDemand() override { return true; }
+    
     virtual void draw() override {
         ga.fillRectangle({ { 0, 0 }, { 128, 52 } }, { 0, 0, 0, 0xFF });
         ga.fillRectangle({ { 0, 52 }, { 128, 4 } }, { 0x4F, 0x5A, 0x69, 0xFF });
@@ -466,16 +482,61 @@ protected:
         redraw = false;
     }
     
-    void fill(const uvec2 &pos, uint8_t sprite) {
-        if(map->at(pos.x, pos.y) == sprite) {
-            map->at(pos.x, pos.y) = selectedSprite + 1;
-            if(pos.x + 1 < map->getSize().x) fill(pos + uvec2{ 1, 0 }, sprite);
-            if(pos.x > 0) fill(pos - uvec2{ 1, 0 }, sprite);
-            if(pos.y + 1 < map->getSize().y) fill(pos + uvec2{ 0, 1 }, sprite);
-            if(pos.y > 0) fill(pos - uvec2{ 0, 1 }, sprite);
+    void fill(const uvec2 &pos, uint16_t sprite) {
+        //Fills whole rows, and remembers only where the runs to fill start in the rows above and below
+        const Map &cells = *map;
+        const uvec2 size = cells.getSize();
+        const uint16_t newSprite = selectedSprite + 1;
+        if(sprite == newSprite) return;
+        vector<uvec2> pending = { pos };
+        while(!pending.empty()) {
+            const uvec2 p = pending.back();
+            pending.pop_back();
+            if(cells.at(p.x, p.y, currentLayer) != sprite) continue;
+            
+            uint32_t left = p.x, right = p.x;
+            while(left > 0 && cells.at(left - 1, p.y, currentLayer) == sprite) left--;
+            while(right + 1 < size.x && cells.at(right + 1, p.y, currentLayer) == sprite) right++;
+            for(uint32_t x = left; x <= right; x++) setCell({ x, p.y }, newSprite);
+            
+            for(uint32_t y: { p.y - 1, p.y + 1 }) {
+                if(y >= size.y) continue; //Also when p.y - 1 underflows
+                bool inRun = false;
+                for(uint32_t x = left; x <= right; x++) {
+                    const bool matches = cells.at(x, y, currentLayer) == sprite;
+                    if(matches && !inRun) pending.push_back({ x, y });
+                    inRun = matches;
+                }
+            }
         }
     }
     
+    bool isInsideMap(const ivec2 &pos) const {
+        return pos.x >= 0 && pos.y >= 0 && uint32_t(pos.x) < map->getSize().x && uint32_t(pos.y) < map->getSize().y;
+    }
+    
+    void setCell(const ivec2 &pos, uint16_t sprite) {
+        if(!isInsideMap(pos)) return;
+        if(!journal.isOpen()) journal.begin(map->getSize().x);
+        journal.set(map->at(pos.x, pos.y, currentLayer), uvec2(pos), sprite);
+    }
+    
+    void updateTextures() {
+        const Frame changed = journal.takeChanged();
+        if(changed.size.x > 0) map->regenerateTextures(changed);
+    }
+    
+    template<typename Func>
+    void editCells(const Frame &cells, Func &&op) {
+        //The position of the region once it is clipped to the map
+        const uvec2 pos = glm::min(uvec2(glm::max(cells.pos, vec2(0))), map->getSize());
+        journal.end();
+        journal.begin(map->getSize().x);
+        journal.record(map->region(cells, currentLayer), pos, op);
+        journal.end();
+        updateTextures();
+    }
+    
     void doMoveMap(const vec2 &d) {
         mapPosAccum += d * 2.0f;
         mapPosAccum.x = glm::min(mapPosAccum.x, 4.0f * 8.0f);
@@ -491,6 +552,8 @@ public:
     
     void setStuff(Map &map) {
         this->map = &map;
+        currentLayer = 0;
+        journal.clear();
     }
     
 };
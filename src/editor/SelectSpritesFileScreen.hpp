@@ -60,6 +60,8 @@ protected:
     
     virtual bool predraw() override { return redraw; }
     
+    virtual bool renderOnDemand() override { return true; }
+    
     virtual void draw() override {
         uvec2 size = ga.canvasSize();
         ga.fillRectangle({ { 0, 0 }, ga.canvasSize() }, { 0x4F, 0x5A, 0x69, 0xFF });
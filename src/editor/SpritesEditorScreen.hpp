@@ -26,6 +26,7 @@ protected:
     uint8_t drawSize = 1;
     bool copyPressedDone = false;
     struct { uint8_t* pixels = nullptr; uvec2 size; } copyBuffer;
+    EditJournal<uint8_t> journal;
     
     bool redraw = true;
     
@@ -69,18 +70,19 @@ protected:
                             this->redraw = true;
                             for(size_t extraX = pos.x; extraX < std::min(pos.x + drawSize, float(selectedSpriteSize)); extraX++) {
                                 for(size_t extraY = pos.y; extraY < std::min(pos.y + drawSize, float(selectedSpriteSize)); extraY++) {
-                                    sprite.at(extraX, extraY) = this->selectedColor;
+                                    setPixel(sprite, { extraX, extraY }, this->selectedColor);
                                 }
                             }
                         }
                     }
-                    sprites->regenerateTextures();
+                    updateTextures();
                 } else if(this->mode == FILL) {
                     uint8_t col = (*sprites)[this->selectedSprite].at(canvasPos.x, canvasPos.y);
                     if(col != this->selectedColor) {
                         this->redraw = true;
                         fill(canvasPos, col);
-                        sprites->regenerateTextures();
+                        journal.end();
+                        updateTextures();
                     }
                 } else if(this->mode == SELECT) {
                     if(!this->selection) {
@@ -103,6 +105,8 @@ protected:
             if(diff.count() >= 4.0) {
                 this->notificationMessage = "";
                 redraw = true;
+            } else {
+                game().requestFrame(float(4.0 - diff.count()));
             }
         }
     }
@@ -125,15 +129,10 @@ protected:
                 sel.size /= m * 2.0f;
                 if(sel.size.x < 0) { sel.pos.x += sel.size.x; sel.size.x *= -1; }
                 if(sel.size.y < 0) { sel.pos.y += sel.size.y; sel.size.y *= -1; }
-                size_t size = sel.size.x * sel.size.y;
-                copyBuffer.pixels = (uint8_t*) realloc(copyBuffer.pixels, size);
-                copyBuffer.size = sel.size;
-                for(uint32_t y = sel.pos.y; y < sel.pos.y + sel.size.y; y++) {
-                    uint32_t row = (y - sel.pos.y) * uint32_t(sel.size.x);
-                    for(uint32_t x = sel.pos.x; x < sel.pos.x + sel.size.x; x++) {
-                        copyBuffer.pixels[row + x - uint32_t(sel.pos.x)] = sprite.at(x, y);
-                    }
-                }
+                const TileRegion region = sprite.region().sub(uvec2(glm::max(sel.pos, vec2(0))), uvec2(sel.size));
+                copyBuffer.pixels = (uint8_t*) realloc(copyBuffer.pixels, region.cells());
+                copyBuffer.size = region.size;
+                region.copyTo(copyBuffer.pixels);
                 redraw = true;
                 copyPressedDone = true;
                 notificationMessage = "Copied";
@@ -146,16 +145,17 @@ protected:
                     if(selectedSpriteSize == 8) pos /= 4;
                     if(selectedSpriteSize == 16)pos /= 2;
                 }
-                for(uint32_t y = 0; y < copyBuffer.size.y; y++) {
-                    uint32_t row = y * uint32_t(copyBuffer.size.x);
-                    for(uint32_t x = 0; x < copyBuffer.size.x; x++) {
-                        if(pos.x + x < sprite.width && pos.y + y < sprite.height) {
-                            sprite.at(pos.x + x, pos.y + y) = copyBuffer.pixels[row + x];
-                        }
-                    }
-                }
-                sprites->regenerateTextures();
+                editPixels(sprite, { vec2(pos), vec2(copyBuffer.size) }, [this] (const TileRegion &r) { r.paste(copyBuffer.pixels, copyBuffer.size); });
                 redraw = true;
+            } else if(scancode == SDL_SCANCODE_Z || scancode == SDL_SCANCODE_Y) {
+                //Ctrl+Z undoes, Ctrl+Shift+Z or Ctrl+Y redoes
+                uint8_t* data = &(*sprites)[0].at(0, 0);
+                const bool undo = scancode == SDL_SCANCODE_Z && !ga.isModKeyPressed(KMOD_SHIFT);
+                const Frame changed = undo ? journal.undo(data) : journal.redo(data);
+                if(changed.size.x > 0) {
+                    sprites->regenerateTextures(changed);
+                    redraw = true;
+                }
             }
         }
         
@@ -171,13 +171,34 @@ protected:
             sel.size /= m * 2.0f;
             if(sel.size.x < 0) { sel.pos.x += sel.size.x; sel.size.x *= -1; }
             if(sel.size.y < 0) { sel.pos.y += sel.size.y; sel.size.y *= -1; }
-            for(uint32_t y = sel.pos.y; y < sel.pos.y + sel.size.y; y++) {
-                for(uint32_t x = sel.pos.x; x < sel.pos.x + sel.size.x; x++) {
-                    sprite.at(x, y) = 0;
-                }
-            }
-            sprites->regenerateTextures();
+            editPixels(sprite, sel, [] (const TileRegion &r) { r.fill(0); });
             redraw = true;
+        } else if(!ga.isModKeyPressed(KMOD_CTRL) && !ga.isModKeyPressed(KMOD_GUI) &&
+                  (scancode == SDL_SCANCODE_H || scancode == SDL_SCANCODE_V || scancode == SDL_SCANCODE_R)) {
+            //Flips or rotates the selection, or the whole sprite if there's nothing selected
+            Sprite sprite = (*sprites)[selectedSprite].size(selectedSpriteSize);
+            Frame sel = { { 0, 0 }, sprite.frame().size };
+            if(this->selection) {
+                sel = selectedRegionGood();
+                float m = 32.0f / this->selectedSpriteSize;
+                sel.pos -= vec2{ 12, 4 };
+                sel.pos /= m * 2.0f;
+                sel.size /= m * 2.0f;
+                if(sel.size.x < 0) { sel.pos.x += sel.size.x; sel.size.x *= -1; }
+                if(sel.size.y < 0) { sel.pos.y += sel.size.y; sel.size.y *= -1; }
+            }
+            if(scancode == SDL_SCANCODE_H) {
+                editPixels(sprite, sel, [] (const TileRegion &r) { r.flipHorizontal(); });
+                redraw = true;
+            } else if(scancode == SDL_SCANCODE_V) {
+                editPixels(sprite, sel, [] (const TileRegion &r) { r.flipVertical(); });
+                redraw = true;
+            } else if(uvec2(sel.size).x == uvec2(sel.size).y) {
+                //Shift+R rotates counter-clockwise
+                const bool clockwise = !ga.isModKeyPressed(KMOD_SHIFT);
+                editPixels(sprite, sel, [clockwise] (const TileRegion &r) { r.rotate(clockwise); });
+                redraw = true;
+            }
         }
         
         if(this->selection) {
@@ -192,42 +213,21 @@ protected:
             if(this->selectedSpriteSize == 64) m = 1.0f;
             if(scancode == SDL_SCANCODE_LEFT && selection.pos.x > 0.9f) {
                 redraw = true;
-                for(size_t y = selection.pos.y; y < selection.pos.y + selection.size.y; y++) {
-                    for(int64_t x = selection.pos.x; x < selection.pos.x + selection.size.x; x++) {
-                        sprite.at(x - 1, y) = sprite.at(x, y);
-                    }
-                    sprite.at(selection.pos.x + selection.size.x - 1, y) = 0;
-                }
+                editPixels(sprite, { selection.pos - vec2{ 1, 0 }, selection.size + vec2{ 1, 0 } }, [] (const TileRegion &r) { r.shift({ -1, 0 }); });
                 this->selectedRegion.pos -= vec2{ m, 0 };
             } else if(scancode == SDL_SCANCODE_RIGHT && selection.pos.x + selection.size.x < spriteFrame.size.x) {
                 redraw = true;
-                for(size_t y = selection.pos.y; y < selection.pos.y + selection.size.y; y++) {
-                    for(int64_t x = selection.pos.x + selection.size.x - 1; x >= selection.pos.x; x--) {
-                        sprite.at(x + 1, y) = sprite.at(x, y);
-                    }
-                    sprite.at(selection.pos.x, y) = 0;
-                }
+                editPixels(sprite, { selection.pos, selection.size + vec2{ 1, 0 } }, [] (const TileRegion &r) { r.shift({ 1, 0 }); });
                 this->selectedRegion.pos += vec2{ m, 0 };
-            } if(scancode == SDL_SCANCODE_UP && selection.pos.y > 0.9f) {
+            } else if(scancode == SDL_SCANCODE_UP && selection.pos.y > 0.9f) {
                 redraw = true;
-                for(int64_t x = selection.pos.x; x < selection.pos.x + selection.size.x; x++) {
-                    for(size_t y = selection.pos.y; y < selection.pos.y + selection.size.y; y++) {
-                        sprite.at(x, y - 1) = sprite.at(x, y);
-                    }
-                    sprite.at(x, selection.pos.y + selection.size.y - 1) = 0;
-                }
+                editPixels(sprite, { selection.pos - vec2{ 0, 1 }, selection.size + vec2{ 0, 1 } }, [] (const TileRegion &r) { r.shift({ 0, -1 }); });
                 this->selectedRegion.pos -= vec2{ 0, m };
             } else if(scancode == SDL_SCANCODE_DOWN && selection.pos.y + selection.size.y < spriteFrame.size.y) {
                 redraw = true;
-                for(size_t x = selection.pos.x; x < selection.pos.x + selection.size.x; x++) {
-                    for(int64_t y = selection.pos.y + selection.size.y - 1; y >= selection.pos.y; y--) {
-                        sprite.at(x, y + 1) = sprite.at(x, y);
-                    }
-                    sprite.at(x, selection.pos.y) = 0;
-                }
+                editPixels(sprite, { selection.pos, selection.size + vec2{ 0, 1 } }, [] (const TileRegion &r) { r.shift({ 0, 1 }); });
                 this->selectedRegion.pos += vec2{ 0, m };
             }
-            sprites->regenerateTextures();
         }
     }
     
@@ -240,6 +240,7 @@ protected:
         } else if((ga.isModKeyPressed(KMOD_CTRL) || ga.isModKeyPressed(KMOD_GUI)) && scancode == SDL_SCANCODE_R) {
             this->sprites->reload();
             this->sprites->regenerateTextures();
+            this->journal.clear();
             this->redraw = true;
             this->notificationMessage = "Reloaded";
             this->notificationStartTime = chrono::system_clock::now();
@@ -284,6 +285,8 @@ protected:
         
         if(button == SDL_BUTTON_LEFT) {
             this->redraw = true;
+            //A stroke is undone at once
+            journal.end();
             if(drawToolFrame.isInside(pos)) mode = DRAW; else
                 if(fillToolFrame.isInside(pos)) mode = FILL; else
                     if(selectToolFrame.isInside(pos)) mode = SELECT; else
@@ -355,6 +358,8 @@ protected:
     
     virtual bool predraw() override { return redraw; }
     
+    virtual bool renderOnDemand() override { return true; }
+    
     virtual void draw() override {
         ga.fillRectangle({ { 0, 0 }, ga.canvasSize() }, { 0x4F, 0x5A, 0x69, 0xFF });
         
@@ -612,16 +617,58 @@ protected:
     }
     
     void fill(const uvec2 &canvasPos, uint8_t fromCol) {
-        auto sprite = (*sprites)[this->selectedSprite].size(this->selectedSpriteSize);
-        if(sprite.at(canvasPos.x, canvasPos.y) == fromCol) {
-            sprite.at(canvasPos.x, canvasPos.y) = this->selectedColor;
-            if(canvasPos.x + 1 < sprite.frame().size.x) fill(canvasPos + uvec2{ 1, 0 }, fromCol);
-            if(canvasPos.x > 0) fill(canvasPos - uvec2{ 1, 0 }, fromCol);
-            if(canvasPos.y + 1 < sprite.frame().size.y) fill(canvasPos + uvec2{ 0, 1 }, fromCol);
-            if(canvasPos.y > 0) fill(canvasPos - uvec2{ 0, 1 }, fromCol);
+        //Fills whole rows, and remembers only where the runs to fill start in the rows above and below
+        const auto sprite = (*sprites)[this->selectedSprite].size(this->selectedSpriteSize);
+        const uvec2 size = sprite.frame().size;
+        if(fromCol == this->selectedColor) return;
+        vector<uvec2> pending = { canvasPos };
+        while(!pending.empty()) {
+            const uvec2 p = pending.back();
+            pending.pop_back();
+            if(sprite.at(p.x, p.y) != fromCol) continue;
+            
+            uint32_t left = p.x, right = p.x;
+            while(left > 0 && sprite.at(left - 1, p.y) == fromCol) left--;
+            while(right + 1 < size.x && sprite.at(right + 1, p.y) == fromCol) right++;
+            for(uint32_t x = left; x <= right; x++) setPixel(sprite, { x, p.y }, this->selectedColor);
+            
+            for(uint32_t y: { p.y - 1, p.y + 1 }) {
+                if(y >= size.y) continue; //Also when p.y - 1 underflows
+                bool inRun = false;
+                for(uint32_t x = left; x <= right; x++) {
+                    const bool matches = sprite.at(x, y) == fromCol;
+                    if(matches && !inRun) pending.push_back({ x, y });
+                    inRun = matches;
+                }
+            }
         }
     }
     
+    void setPixel(const Sprite &sprite, const uvec2 &pos, uint8_t color) {
+        //The journal works with the whole file, 16 sprites per row
+        if(!journal.isOpen()) journal.begin(8 * 16);
+        const uvec2 filePos = { (sprite.index % 16) * 8 + pos.x, (sprite.index / 16) * 8 + pos.y };
+        journal.set(sprite.at(pos.x, pos.y), filePos, color);
+    }
+    
+    void updateTextures() {
+        const Frame changed = journal.takeChanged();
+        if(changed.size.x > 0) sprites->regenerateTextures(changed);
+    }
+    
+    template<typename Func>
+    void editPixels(const Sprite &sprite, const Frame &pixels, Func &&op) {
+        //The region is clipped to the sprite, and the journal needs where it starts in the file
+        const Frame spriteFrame = sprite.frame();
+        const uvec2 pos = glm::min(uvec2(glm::max(pixels.pos, vec2(0))), uvec2(spriteFrame.size));
+        const TileRegion region = sprite.region().sub(pos, uvec2(glm::max(pixels.pos + pixels.size, vec2(pos)) - vec2(pos)));
+        journal.end();
+        journal.begin(8 * 16);
+        journal.record(region, uvec2(spriteFrame.pos) + pos, op);
+        journal.end();
+        updateTextures();
+    }
+    
     Frame selectedRegionGood() {
         Frame f;
         float m = 32.0f / this->selectedSpriteSize;
@@ -726,6 +773,6 @@ protected:
 public:
     
     SpritesEditorScreen(Game &game, const char* name): Level(game, name) {}
-    void setSprites(Sprites* sp) { this->sprites = sp; }
+    void setSprites(Sprites* sp) { this->sprites = sp; journal.clear(); }
     
 };
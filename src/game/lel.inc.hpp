@@ -138,6 +138,8 @@ public:
         spr.draw(frame.pos - vec2{ 3, 3 });
     }
 
+    Frame getDrawBounds() const override { return { frame.pos - vec2{ 3, 3 }, { 8, 8 } }; }
+
     void setSprites(Sprites &sprites) {
         frame.size = { 3, 3 };
 
@@ -237,7 +239,7 @@ protected:
     virtual void update(float delta) override {
         i++;
         Coquein& player = *getObjectByName<Coquein>("player");
-        MapObject& map = *getObjectByName<MapObject>("sitt");
+        const MapObject& map = *getObjectByName<MapObject>("sitt");
         const auto position = [&map, this] (const vec2 &pos) -> vec2 {
             return max(vec2{ 0, 0 }, min(pos - vec2(ga.canvasSize() / 2u), map.getFrame().size));
         };
@@ -248,7 +250,7 @@ protected:
             cameraAnimation.updateFinalValue(player.getFrame().pos);
         }
 
-        uint8_t m = map.at(player.getFrame().pos / 8.0f);
+        uint16_t m = map.at(player.getFrame().pos / 8.0f);
         if(m == 2 || m == 3 || m == 4 || m == 5) {
             cameraAnimation = Animation<vec2>(interpolator::CubicInOut<>(), .5, player.getFrame().pos, vec2{ 64, 64 }, [this, position] (const vec2 &v) {
                 ga.camera(position(v));
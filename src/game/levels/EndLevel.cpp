@@ -2,9 +2,13 @@
 
 using namespace hw;
 
+void EndLevel::preload() {
+    //Packed into the atlas when uploaded, the region is released when the level is deleted
+    assets.preloadImage("hwl.png", Image::Undefined, true);
+}
+
 void EndLevel::setup() {
-    logo = Image::loadImage("hwl.png", game());
-    logo->generateAndDestroy();
+    logo = assets.getImage("hwl.png", Image::Undefined, true);
 
     game().getAudio().loadMusic("endtheme.ogg");
 
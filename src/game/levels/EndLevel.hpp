@@ -22,6 +22,8 @@ namespace hw {
         Timeline tl;
 
     protected:
+        void preload() override;
+
         void setup() override;
 
         void update(float delta) override;
@@ -22,11 +22,17 @@ public:
         sprite.draw({ frame.pos - desp, {1,1} });
     }
 
+    Frame getDrawBounds() const override { return { frame.pos - desp, { 8, 8 } }; }
+
     const Frame& getFrame() const override { return frame; }
 };
 
 constexpr vec2 dialogPos = { 100, 50 };
 
+void FirstLevel::preload() {
+    assets.preloadMap("first.map");
+}
+
 void FirstLevel::setup() {
     auto &map = addObject<MapObject>({ 0, 0 }, "first.map"); //1
     auto &player = addObject<DaPlayer>({ 10, 10 }, "player"); //1
@@ -55,8 +61,8 @@ void FirstLevel::setup() {
                 "Buuuut, this game is programmed to open doors adjacent to you"s,
                 "So doors will open automagically. Move on! Don't be a Schweinehund!"s
             });
-            map.at(19, 2) = 29;
-            map.regenerateTextures();
+            map.set(19, 2, 29);
+            map.regenerateTextures({ { 19, 2 }, { 1, 1 } });
             player.setDisabled(true);
             playerHaveReceivedTheBeautifulIntroductionOfDoors = true;
             game().getAudio().playSample("Open Door");
@@ -64,8 +70,8 @@ void FirstLevel::setup() {
     });
     det1.setOnCollisionEndListener([this, &map] (auto &player, auto face, auto &col) {
         if(player.getFrame().pos.y >= 3*8) {
-            map.at(19, 2) = 45;
-            map.regenerateTextures();
+            map.set(19, 2, 45);
+            map.regenerateTextures({ { 19, 2 }, { 1, 1 } });
             game().getAudio().playSample("Close Door");
         }
     });
@@ -73,16 +79,16 @@ void FirstLevel::setup() {
     det2.setFrame({ { 7*8, 17*8 - 1 }, { 8, 9 } });
     det2.setOnCollisionStartListener([this, &map] (auto &player, auto face, auto &col) {
         if(player.getFrame().pos.y > 17*8) {
-            map.at(7, 16) = 65;
-            map.regenerateTextures();
+            map.set(7, 16, 65);
+            map.regenerateTextures({ { 7, 16 }, { 1, 1 } });
             player.setDisabled(true);
             game().getAudio().playSample("Open Door");
         }
     });
     det2.setOnCollisionEndListener([this, &map] (auto &player, auto face, auto &col) {
         if(player.getFrame().pos.y <= 17*8) {
-            map.at(7, 16) = 73;
-            map.regenerateTextures();
+            map.set(7, 16, 73);
+            map.regenerateTextures({ { 7, 16 }, { 1, 1 } });
             game().getAudio().playSample("Close Door");
         }
     });
@@ -98,8 +104,8 @@ void FirstLevel::setup() {
             });
             player.setDisabled(true);
         } else {
-            map.at(8, 16) = 73;
-            map.regenerateTextures();
+            map.set(8, 16, 73);
+            map.regenerateTextures({ { 8, 16 }, { 1, 1 } });
             addObject<Dialog>(dialogPos, "dialog1", initializer_list<string> {
                 "The two key pieces opens the door. You can continue your travel in this world."s,
                 "[Player] Why I had to search for this broken key? The door has opened, although I couldn't fix the key."s,
@@ -116,10 +122,10 @@ void FirstLevel::setup() {
     det4.setFrame({ { 11*8 + 4, 15*8 }, { 1, 8*3 } });
     det4.setOnCollisionEndListener([this, &map] (auto &player, auto face, auto &col) {
         if(player.getFrame().pos.x > 11*8 + 4.5f) {
-            map.at(11, 15) = 75;
-            map.at(11, 16) = 75;
-            map.at(11, 17) = 75;
-            map.regenerateTextures();
+            map.set(11, 15, 75);
+            map.set(11, 16, 75);
+            map.set(11, 17, 75);
+            map.regenerateTextures({ { 11, 15 }, { 1, 3 } });
             addObject<Dialog>(dialogPos, "dialog1", initializer_list<string> {
                 "[Player] Oh fuck. I cannot go back…"s
             });
@@ -194,7 +200,7 @@ void FirstLevel::setup() {
 
 bool FirstLevel::preupdate(float delta) {
     DaPlayer &player = *getObjectByName<DaPlayer>("player"); //2
-    MapObject &map = *getObjectByName<MapObject>("first");
+    const MapObject &map = *getObjectByName<MapObject>("first");
     const auto pixelAt = [&map] (float xx, float yy) {
         uint32_t x = floor(xx);
         uint32_t y = floor(yy);
@@ -208,7 +214,7 @@ bool FirstLevel::preupdate(float delta) {
 
 void FirstLevel::update(float delta) {
     DaPlayer &player = *getObjectByName<DaPlayer>("player"); //1
-    MapObject &map = *getObjectByName<MapObject>("first");
+    const MapObject &map = *getObjectByName<MapObject>("first");
     const auto position = [&map, this] (const vec2 &pos) {
         return max(vec2{ 0, 0 }, min(pos - vec2(ga.canvasSize() / 2u), map.getFrame().size));
     };
@@ -219,7 +225,7 @@ void FirstLevel::update(float delta) {
         cameraAnimation.animate(delta);//2
     }
 
-    uint8_t m = map.at((player.getFrame().pos + player.getFrame().size / 2.0f) / 8.0f); //2
+    uint16_t m = map.at((player.getFrame().pos + player.getFrame().size / 2.0f) / 8.0f); //2
     if(cameraAnimation.isCompleted() && (m == 14 || m == 30 || m == 46 || m == 62)) {
         auto it = portals.find(uvec2(player.getFrame().pos) / 8u);
         if(it != portals.end()) {
@@ -248,6 +254,7 @@ void FirstLevel::update(float delta) {
                                                         this->fadeOutAlpha = f;
                                                     });
                 player.setDisabled(true);
+                game().preloadLevel("endLevel");
             } else {
                 game().changeLevel("endLevel");
             }
@@ -270,8 +277,8 @@ void FirstLevel::keyUp(int scancode) { //7
     if(stuckInThatShitAndHasToSmashTheKeyboard) {
         if(inventory.size() == 1) {
             if(scancode == SDL_SCANCODE_F) {
-                getObjectByName<MapObject>("first")->at(20, 16) = 14;
-                getObjectByName<MapObject>("first")->regenerateTextures();
+                getObjectByName<MapObject>("first")->set(20, 16, 14);
+                getObjectByName<MapObject>("first")->regenerateTextures({ { 20, 16 }, { 1, 1 } });
                 if(rand() % 2) {
                     portals[{ 20, 16 }] = { 19, 13 };
                 } else {
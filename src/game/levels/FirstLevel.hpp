@@ -32,6 +32,8 @@ namespace hw {
         int keysSmashed = 0;
         float fadeOutAlpha = 0.0f;
     protected:
+        void preload() override;
+
         void setup() override;
 
         void keyUp(int scancode) override;
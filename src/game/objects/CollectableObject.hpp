@@ -26,6 +26,7 @@ namespace hw {
             desp(desp) {}
 
         void draw(GameActions &ga) override;
+        Frame getDrawBounds() const override { return { frame.pos - vec2(desp), { 8, 8 } }; }
         void drawForUI(GameActions &ga);
 
     };
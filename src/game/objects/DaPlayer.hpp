@@ -34,6 +34,8 @@ namespace hw {
 
         void draw(GameActions& ga) override;
 
+        Frame getDrawBounds() const override { return { frame.pos - vec2{ 3, 3 }, { 8, 8 } }; }
+
         void setSprites(const Sprites &sprites);
 
         void collisionWithMapSprite(const function<uint8_t(float, float)> &pixelAt, uint8_t prohibitedColor);
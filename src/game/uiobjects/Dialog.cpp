@@ -42,6 +42,12 @@ void Dialog::setup() {
 void Dialog::update(float delta, GameActions &ga) {
     UIObject::update(delta, ga);
     if(!aparecer.isCompleted()) aparecer.animate(delta);
+    //The arrow is not part of the text, so the dialog must be drawn again when it appears
+    bool showArrow = aparecer.isCompleted() && pagina < paginas.size() - 1;
+    if(showArrow != arrowShown) {
+        arrowShown = showArrow;
+        invalidate();
+    }
 }
 
 void Dialog::addPage(std::string &&str) {
@@ -71,8 +77,8 @@ bool Dialog::hasNextPage() {
 void Dialog::draw(GameActions &ga) {
     ga.fillRectangle({ { 0, 0 }, getTextSize() }, 0x33333377_rgba);
     renderText(ga);
-    if(aparecer.isCompleted() && pagina < paginas.size() - 1) {
-        vec2 pos = frame.pos + frame.size;
+    if(arrowShown) {
+        vec2 pos = frame.size;
         for(int i = 0; i < 5; i++)
             ga.drawLine(pos - vec2(10+i, 20), pos - vec2(5+i, 15), 0xfafafa_rgb);
         for(int i = 0; i < 5; i++)
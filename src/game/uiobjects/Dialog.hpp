@@ -13,6 +13,7 @@ namespace hw {
         vector<string> paginas;
         size_t pagina = size_t(-1);
         AnimationChain<size_t> aparecer;
+        bool arrowShown = false;
 
         void prepareAnimation();
 
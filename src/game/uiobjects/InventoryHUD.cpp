@@ -10,6 +10,15 @@ InventoryHUD::InventoryHUD(Game &game, Level &level, const vec2 &pos, const stri
 
 }
 
+void InventoryHUD::update(float delta, GameActions &ga) {
+    UIObject::update(delta, ga);
+    //Only drawn again when the inventory changes
+    if(inventory.size() != itemsShown) {
+        itemsShown = inventory.size();
+        invalidate();
+    }
+}
+
 void InventoryHUD::draw(GameActions &ga) {
     float left = 0.0f;
     for(auto item: inventory) {
@@ -19,5 +28,6 @@ void InventoryHUD::draw(GameActions &ga) {
         item->drawForUI(ga);
         item->getFrame().pos = oldPos;
         left += frame.size.x + 10;
+        this->frame.size = glm::max(this->frame.size, frame.pos + frame.size);
     }
 }
@@ -14,11 +14,13 @@ namespace hw {
     class InventoryHUD: public UIObject {
 
         const vector<CollectableObject*> &inventory;
+        size_t itemsShown = 0;
 
     public:
         InventoryHUD(Game &game, Level &level, const vec2 &pos, const string &name, const vector<CollectableObject*> &inventory);
 
         void setup() override {};
+        void update(float delta, GameActions &ga) override;
         void draw(GameActions &ga) override;
     };
 